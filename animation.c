@@ -0,0 +1,392 @@
+/****************************************************************************/
+/* animation.c: fly-through animation for FRASCR application                */
+/*   See animation.h. Libraries that compute by tiles go through            */
+/*   execute_frames (engine.h), which finishes a frame while the next is    */
+/*   computed; those with only EXECUTE are called once per frame.           */
+/*   Last updated: 2024 June                                                */
+/****************************************************************************/
+/*  Author: Miguel Abele                                                    */
+/*  Copyrighted by Miguel Abele, 2024.                                      */
+/*                                                                          */
+/*  License information:                                                    */
+/*                                                                          */
+/*  This file is a part of the FRASCR application.                          */
+/*                                                                          */
+/*  FRASCR is free software; you can redistribute it and/or                 */
+/*  modify it under the terms of the GNU General Public License             */
+/*  as published by the Free Software Foundation; either version 3          */
+/*  of the License, or (at your option) any later version.                  */
+/*                                                                          */
+/*  FRASCR is distributed in the hope that it will be useful,               */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of          */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           */
+/*  GNU General Public License for more details.                            */
+/*                                                                          */
+/*  You should have received a copy of the GNU General Public License       */
+/*  along with this program; if not, write to the Free Software             */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor,                      */
+/*  Boston, MA  02110-1301, USA.                                            */
+/****************************************************************************/
+
+
+#include "animation.h"
+#include "engine.h"
+#include "lib/fixedpoint.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+
+
+/* room for a secondary option past the longest of any keyframe */
+#define AN_SECONDARY  256
+/* digits past those of the keyframes in a fixed point secondary option,
+   and the most after the point that FP_MAXLIMBS limbs hold exactly */
+#define AN_EXTRA      8
+#define AN_FRACTION   ((FP_MAXLIMBS-1)*64*3/10)
+/* room a frame number adds to an output name */
+#define AN_NUMBER     112
+
+
+struct animation {
+  AnimationOpts * anim;
+  uint32 outl;
+  char ** base;                   /* output names as configured */
+  uint32 secondaryl;              /* the most any keyframe has */
+  size_t secondarysize;           /* room for each of them */
+  char ** secondary[EN_FRAMES];   /* a frame's secondary options, per slot */
+  char ** outs[EN_FRAMES];        /* a frame's output names, per slot */
+};
+typedef struct animation Animation;
+
+
+
+/* the keyframes either side of frame, and how far it is from a to b */
+static void keys_around(AnimationOpts * anim, uint32 frame,
+			Keyframe ** a, Keyframe ** b, float64 * t)
+{
+  uint32 k;
+
+  for (k=0; (k+1<anim->keyl) && (anim->keys[k+1].frame <= frame); k++)
+    ;
+  *a = *b = &(anim->keys[k]);
+  *t = 0.0;
+  if ((k+1 < anim->keyl) && (frame > (*a)->frame)) {
+    *b = &(anim->keys[k+1]);
+    *t = (float64)(frame - (*a)->frame) / (float64)((*b)->frame - (*a)->frame);
+  }
+}
+
+
+
+/* the significant digits of a plain decimal number, and how many of them
+   are after the point; -1 if s is not one */
+static int decimal_digits(const char * s, int * fraction)
+{
+  int digits = 0, point = -1, lead = 1, seen = 0;
+  char * end;
+
+  if ((*s == '-') || (*s == '+'))
+    s++;
+  for (; ((*s >= '0') && (*s <= '9')) || ((*s == '.') && (point < 0)); s++) {
+    if (*s == '.') {
+      point = digits;
+      continue;
+    }
+    seen++;
+    if ((*s != '0') || !lead) {
+      lead = 0;
+      digits++;
+    } else if (point >= 0) {
+      point--;   /* leading zeros after the point still count as fraction */
+    }
+  }
+  *fraction = (point < 0 ? 0 : digits - point);
+  if ((*s == 'e') || (*s == 'E')) {
+    *fraction -= (int)strtol(s+1, &end, 10);
+    if (end == s+1)
+      return -1;
+    s = end;
+  }
+  if (*fraction < 0)
+    *fraction = 0;
+  return ((seen > 0) && (*s == '\0') ? digits : -1);
+}
+
+
+
+/* r times x in (0, 1], in fixed point: x = m * 2^e with m of 53 bits,
+   so that a tiny x keeps its precision relative to itself */
+static void scale_by(Fixed * r, float64 x)
+{
+  float64 m;
+  int e;
+
+  if (x >= 1.0)
+    return;
+  m = frexp(x, &e);
+  fp_scale(r, r, (uint64)ldexp(m, 53), 1UL << 53, FP_MAXLIMBS);
+  for (e=-e; e>0; e-=62)
+    fp_scale(r, r, 1, 1UL << (e < 62 ? e : 62), FP_MAXLIMBS);
+}
+
+
+
+/* a secondary option between sa and sb, into dst of size bytes. Whole
+   numbers move t of the way, as the escape limit does; other numbers move
+   s of the way, as the centre of the view does, counted from the nearer
+   keyframe (rest is 1 - s, computed without cancellation), so that near
+   the end of a deep zoom they are as close to sb as the view is small.
+   Numbers with more digits than a float64 holds (a perturbation centre)
+   move in fixed point, so that no digit is lost; an option is otherwise
+   as in sa. */
+static void secondary_between(char * dst, size_t size, const char * sa, const char * sb,
+			      float64 t, float64 s, float64 rest)
+{
+  Fixed fa, fb;
+  char * end;
+  long la, lb;
+  float64 da, db;
+  int na, nb, fracta, fractb, digits;
+
+  if ((t > 0.0) && (strcmp(sa, sb) != 0) &&
+      ((na = decimal_digits(sa, &fracta)) >= 0) && ((nb = decimal_digits(sb, &fractb)) >= 0)) {
+    if ((na > DBL_DIG) || (nb > DBL_DIG)) {
+      digits = (fracta > fractb ? fracta : fractb);
+      if (digits > 0)
+	digits += AN_EXTRA;
+      if (digits > AN_FRACTION)
+	digits = AN_FRACTION;
+      /* any more digits than fixed point holds, and the option stays put */
+      if ((fracta <= AN_FRACTION) && (fractb <= AN_FRACTION) &&
+	  (fp_from_string(&fa, sa, FP_MAXLIMBS) == 0) &&
+	  (fp_from_string(&fb, sb, FP_MAXLIMBS) == 0)) {
+	if (s <= 0.5) {
+	  fp_sub(&fb, &fb, &fa, FP_MAXLIMBS);
+	  scale_by(&fb, s);
+	  fp_add(&fa, &fa, &fb, FP_MAXLIMBS);
+	} else {
+	  fp_sub(&fa, &fa, &fb, FP_MAXLIMBS);
+	  scale_by(&fa, rest);
+	  fp_add(&fa, &fa, &fb, FP_MAXLIMBS);
+	}
+	if (fp_to_string(dst, size, &fa, digits, FP_MAXLIMBS) == 0)
+	  return;
+      }
+    } else {
+      la = strtol(sa, &end, 10);
+      if (*end == '\0') {
+	lb = strtol(sb, &end, 10);
+	if (*end == '\0') {
+	  sprintf(dst, "%ld", (long)floor((float64)la + t*(float64)(lb - la) + 0.5));
+	  return;
+	}
+      }
+      da = strtod(sa, &end);
+      db = strtod(sb, &end);
+      sprintf(dst, "%.17g", (s <= 0.5 ? da + s*(db - da) : db + rest*(da - db)));
+      return;
+    }
+  }
+  /* size leaves room for the longest option of any keyframe */
+  strcpy(dst, sa);
+}
+
+
+
+/* base with the frame number in place of its first %d, which may have a
+   width of up to two digits, or before its extension if it has none. The
+   standard output ("-") takes every frame. */
+static void frame_name(char * dst, const char * base, uint32 frame)
+{
+  const char * p, * q, * dot;
+  char form[8];
+
+  if (strcmp(base, "-") == 0) {
+    strcpy(dst, base);
+    return;
+  }
+  for (p=strchr(base, '%'); p; p=strchr(p+1, '%')) {
+    for (q=p+1; (q-p < 3) && (*q >= '0') && (*q <= '9'); q++)
+      ;
+    if (*q == 'd') {
+      sprintf(form, "%%%.*su", (int)(q-p-1), p+1);
+      memcpy(dst, base, p-base);
+      sprintf(dst + (p-base), form, frame);
+      strcat(dst, q+1);
+      return;
+    }
+  }
+
+  dot = strrchr(base, '.');
+  if ((dot == NULL) || (dot == base) || (strchr(dot, '/') != NULL))
+    dot = base + strlen(base);
+  memcpy(dst, base, dot-base);
+  sprintf(dst + (dot-base), "-%05u%s", frame, dot);
+}
+
+
+
+static int frame_setup(void * context, uint32 frame, int slot,
+		       CanvasOpts * canv, char ** outs)
+{
+  Animation * an = (Animation *)context;
+  Keyframe * a, * b;
+  float64 t, s, rest, w, h, cx, cy;
+  uint32 i;
+
+  keys_around(an->anim, frame, &a, &b, &t);
+
+  /* in a zoom the centres move in step with the width, so the point the
+     two views share keeps its place on screen */
+  if ((an->anim->interpolation == ANIM_ZOOM) && (a->width != b->width)) {
+    w = a->width * pow(b->width / a->width, t);
+    h = a->height * pow(b->height / a->height, t);
+    s = (a->width - w) / (a->width - b->width);
+    rest = (w - b->width) / (a->width - b->width);
+  } else {
+    w = a->width + t*(b->width - a->width);
+    h = a->height + t*(b->height - a->height);
+    s = t;
+    rest = (b != a ? (float64)(b->frame - frame) / (float64)(b->frame - a->frame) : 1.0);
+  }
+  cx = a->left + 0.5*a->width;
+  cx += s*(b->left + 0.5*b->width - cx);
+  cy = a->bottom + 0.5*a->height;
+  cy += s*(b->bottom + 0.5*b->height - cy);
+  canv->left = cx - 0.5*w;
+  canv->width = w;
+  canv->bottom = cy - 0.5*h;
+  canv->height = h;
+  canv->coord_Re = a->coord_Re + t*(b->coord_Re - a->coord_Re);
+  canv->coord_Im = a->coord_Im + t*(b->coord_Im - a->coord_Im);
+  canv->escape = (uint32)floor((float64)a->escape + t*((float64)b->escape - (float64)a->escape) + 0.5);
+
+  for (i=0; i<a->secondaryl; i++)
+    secondary_between(an->secondary[slot][i], an->secondarysize, a->secondary[i],
+		      (i < b->secondaryl ? b->secondary[i] : a->secondary[i]), t, s, rest);
+  canv->secondary = (a->secondaryl > 0 ? an->secondary[slot] : NULL);
+  canv->secondaryl = a->secondaryl;
+
+  for (i=0; i<an->outl; i++) {
+    frame_name(an->outs[slot][i], an->base[i], frame);
+    outs[i] = an->outs[slot][i];
+  }
+
+  if (canv->debug)
+    DEBUG(canv->debug, D1, "animation::frame %u: [%g, %g] x [%g, %g], escape %u\n",
+	  frame, canv->left, canv->left + canv->width,
+	  canv->bottom, canv->bottom + canv->height, canv->escape);
+  return 0;
+}
+
+
+
+static void free_animation(Animation * an)
+{
+  uint32 i;
+  int slot;
+
+  for (slot=0; slot<EN_FRAMES; slot++) {
+    if (an->secondary[slot]) {
+      free(an->secondary[slot][0]);
+      free(an->secondary[slot]);
+    }
+    if (an->outs[slot]) {
+      for (i=0; i<an->outl; i++)
+	free(an->outs[slot][i]);
+      free(an->outs[slot]);
+    }
+  }
+}
+
+
+
+/* storage for the strings of EN_FRAMES frames */
+static int allocate_animation(Animation * an)
+{
+  uint32 i, k;
+  int slot;
+
+  an->secondarysize = 0;
+  for (k=0; k<an->anim->keyl; k++) {
+    if (an->anim->keys[k].secondaryl > an->secondaryl)
+      an->secondaryl = an->anim->keys[k].secondaryl;
+    for (i=0; i<an->anim->keys[k].secondaryl; i++)
+      if (strlen(an->anim->keys[k].secondary[i]) > an->secondarysize)
+	an->secondarysize = strlen(an->anim->keys[k].secondary[i]);
+  }
+  an->secondarysize += AN_SECONDARY;
+
+  for (slot=0; slot<EN_FRAMES; slot++) {
+    an->secondary[slot] = calloc(an->secondaryl + 1, sizeof(char *));
+    an->outs[slot] = calloc(an->outl, sizeof(char *));
+    if ((an->secondary[slot] == NULL) || (an->outs[slot] == NULL))
+      return AN_MALLOC;
+    if (an->secondaryl > 0) {
+      an->secondary[slot][0] = malloc(an->secondarysize * an->secondaryl);
+      if (an->secondary[slot][0] == NULL)
+	return AN_MALLOC;
+      for (i=1; i<an->secondaryl; i++)
+	an->secondary[slot][i] = an->secondary[slot][0] + i*an->secondarysize;
+    }
+    for (i=0; i<an->outl; i++) {
+      an->outs[slot][i] = malloc(strlen(an->base[i]) + AN_NUMBER);
+      if (an->outs[slot][i] == NULL)
+	return AN_MALLOC;
+    }
+  }
+  return 0;
+}
+
+
+
+int animate(CoreOpts * core, CanvasOpts * canv, DParam * debug)
+{
+  Animation an;
+  CanvasOpts frame;
+  char ** outs;
+  uint32 f;
+  int ret;
+
+  if ((core==NULL) || (canv==NULL) || (core->animation==NULL) || (core->outs==NULL))
+    return AN_BAD_CALL;
+
+  an.anim = core->animation;
+  an.outl = core->outl;
+  an.base = core->outs;
+  an.secondaryl = 0;
+  memset(an.secondary, 0, sizeof(an.secondary));
+  memset(an.outs, 0, sizeof(an.outs));
+  ret = allocate_animation(&an);
+  if (ret != 0) {
+    free_animation(&an);
+    return ret;
+  }
+
+  DEBUG(debug, D1, "animation::animate: %u frame(s) from %u keyframe(s), %s\n",
+	an.anim->frames, an.anim->keyl,
+	(an.anim->interpolation == ANIM_ZOOM ? "zooming" : "linear"));
+
+  if (core->execute_tile) {
+    ret = execute_frames(core, canv, an.anim->frames, frame_setup, &an, debug);
+  } else {
+    /* EXECUTE does everything itself, so frames go one after another */
+    outs = an.outs[0];
+    for (f=0; (ret == 0) && (f<an.anim->frames); f++) {
+      frame = *canv;
+      frame.stream = 0;
+      frame.resume = NULL;
+      frame.cache = NULL;
+      ret = frame_setup(&an, f, 0, &frame, outs);
+      if (ret == 0)
+	ret = (*(core->execute))(&frame, core->finish, core->validate, outs, core->outl);
+      if (ret != 0)
+	DEBUG(debug, D0, "animation::animate: error in frame %u: %d\n", f, ret);
+    }
+  }
+
+  free_animation(&an);
+  return ret;
+}
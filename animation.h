@@ -0,0 +1,63 @@
+/****************************************************************************/
+/* animation.h: fly-through animation for FRASCR application                */
+/*   With an "animation" section in the configuration, the view and the     */
+/*   library's options are given at keyframes, and every frame between is   */
+/*   rendered in one run of the application, the libraries loaded once.     */
+/*   Domain: "zoom" interpolation scales the width and height               */
+/*   geometrically, so that a zoom runs at a steady rate, and moves the     */
+/*   centre in step with them; "linear" moves the edges linearly. The       */
+/*   constant, the escape limit and secondary options that are whole        */
+/*   numbers in both keyframes move linearly; secondary options that are    */
+/*   other numbers (a perturbation centre) move with the centre of the      */
+/*   view, so in a zoom they stay on the point being zoomed into. Numbers   */
+/*   with more digits than a float64 holds move in fixed point, with no     */
+/*   digit lost. Any other secondary option is that of the keyframe before. */
+/*   Before the first keyframe and after the last, the view is that         */
+/*   keyframe's.                                                            */
+/*   Outputs: the frame number takes the place of the first %d (or %05d,    */
+/*   etc.) in each output name, or goes before its extension as -00000.     */
+/*   An output of "-" is the standard output, and gets every frame in turn, */
+/*   for a finisher that writes a stream (liby4m.so).                       */
+/*   Last updated: 2024 June                                                */
+/****************************************************************************/
+/*  Author: Miguel Abele                                                    */
+/*  Copyrighted by Miguel Abele, 2024.                                      */
+/*                                                                          */
+/*  License information:                                                    */
+/*                                                                          */
+/*  This file is a part of the FRASCR application.                          */
+/*                                                                          */
+/*  FRASCR is free software; you can redistribute it and/or                 */
+/*  modify it under the terms of the GNU General Public License             */
+/*  as published by the Free Software Foundation; either version 3          */
+/*  of the License, or (at your option) any later version.                  */
+/*                                                                          */
+/*  FRASCR is distributed in the hope that it will be useful,               */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of          */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           */
+/*  GNU General Public License for more details.                            */
+/*                                                                          */
+/*  You should have received a copy of the GNU General Public License       */
+/*  along with this program; if not, write to the Free Software             */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor,                      */
+/*  Boston, MA  02110-1301, USA.                                            */
+/****************************************************************************/
+
+
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+
+#include "debug.h"
+#include "options.h"
+
+
+#define AN_BAD_CALL   -80
+#define AN_MALLOC     -81
+
+
+/* Render every frame of core->animation from the base options canv */
+int animate(CoreOpts * core, CanvasOpts * canv, DParam * debug);
+
+
+#endif /* ANIMATION_H */
@@ -50,6 +50,7 @@
 #define PW_BAD_WHEEL   -5
 #define PW_COLOR_CONV  -6
 #define PW_UNK_MODE    -7
+#define PW_PNG_WRITE   -8
 
 
 enum color_space {
@@ -119,6 +120,24 @@ union palette_base_char_16 {
 };
 typedef union palette_base_char_16 BaseC16;
 
+/* exact gamma curve, or the faster approximations of color.c */
+enum gamma_mode {
+  GAMMA_EXACT,
+  GAMMA_FAST
+};
+typedef enum gamma_mode GammaMode;
+
+
+/* XYZ->RGB matrix with the reference white folded in, and the gamma curve,
+   for the batch conversions */
+struct batch_reference {
+  float64 m[9];
+  GammaMode gamma;
+};
+typedef struct batch_reference BatchRef;
+
+#define COLOR_BATCH    64
+
 /*union palette_base_char_16 {
   struct {
     uint16 r;
@@ -169,5 +188,29 @@ int convert_xyz_to_sRGB16(void * voidrgb, BaseD * bxyz, uint16 alpha, RefValues
 
 int convert_xyz_to_RGB8(BaseC8 * brgb, BaseD * bxyz, unsigned char alpha);
 
+GammaMode gamma_to_gamma(const char * mode);
+
+int convert_xyz_to_sRGB8_fast(void * voidrgb, BaseD * bxyz, uint16 alpha, RefValues * ref);
+
+int convert_xyz_to_sRGB16_fast(void * voidrgb, BaseD * bxyz, uint16 alpha, RefValues * ref);
+
+void prepare_batch_reference(BatchRef * batch, const RefValues * ref, GammaMode gamma);
+
+int convert_lab_to_sRGB8_n(BaseC8 * brgb, const float64 * l, const float64 * a,
+			   const float64 * b, const int n, const uint16 alpha,
+			   const BatchRef * ref);
+
+int convert_lab_to_sRGB16_n(BaseC16 * brgb, const float64 * l, const float64 * a,
+			    const float64 * b, const int n, const uint16 alpha,
+			    const BatchRef * ref);
+
+int convert_lch_to_sRGB8_n(BaseC8 * brgb, const float64 * l, const float64 * c,
+			   const float64 * h, const int n, const uint16 alpha,
+			   const BatchRef * ref);
+
+int convert_lch_to_sRGB16_n(BaseC16 * brgb, const float64 * l, const float64 * c,
+			    const float64 * h, const int n, const uint16 alpha,
+			    const BatchRef * ref);
+
 
 #endif /* COLOR_H */
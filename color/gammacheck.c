@@ -0,0 +1,81 @@
+/****************************************************************************/
+/* gammacheck.c: error bounds of the fast sRGB gamma encoding               */
+/*   Checks gamma_encode_table and gamma_encode_poly (color.c) against the  */
+/*   exact curve at evenly spaced points of (0.0031308, 1], and fails if    */
+/*   either error is above the bound color.c states for it. Also feeds the  */
+/*   batch path values outside that range, which it must clamp.             */
+/*   Usage: gammacheck [points], 10^8 points by default.                    */
+/*   Last updated: 2024 June                                                */
+/****************************************************************************/
+/*  Author: Miguel Abele                                                    */
+/*  Copyrighted by Miguel Abele, 2024.                                      */
+/*                                                                          */
+/*  License information:                                                    */
+/*                                                                          */
+/*  This file is a part of the FRASCR application.                          */
+/*                                                                          */
+/*  FRASCR is free software; you can redistribute it and/or                 */
+/*  modify it under the terms of the GNU General Public License             */
+/*  as published by the Free Software Foundation; either version 3          */
+/*  of the License, or (at your option) any later version.                  */
+/*                                                                          */
+/*  FRASCR is distributed in the hope that it will be useful,               */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of          */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           */
+/*  GNU General Public License for more details.                            */
+/*                                                                          */
+/*  You should have received a copy of the GNU General Public License       */
+/*  along with this program; if not, write to the Free Software             */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor,                      */
+/*  Boston, MA  02110-1301, USA.                                            */
+/****************************************************************************/
+
+
+/* the static functions under test */
+#include "color.c"
+
+
+#define CHECK_TABLE_BOUND  1.5e-6
+#define CHECK_POLY_BOUND   2.0e-7
+
+
+
+int main(int argc, char ** argv)
+{
+  const float64 low = .0031308;
+  const float64 odd[] = { -1.0, -1e-300, 0.0, 1e-300, 1e-5, 0.0031308,
+			  1.0, 2.0, 1e300 };
+  float64 x, exact, err, table = 0.0, poly = 0.0, r;
+  long i, n = 100000000;
+  int k, fail = 0;
+
+  if (argc > 1)
+    n = atol(argv[1]);
+  if (n < 1)
+    n = 1;
+
+  for (i=1; i<=n; i++) {
+    x = low + (1.0 - low)*(float64)i/(float64)n;
+    exact = 1.055*pow(x,1.0/2.4)-0.055;
+    err = fabs(gamma_encode_table(x) - exact);
+    table = (err > table ? err : table);
+    err = fabs(gamma_encode_poly(x) - exact);
+    poly = (err > poly ? err : poly);
+  }
+  printf("table: %.3g (%.3f of a 16 bit step), bound %.3g\n",
+	 table, table*65535., CHECK_TABLE_BOUND);
+  printf("poly:  %.3g (%.3f of a 16 bit step), bound %.3g\n",
+	 poly, poly*65535., CHECK_POLY_BOUND);
+  fail = ((table > CHECK_TABLE_BOUND) || (poly > CHECK_POLY_BOUND));
+
+  for (k=0; k<(int)(sizeof(odd)/sizeof(odd[0])); k++) {
+    r = batch_gamma_fast(odd[k]);
+    if (!(r >= 0.0) || (r > 1.0)) {
+      printf("batch_gamma_fast(%g) = %g, outside [0, 1]\n", odd[k], r);
+      fail = 1;
+    }
+  }
+
+  printf("%s\n", (fail ? "FAIL" : "ok"));
+  return fail;
+}
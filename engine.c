@@ -0,0 +1,783 @@
+/****************************************************************************/
+/* engine.c: core-managed execution for FRASCR application                  */
+/*   See engine.h for the EXECUTE_TILE contract. Each worker thread         */
+/*   computes into its own tile buffer, which is then copied column by      */
+/*   column into the canvas (utils.h), so libraries never see its stride.   */
+/*   With canvas option "compact", only the counts are kept, in 16 bits     */
+/*   when the escape limit fits and in 32 otherwise. With canvas option     */
+/*   "cache", the part of a tile that the last render of the view shares    */
+/*   is copied in and only the rest is computed (viewcache.h).              */
+/*   Last updated: 2024 June                                                */
+/****************************************************************************/
+/*  Author: Miguel Abele                                                    */
+/*  Copyrighted by Miguel Abele, 2024.                                      */
+/*                                                                          */
+/*  License information:                                                    */
+/*                                                                          */
+/*  This file is a part of the FRASCR application.                          */
+/*                                                                          */
+/*  FRASCR is free software; you can redistribute it and/or                 */
+/*  modify it under the terms of the GNU General Public License             */
+/*  as published by the Free Software Foundation; either version 3          */
+/*  of the License, or (at your option) any later version.                  */
+/*                                                                          */
+/*  FRASCR is distributed in the hope that it will be useful,               */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of          */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           */
+/*  GNU General Public License for more details.                            */
+/*                                                                          */
+/*  You should have received a copy of the GNU General Public License       */
+/*  along with this program; if not, write to the Free Software             */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor,                      */
+/*  Boston, MA  02110-1301, USA.                                            */
+/****************************************************************************/
+
+
+#include "engine.h"
+#include "schedule.h"
+#include "viewcache.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+
+struct engine_context {
+  CanvasOpts * canvopts;
+  int (*execute_tile)();
+  Canvas * canva;
+  uint32 canvl;
+  uint32 y0;            /* first row of the view held by canva */
+  Datum ** tiles;       /* one tile buffer per worker */
+  int saturated;        /* a count was too large for a CANVAS_N16 canvas */
+  ViewCache cache;      /* the last render of the view, see viewcache.h */
+};
+typedef struct engine_context EngineContext;
+
+
+/* bands in flight: one being computed, one being finished, one spare */
+#define EN_BANDS      3
+
+struct band_queue {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  Canvas * bands[EN_BANDS];
+  int full[EN_BANDS];   /* computed and waiting for the finisher */
+  uint32 nbands;
+  int stop;             /* set by either side on an error */
+  int error;
+  CoreOpts * core;
+  CanvasOpts * canvopts;
+  uint32 canvl;
+};
+typedef struct band_queue BandQueue;
+
+
+/* a frame of a fly-through, from its setup until it is finished */
+struct frame_slot {
+  CanvasOpts canv;      /* the frame's own options */
+  Canvas * canva;       /* kept from frame to frame while canvl and format hold */
+  uint32 canvl;
+  int format;
+  FILE ** outfa;
+  char ** outs;         /* the frame's output names, set by the FrameSetup */
+  int full;             /* computed and waiting for the finisher */
+};
+typedef struct frame_slot FrameSlot;
+
+struct frame_queue {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  FrameSlot slots[EN_FRAMES];
+  uint32 frames;
+  int stop;             /* set by the computing side on an error */
+  CoreOpts * core;
+};
+typedef struct frame_queue FrameQueue;
+
+
+
+/* copy h pixels of a tile column into canvas column i from row j0, keeping
+   only the counts for a compact canvas. Returns 1 if any count saturated. */
+static inline int store_column(Canvas * c, uint32 i, uint32 j0, Datum * src, uint32 h)
+{
+  uint32 * d32;
+  uint16 * d16;
+  uint32 j;
+  int over = 0;
+
+  switch (c->format) {
+  case CANVAS_N32:
+    d32 = (uint32 *)c->counts + canvas_index(c, i, j0);
+    for (j=0; j<h; j++)
+      d32[j] = src[j].n;
+    break;
+  case CANVAS_N16:
+    d16 = (uint16 *)c->counts + canvas_index(c, i, j0);
+    for (j=0; j<h; j++) {
+      if (src[j].n > CANVAS_N16_MAX) {
+	d16[j] = CANVAS_N16_MAX;
+	over = 1;
+      } else {
+	d16[j] = src[j].n;
+      }
+    }
+    break;
+  default:
+    memcpy(canvas_at(c, i, j0), src, sizeof(Datum)*h);
+    break;
+  }
+  return over;
+}
+
+
+
+/* compute [x0,x0+w) x [y0,y0+h) of the canvases through the library */
+static int compute_part(EngineContext * ec,
+			Datum * tile,
+			uint32 x0,
+			uint32 y0,
+			uint32 w,
+			uint32 h)
+{
+  uint32 i, k;
+  int ret;
+
+  if ((w == 0) || (h == 0))
+    return 0;
+  ret = ec->execute_tile(ec->canvopts, x0, ec->y0 + y0, w, h, tile);
+  if (ret)
+    return ret;
+
+  for (k=0; k<ec->canvl; k++) {
+    for (i=0; i<w; i++) {
+      if (store_column(&(ec->canva[k]), x0+i, y0, &(tile[k*w*h + i*h]), h))
+	__atomic_store_n(&(ec->saturated), 1, __ATOMIC_RELAXED);
+    }
+  }
+  return 0;
+}
+
+
+
+static int engine_tile(void * context,
+		       int worker,
+		       uint32 x0,
+		       uint32 y0,
+		       uint32 w,
+		       uint32 h)
+{
+  EngineContext * ec = (EngineContext *)context;
+  Datum * tile = ec->tiles[worker];
+  uint32 cx0, cy0, cx1, cy1;
+  int ret;
+
+  if (!view_cache_overlap(&(ec->cache), x0, ec->y0 + y0, w, h, &cx0, &cy0, &cx1, &cy1))
+    return compute_part(ec, tile, x0, y0, w, h);
+
+  /* what the last render shares is copied, and only the strips around it
+     are computed: left and right whole, then below and above */
+  if (view_cache_copy(&(ec->cache), ec->canva, ec->y0, cx0, cy0, cx1 - cx0, cy1 - cy0))
+    __atomic_store_n(&(ec->saturated), 1, __ATOMIC_RELAXED);
+  cy0 -= ec->y0;
+  cy1 -= ec->y0;
+  ret = compute_part(ec, tile, x0, y0, cx0 - x0, h);
+  if (ret == 0)
+    ret = compute_part(ec, tile, cx1, y0, x0 + w - cx1, h);
+  if (ret == 0)
+    ret = compute_part(ec, tile, cx0, y0, cx1 - cx0, cy0 - y0);
+  if (ret == 0)
+    ret = compute_part(ec, tile, cx0, cy1, cx1 - cx0, y0 + h - cy1);
+  return ret;
+}
+
+
+
+static inline void free_engine(EngineContext * ec, int nthreads, FILE ** outfa, int outfl)
+{
+  int i;
+  if (ec->tiles) {
+    for (i=0; i<nthreads; i++)
+      free(ec->tiles[i]);
+    free(ec->tiles);
+    ec->tiles = NULL;
+  }
+  canvas_free_set(ec->canva, ec->canvl);
+  ec->canva = NULL;
+  if (outfa) {
+    for (i=0; i<outfl; i++)
+      if (outfa[i])
+	output_close(outfa[i]);
+    free(outfa);
+  }
+}
+
+
+
+static inline Canvas * allocate_canvases(EngineContext * ec, CanvasOpts * canv, uint32 rows, int format)
+{
+  Canvas * canva;
+  uint32 k;
+
+  canva = canvas_alloc_set(ec->canvl, canv->nwidth, rows, CANVAS_COLUMNS, format);
+  if (canva == NULL)
+    return NULL;
+  for (k=0; k<ec->canvl; k++) {
+    canvas_grid(&(canva[k]), canv->left, canv->bottom, canv->width, canv->height);
+    canvas_band(&(canva[k]), 0, rows, canv->nheight);
+  }
+  return canva;
+}
+
+
+
+/* every tile of the canvas, then TILE_COMPLETE */
+static int compute_whole(CoreOpts * core, CanvasOpts * canv, DParam * debug,
+			 EngineContext * ec, int nthreads)
+{
+  int ret;
+
+  ret = schedule_tiles(canv->nwidth, canv->nheight,
+		       SCHED_TILE_SIZE, SCHED_TILE_SIZE,
+		       nthreads, engine_tile, ec);
+  if (ret != 0) {
+    DEBUG(debug, D0, "engine::execute_tiles: error computing tiles: %d\n", ret);
+    return ret;
+  }
+  if (ec->saturated)
+    DEBUG(debug, D0, "engine::execute_tiles: counts above %d were clipped to fit the compact canvas\n",
+	  CANVAS_N16_MAX);
+
+  if (core->tile_complete) {
+    ret = core->tile_complete(canv, ec->canva, ec->canvl);
+    if (ret != 0) {
+      DEBUG(debug, D0, "engine::execute_tiles: library tile completion failed: %d\n", ret);
+      return ret;
+    }
+  }
+  view_cache_take(&(ec->cache), ec->canva, 0, canv->nheight);
+  return 0;
+}
+
+
+
+/* the whole canvas at once, then FINISH */
+static int run_whole(CoreOpts * core, CanvasOpts * canv, DParam * debug,
+		     EngineContext * ec, int nthreads, FILE ** outfa)
+{
+  int ret;
+
+  if (core->validate(ec->canva, ec->canvl, outfa, core->outl) != 0)
+    return EN_VALIDATE;
+  ret = compute_whole(core, canv, debug, ec, nthreads);
+  if (ret != 0)
+    return ret;
+
+  /* output results */
+
+  core->finish(canv, ec->canva, ec->canvl, outfa, core->outl);
+  return 0;
+}
+
+
+
+/* the finishing thread: takes the bands in order as they are computed */
+static void * band_writer(void * arg)
+{
+  BandQueue * q = (BandQueue *)arg;
+  uint32 b;
+  int slot, ret;
+
+  for (b=0; b<q->nbands; b++) {
+    slot = b % EN_BANDS;
+    pthread_mutex_lock(&(q->lock));
+    while (!q->full[slot] && !q->stop)
+      pthread_cond_wait(&(q->cond), &(q->lock));
+    if (q->stop) {
+      pthread_mutex_unlock(&(q->lock));
+      return NULL;
+    }
+    pthread_mutex_unlock(&(q->lock));
+
+    ret = q->core->finish_band(q->canvopts, q->bands[slot], q->canvl);
+
+    pthread_mutex_lock(&(q->lock));
+    q->full[slot] = 0;
+    if (ret != 0) {
+      q->stop = 1;
+      q->error = ret;
+    }
+    pthread_cond_broadcast(&(q->cond));
+    pthread_mutex_unlock(&(q->lock));
+    if (ret != 0)
+      return NULL;
+  }
+  return NULL;
+}
+
+
+
+static inline void band_stop(BandQueue * q, int error)
+{
+  pthread_mutex_lock(&(q->lock));
+  if (!q->stop) {
+    q->stop = 1;
+    q->error = error;
+  }
+  pthread_cond_broadcast(&(q->cond));
+  pthread_mutex_unlock(&(q->lock));
+}
+
+
+
+/* bands of rows from the top of the image down, each handed to the
+   finisher (on its own thread if possible) while the next is computed */
+static int stream_bands(CoreOpts * core, CanvasOpts * canv, DParam * debug,
+			EngineContext * ec, int nthreads, FILE ** outfa,
+			BandQueue * q, uint32 rows)
+{
+  pthread_t writer;
+  int threaded, slot, stop, ret;
+  uint32 b, k, y0, y1;
+
+  if (core->validate(q->bands[0], ec->canvl, outfa, core->outl) != 0)
+    return EN_VALIDATE;
+  ret = core->finish_begin(canv, ec->canvl, outfa, core->outl);
+  if (ret != 0) {
+    DEBUG(debug, D0, "engine::execute_tiles: finisher could not start: %d\n", ret);
+    return ret;
+  }
+
+  DEBUG(debug, D1, "engine::execute_tiles: streaming %u band(s) of %u rows\n", q->nbands, rows);
+  pthread_mutex_init(&(q->lock), NULL);
+  pthread_cond_init(&(q->cond), NULL);
+  threaded = (pthread_create(&writer, NULL, band_writer, q) == 0);
+
+  for (b=0; b<q->nbands; b++) {
+    slot = b % EN_BANDS;
+    pthread_mutex_lock(&(q->lock));
+    while (q->full[slot] && !q->stop)
+      pthread_cond_wait(&(q->cond), &(q->lock));
+    stop = q->stop;
+    pthread_mutex_unlock(&(q->lock));
+    if (stop)
+      break;
+
+    y1 = canv->nheight - b*rows;
+    y0 = (y1 > rows ? y1 - rows : 0);
+    for (k=0; k<ec->canvl; k++)
+      canvas_band(&(q->bands[slot][k]), y0, y1 - y0, canv->nheight);
+    ec->canva = q->bands[slot];
+    ec->y0 = y0;
+    ret = schedule_tiles(canv->nwidth, y1 - y0,
+			 SCHED_TILE_SIZE, SCHED_TILE_SIZE,
+			 nthreads, engine_tile, ec);
+    if (ret == 0)
+      view_cache_take(&(ec->cache), q->bands[slot], y0, y1 - y0);
+    if ((ret == 0) && !threaded)
+      ret = core->finish_band(canv, q->bands[slot], ec->canvl);
+    if (ret != 0) {
+      band_stop(q, ret);
+      break;
+    }
+    if (threaded) {
+      pthread_mutex_lock(&(q->lock));
+      q->full[slot] = 1;
+      pthread_cond_broadcast(&(q->cond));
+      pthread_mutex_unlock(&(q->lock));
+    }
+  }
+
+  if (threaded)
+    pthread_join(writer, NULL);
+  ec->canva = NULL;
+  core->finish_end(canv);
+  pthread_cond_destroy(&(q->cond));
+  pthread_mutex_destroy(&(q->lock));
+
+  if (q->error != 0)
+    DEBUG(debug, D0, "engine::execute_tiles: error streaming bands: %d\n", q->error);
+  if (ec->saturated)
+    DEBUG(debug, D0, "engine::execute_tiles: counts above %d were clipped to fit the compact canvas\n",
+	  CANVAS_N16_MAX);
+  return q->error;
+}
+
+
+
+static int run_bands(CoreOpts * core, CanvasOpts * canv, DParam * debug,
+		     EngineContext * ec, int nthreads, int format, FILE ** outfa)
+{
+  BandQueue q;
+  uint32 rows;
+  int slot, ret;
+
+  rows = (canv->stream < canv->nheight ? canv->stream : canv->nheight);
+  q.nbands = (canv->nheight + rows - 1) / rows;
+  q.stop = 0;
+  q.error = 0;
+  q.core = core;
+  q.canvopts = canv;
+  q.canvl = ec->canvl;
+  for (slot=0; slot<EN_BANDS; slot++) {
+    q.bands[slot] = NULL;
+    q.full[slot] = 0;
+  }
+
+  ret = 0;
+  for (slot=0; slot<EN_BANDS; slot++) {
+    q.bands[slot] = allocate_canvases(ec, canv, rows, format);
+    if (q.bands[slot] == NULL)
+      ret = EN_MALLOC;
+  }
+  if (ret == 0)
+    ret = stream_bands(core, canv, debug, ec, nthreads, outfa, &q, rows);
+
+  for (slot=0; slot<EN_BANDS; slot++)
+    canvas_free_set(q.bands[slot], ec->canvl);
+  return ret;
+}
+
+
+
+static int engine_run(CoreOpts * core, CanvasOpts * canv, DParam * debug, EngineContext * ec)
+{
+  FILE ** outfa = NULL;
+  int nthreads, format;
+  int i, ret;
+
+  nthreads = schedule_threads(canv->threads);
+  format = (canv->compact ? canvas_compact_format(canv->escape) : CANVAS_FULL);
+
+  /* setup memory and organize for validator */
+
+  ec->tiles = calloc(nthreads, sizeof(Datum *));
+  outfa = calloc(core->outl, sizeof(FILE *));
+  if ((ec->tiles == NULL) || (outfa == NULL)) {
+    free_engine(ec, nthreads, outfa, core->outl);
+    return EN_MALLOC;
+  }
+  if (!canv->stream) {
+    ec->canva = allocate_canvases(ec, canv, canv->nheight, format);
+    if (ec->canva == NULL) {
+      free_engine(ec, nthreads, outfa, core->outl);
+      return EN_MALLOC;
+    }
+  }
+  for (i=0; i<nthreads; i++) {
+    ec->tiles[i] = malloc(sizeof(Datum)*ec->canvl*SCHED_TILE_SIZE*SCHED_TILE_SIZE);
+    if (ec->tiles[i] == NULL) {
+      free_engine(ec, nthreads, outfa, core->outl);
+      return EN_MALLOC;
+    }
+  }
+  for (i=0; i<core->outl; i++) {
+    outfa[i] = output_open(core->outs[i]);
+    if (outfa[i] == NULL) {
+      DEBUG(debug, D0, "engine::execute_tiles: unable to open %s\n", core->outs[i]);
+      free_engine(ec, nthreads, outfa, core->outl);
+      return EN_FILE;
+    }
+  }
+
+  /* core functionality, execute */
+
+  DEBUG(debug, D2, "engine::execute_tiles: %d canvas(es), %d thread(s)\n", ec->canvl, nthreads);
+  if (format != CANVAS_FULL)
+    DEBUG(debug, D1, "engine::execute_tiles: compact canvases, %d bits per pixel\n",
+	  (format == CANVAS_N16 ? 16 : 32));
+  if (canv->stream)
+    ret = run_bands(core, canv, debug, ec, nthreads, format, outfa);
+  else
+    ret = run_whole(core, canv, debug, ec, nthreads, outfa);
+
+  free_engine(ec, nthreads, outfa, core->outl);
+  return ret;
+}
+
+
+
+int execute_tiles(CoreOpts * core, CanvasOpts * canv, DParam * debug)
+{
+  EngineContext ec;
+  int ret;
+
+  if ((core==NULL) || (canv==NULL) || (core->execute_tile==NULL) ||
+      (core->finish==NULL) || (core->validate==NULL) || (core->outs==NULL))
+    return EN_BAD_CALL;
+
+  ec.canvopts = canv;
+  ec.execute_tile = core->execute_tile;
+  ec.canva = NULL;
+  ec.canvl = 1;
+  ec.y0 = 0;
+  ec.tiles = NULL;
+  ec.saturated = 0;
+
+  /* bands need a finisher that takes them; the library sees the choice in
+     canvas option stream at TILE_SETUP */
+
+  if (canv->stream && (core->finish_band == NULL)) {
+    DEBUG(debug, D1, "engine::execute_tiles: finisher cannot take bands, finishing the whole canvas\n");
+    canv->stream = 0;
+  }
+
+  /* let the library prepare and say how many canvases it fills */
+
+  if (core->tile_setup) {
+    ret = core->tile_setup(canv);
+    if (ret < 0) {
+      DEBUG(debug, D0, "engine::execute_tiles: library tile setup failed: %d\n", ret);
+      return ret;
+    }
+    if (ret > 0)
+      ec.canvl = ret;
+  }
+
+  ret = view_cache_open(&(ec.cache), core, canv, ec.canvl, debug);
+  if (ret == 0) {
+    ret = engine_run(core, canv, debug, &ec);
+    view_cache_close(&(ec.cache), canv, debug, (ret == 0));
+  } else {
+    ret = EN_MALLOC;
+  }
+
+  if (core->tile_cleanup)
+    core->tile_cleanup(canv);
+
+  return ret;
+}
+
+
+
+/* FINISH a computed frame and close its outputs */
+static inline void finish_frame(CoreOpts * core, FrameSlot * s)
+{
+  int i;
+
+  core->finish(&(s->canv), s->canva, s->canvl, s->outfa, core->outl);
+  for (i=0; i<core->outl; i++) {
+    if (s->outfa[i])
+      output_close(s->outfa[i]);
+    s->outfa[i] = NULL;
+  }
+}
+
+
+
+/* the finishing thread for frames: takes them in order as they are
+   computed, while the next is */
+static void * frame_writer(void * arg)
+{
+  FrameQueue * q = (FrameQueue *)arg;
+  FrameSlot * s;
+  uint32 f;
+
+  for (f=0; f<q->frames; f++) {
+    s = &(q->slots[f % EN_FRAMES]);
+    pthread_mutex_lock(&(q->lock));
+    while (!s->full && !q->stop)
+      pthread_cond_wait(&(q->cond), &(q->lock));
+    if (!s->full) {
+      pthread_mutex_unlock(&(q->lock));
+      return NULL;
+    }
+    pthread_mutex_unlock(&(q->lock));
+
+    finish_frame(q->core, s);
+
+    pthread_mutex_lock(&(q->lock));
+    s->full = 0;
+    pthread_cond_broadcast(&(q->cond));
+    pthread_mutex_unlock(&(q->lock));
+  }
+  return NULL;
+}
+
+
+
+/* compute one frame into its slot, from TILE_SETUP to TILE_CLEANUP: the
+   canvases are reused when they still fit, and regridded */
+static int compute_frame(CoreOpts * core, EngineContext * ec, FrameSlot * s,
+			 int nthreads, uint32 * tilel, DParam * debug)
+{
+  CanvasOpts * canv = &(s->canv);
+  uint32 canvl = 1, k;
+  int format, i, ret;
+
+  if (core->tile_setup) {
+    ret = core->tile_setup(canv);
+    if (ret < 0) {
+      DEBUG(debug, D0, "engine::execute_frames: library tile setup failed: %d\n", ret);
+      return ret;
+    }
+    if (ret > 0)
+      canvl = ret;
+  }
+
+  format = (canv->compact ? canvas_compact_format(canv->escape) : CANVAS_FULL);
+  ec->canvopts = canv;
+  ec->canvl = canvl;
+  ec->y0 = 0;
+  ec->saturated = 0;
+  ret = 0;
+  if (s->canva && ((s->canvl != canvl) || (s->format != format))) {
+    canvas_free_set(s->canva, s->canvl);
+    s->canva = NULL;
+  }
+  if (s->canva == NULL) {
+    s->canva = allocate_canvases(ec, canv, canv->nheight, format);
+    s->canvl = canvl;
+    s->format = format;
+    if (s->canva == NULL)
+      ret = EN_MALLOC;
+  } else {
+    for (k=0; k<canvl; k++)
+      canvas_grid(&(s->canva[k]), canv->left, canv->bottom, canv->width, canv->height);
+  }
+  if ((ret == 0) && (canvl > *tilel)) {
+    for (i=0; i<nthreads; i++) {
+      free(ec->tiles[i]);
+      ec->tiles[i] = malloc(sizeof(Datum)*canvl*SCHED_TILE_SIZE*SCHED_TILE_SIZE);
+      if (ec->tiles[i] == NULL)
+	ret = EN_MALLOC;
+    }
+    *tilel = (ret == 0 ? canvl : 0);
+  }
+
+  for (i=0; (ret == 0) && (i<core->outl); i++) {
+    s->outfa[i] = output_open(s->outs[i]);
+    if (s->outfa[i] == NULL) {
+      DEBUG(debug, D0, "engine::execute_frames: unable to open %s\n", s->outs[i]);
+      ret = EN_FILE;
+    }
+  }
+  if ((ret == 0) && (core->validate(s->canva, canvl, s->outfa, core->outl) != 0))
+    ret = EN_VALIDATE;
+
+  if (ret == 0) {
+    ec->canva = s->canva;
+    ret = view_cache_open(&(ec->cache), core, canv, canvl, debug);
+    if (ret == 0) {
+      ret = compute_whole(core, canv, debug, ec, nthreads);
+      view_cache_close(&(ec->cache), canv, debug, (ret == 0));
+    } else {
+      ret = EN_MALLOC;
+    }
+    ec->canva = NULL;
+  }
+
+  if (core->tile_cleanup)
+    core->tile_cleanup(canv);
+  return ret;
+}
+
+
+
+int execute_frames(CoreOpts * core, CanvasOpts * canv, uint32 frames,
+		   FrameSetup setup, void * context, DParam * debug)
+{
+  EngineContext ec;
+  FrameQueue q;
+  FrameSlot * s;
+  pthread_t writer;
+  uint32 f, tilel = 0;
+  int nthreads, threaded, slot, i, ret;
+
+  if ((core==NULL) || (canv==NULL) || (setup==NULL) || (core->execute_tile==NULL) ||
+      (core->finish==NULL) || (core->validate==NULL) || (core->outs==NULL))
+    return EN_BAD_CALL;
+
+  nthreads = schedule_threads(canv->threads);
+  ec.execute_tile = core->execute_tile;
+  ec.canva = NULL;
+  ec.tiles = calloc(nthreads, sizeof(Datum *));
+  q.frames = frames;
+  q.stop = 0;
+  q.core = core;
+  ret = (ec.tiles == NULL ? EN_MALLOC : 0);
+  for (slot=0; slot<EN_FRAMES; slot++) {
+    s = &(q.slots[slot]);
+    s->canva = NULL;
+    s->canvl = 0;
+    s->full = 0;
+    s->outfa = calloc(core->outl, sizeof(FILE *));
+    s->outs = calloc(core->outl, sizeof(char *));
+    if ((s->outfa == NULL) || (s->outs == NULL))
+      ret = EN_MALLOC;
+  }
+
+  pthread_mutex_init(&(q.lock), NULL);
+  pthread_cond_init(&(q.cond), NULL);
+  threaded = ((ret == 0) && (pthread_create(&writer, NULL, frame_writer, &q) == 0));
+  DEBUG(debug, D1, "engine::execute_frames: %u frame(s), %d thread(s)%s\n", frames, nthreads,
+	(threaded ? ", finishing each while the next is computed" : ""));
+
+  for (f=0; (ret == 0) && (f<frames); f++) {
+    slot = f % EN_FRAMES;
+    s = &(q.slots[slot]);
+    pthread_mutex_lock(&(q.lock));
+    while (s->full)
+      pthread_cond_wait(&(q.cond), &(q.lock));
+    pthread_mutex_unlock(&(q.lock));
+
+    /* each frame starts from the base options; what carries state from
+       one render to the next is left off */
+    s->canv = *canv;
+    s->canv.stream = 0;
+    s->canv.resume = NULL;
+    s->canv.cache = NULL;
+    ret = setup(context, f, slot, &(s->canv), s->outs);
+    if (ret != 0) {
+      DEBUG(debug, D0, "engine::execute_frames: frame %u could not be set up: %d\n", f, ret);
+      break;
+    }
+    ret = compute_frame(core, &ec, s, nthreads, &tilel, debug);
+    if (ret != 0) {
+      DEBUG(debug, D0, "engine::execute_frames: error computing frame %u: %d\n", f, ret);
+      break;
+    }
+    if (ec.saturated)
+      DEBUG(debug, D0, "engine::execute_frames: counts above %d were clipped in frame %u\n",
+	    CANVAS_N16_MAX, f);
+
+    if (threaded) {
+      pthread_mutex_lock(&(q.lock));
+      s->full = 1;
+      pthread_cond_broadcast(&(q.cond));
+      pthread_mutex_unlock(&(q.lock));
+    } else {
+      finish_frame(core, s);
+    }
+  }
+
+  /* on an error the writer finishes what is already computed and stops */
+  if (threaded) {
+    if (ret != 0) {
+      pthread_mutex_lock(&(q.lock));
+      q.stop = 1;
+      pthread_cond_broadcast(&(q.cond));
+      pthread_mutex_unlock(&(q.lock));
+    }
+    pthread_join(writer, NULL);
+  }
+  pthread_cond_destroy(&(q.cond));
+  pthread_mutex_destroy(&(q.lock));
+
+  for (slot=0; slot<EN_FRAMES; slot++) {
+    s = &(q.slots[slot]);
+    canvas_free_set(s->canva, s->canvl);
+    if (s->outfa) {
+      for (i=0; i<core->outl; i++)
+	if (s->outfa[i])
+	  output_close(s->outfa[i]);
+      free(s->outfa);
+    }
+    free(s->outs);
+  }
+  if (ec.tiles) {
+    for (i=0; i<nthreads; i++)
+      free(ec.tiles[i]);
+    free(ec.tiles);
+  }
+  return ret;
+}
@@ -0,0 +1,117 @@
+/****************************************************************************/
+/* engine.h: core-managed execution for FRASCR application                  */
+/*   Algorithm libraries that provide EXECUTE_TILE are driven from here     */
+/*   rather than through their own EXECUTE: the core allocates the canvas,  */
+/*   opens the output files, validates, schedules the tiles over the        */
+/*   worker threads (schedule.h) and calls the finisher.                    */
+/*                                                                          */
+/*   Library entry points used by the engine:                               */
+/*     int EXECUTE_TILE(CanvasOpts * opts, uint32 x0, uint32 y0,            */
+/*                      uint32 w, uint32 h, Datum * tile)                   */
+/*       required. Computes pixels [x0,x0+w) x [y0,y0+h) into tile, which   */
+/*       holds w*h entries per canvas, column by column: pixel (i,j) of     */
+/*       canvas k is tile[k*w*h + (i-x0)*h + (j-y0)]. Called concurrently   */
+/*       from several threads. Returns 0 or a negative error.               */
+/*     int TILE_SETUP(CanvasOpts * opts)                                    */
+/*       optional. Called once before any tile; returns the number of       */
+/*       canvases the library produces (1 if absent) or a negative error.   */
+/*     int TILE_COMPLETE(CanvasOpts * opts, Canvas * canva, uint32 canvl)   */
+/*       optional. Called once every tile is in the canvases, before the    */
+/*       finisher, so that the library can fill in pixels its tiles left    */
+/*       out (e.g. by symmetry). The canvases may be compact (utils.h).     */
+/*       Returns 0 or a negative error.                                     */
+/*     void TILE_CLEANUP(CanvasOpts * opts)                                 */
+/*       optional. Called once after finishing, or after a failure, when    */
+/*       TILE_SETUP has succeeded.                                          */
+/*                                                                          */
+/*   With canvas option "cache" (viewcache.h), EXECUTE_TILE is called only  */
+/*   for the pixels the last render of the view does not share, which can  */
+/*   be strips of a tile a few pixels wide.                                 */
+/*                                                                          */
+/*   With canvas option "stream" set to a number of rows, the canvas is     */
+/*   computed in bands of that many rows, from the top of the image down,   */
+/*   and each band goes to the finisher while the next is computed, so only */
+/*   a few bands are ever held. TILE_COMPLETE is not called; a library that */
+/*   fills pixels from elsewhere in the view must not rely on it when its   */
+/*   TILE_SETUP sees stream set. This needs a finisher with all of:         */
+/*     int FINISH_BEGIN(CanvasOpts * opts, int canvl, FILE ** filea,        */
+/*                      int filel)                                          */
+/*       prepares the outputs. Returns 0, or a negative error after         */
+/*       releasing anything it took.                                        */
+/*     int FINISH_BAND(CanvasOpts * opts, Canvas * banda, int canvl)        */
+/*       takes one band of every canvas: rows [j0, j0+ny) of the view, see  */
+/*       canvas_band in utils.h. Bands come in order, top first, from a     */
+/*       thread of their own. Returns 0 or a negative error.                */
+/*     void FINISH_END(CanvasOpts * opts)                                   */
+/*       called once after the last band, or after a failure, when          */
+/*       FINISH_BEGIN has succeeded.                                        */
+/*   Otherwise the whole canvas goes to FINISH as usual.                    */
+/*                                                                          */
+/*   In a fly-through (execute_frames, animation.h) every frame runs from   */
+/*   TILE_SETUP to TILE_CLEANUP on its own options, and is finished after   */
+/*   TILE_CLEANUP, while the library already computes the next frame; the   */
+/*   finisher is called from one thread, frame by frame, in order. Options  */
+/*   "stream", "resume" and "cache" are off for the frames.                 */
+/*   Last updated: 2024 June                                                */
+/****************************************************************************/
+/*  Author: Miguel Abele                                                    */
+/*  Copyrighted by Miguel Abele, 2024.                                      */
+/*                                                                          */
+/*  License information:                                                    */
+/*                                                                          */
+/*  This file is a part of the FRASCR application.                          */
+/*                                                                          */
+/*  FRASCR is free software; you can redistribute it and/or                 */
+/*  modify it under the terms of the GNU General Public License             */
+/*  as published by the Free Software Foundation; either version 3          */
+/*  of the License, or (at your option) any later version.                  */
+/*                                                                          */
+/*  FRASCR is distributed in the hope that it will be useful,               */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of          */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           */
+/*  GNU General Public License for more details.                            */
+/*                                                                          */
+/*  You should have received a copy of the GNU General Public License       */
+/*  along with this program; if not, write to the Free Software             */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor,                      */
+/*  Boston, MA  02110-1301, USA.                                            */
+/****************************************************************************/
+
+
+#ifndef ENGINE_H
+#define ENGINE_H
+
+
+#include "debug.h"
+#include "options.h"
+
+
+#define EN_BAD_CALL   -60
+#define EN_MALLOC     -61
+#define EN_FILE       -62
+#define EN_VALIDATE   -63
+
+
+/* frames in flight in a fly-through: one computed, one finished */
+#define EN_FRAMES     2
+
+
+/* Sets up frame of a fly-through in canv, which starts as a copy of the
+   base options, and names its outputs in outs (core->outl of them). The
+   strings it points canv and outs at must live until the frame is
+   finished, i.e. until slot comes round again. Returns 0 or an error. */
+typedef int (*FrameSetup)(void * context, uint32 frame, int slot,
+			  CanvasOpts * canv, char ** outs);
+
+
+int execute_tiles(CoreOpts * core, CanvasOpts * canv, DParam * debug);
+
+/* Render frames 0 to frames-1 of canv, each set up by setup, in one pass
+   over the loaded library: canvases and tile buffers are kept from frame
+   to frame, and each frame is finished on a thread of its own while the
+   next is computed. */
+int execute_frames(CoreOpts * core, CanvasOpts * canv, uint32 frames,
+		   FrameSetup setup, void * context, DParam * debug);
+
+
+#endif /* ENGINE_H */
@@ -0,0 +1,482 @@
+/****************************************************************************/
+/* colorrow.c: rows of colored pixels for FRASCR finishers                  */
+/*   The color wheel, reference values and table of a row, moved out of     */
+/*   libcolorpng.c so that every finisher colors the same way, and the      */
+/*   bookkeeping of the finishers that write one output per canvas. See     */
+/*   colorrow.h.                                                            */
+/*   Last updated: 2024 June                                                */
+/****************************************************************************/
+/*  Author: Miguel Abele                                                    */
+/*  Copyrighted by Miguel Abele, 2024.                                      */
+/*                                                                          */
+/*  License information:                                                    */
+/*                                                                          */
+/*  This file is a part of the FRASCR application.                          */
+/*                                                                          */
+/*  FRASCR is free software; you can redistribute it and/or                 */
+/*  modify it under the terms of the GNU General Public License             */
+/*  as published by the Free Software Foundation; either version 3          */
+/*  of the License, or (at your option) any later version.                  */
+/*                                                                          */
+/*  FRASCR is distributed in the hope that it will be useful,               */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of          */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           */
+/*  GNU General Public License for more details.                            */
+/*                                                                          */
+/*  You should have received a copy of the GNU General Public License       */
+/*  along with this program; if not, write to the Free Software             */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor,                      */
+/*  Boston, MA  02110-1301, USA.                                            */
+/****************************************************************************/
+
+
+#include "colorrow.h"
+#include "bitorder.h"
+#include <stdlib.h>
+#include <string.h>
+
+
+#define MAX_SHORT      ((unsigned short)~(0))
+
+
+/* copy sz bytes of 16 bit samples, each swapped to big endian */
+static inline void * byte_n_switch_16(void * destn, const void * source, size_t sz)
+{
+  unsigned char * dest = destn;
+  const unsigned char * src = source;
+  size_t i;
+
+  for (i=0; i+1<sz; i+=2) {
+    dest[i] = src[i+1];
+    dest[i+1] = src[i];
+  }
+  return destn;
+}
+
+
+static inline uint32 prepare_color_reference(RefType type,
+					     RefValues * refholder)
+{
+  switch(type) {
+  case D65_2DEG:
+    std_illuminant_for_D65_2deg(refholder);
+    matrix_for_XYZ_sRGB_D65(refholder);
+    return 0;
+  case D65_10DEG:
+    std_illuminant_for_D65_10deg(refholder);
+    matrix_for_XYZ_sRGB_D65(refholder);
+    return 0;
+  case D50_2DEG:
+    std_illuminant_for_D50_2deg(refholder);
+    matrix_for_XYZ_wgRGB_D50(refholder);
+    return 0;
+  case D50_10DEG:
+    std_illuminant_for_D50_10deg(refholder);
+    matrix_for_XYZ_wgRGB_D50(refholder);
+    return 0;
+  default:
+    return 1;
+  }
+}
+
+
+int color_row_init(ColorRow * cr, CanvasOpts * opts, int depth)
+{
+  int ret;
+
+  cr->colors = NULL;
+  cr->swatchrgb = NULL;
+  cr->lut = NULL;
+  cr->lutmax = 0;
+  cr->index = NULL;
+  cr->ncolors = 0;
+  cr->ntrans = 0;
+  cr->datasize = (depth == 8 ? sizeof(BaseC8) : sizeof(BaseC16));
+  cr->pixelsize = cr->datasize;
+
+  /* gray ramp: nothing more to prepare */
+  if ((opts->visuals.colors == NULL) || (opts->visuals.colors->space == MONO))
+    return 0;
+
+  if ((ret = initialize_wheel(&(cr->colors),
+			      opts->visuals.colors->swatch_n,
+			      opts->visuals.colors->space,
+			      opts->visuals.colors->mode,
+			      opts->visuals.colors->swatch)) != 0)
+    return ret;
+
+  if (prepare_color_reference(opts->visuals.colors->reference, &(cr->colorconvref))) {
+    destroy_wheel(&(cr->colors));
+    return PW_BAD_CALL;
+  }
+  prepare_batch_reference(&(cr->batchref), &(cr->colorconvref), opts->visuals.colors->gamma);
+
+  if (depth == 8) {
+    cr->convertptr = (opts->visuals.colors->gamma == GAMMA_FAST ?
+		      convert_xyz_to_sRGB8_fast : convert_xyz_to_sRGB8);
+    cr->bytecopy = memcpy;
+  } else {
+    cr->convertptr = (opts->visuals.colors->gamma == GAMMA_FAST ?
+		      convert_xyz_to_sRGB16_fast : convert_xyz_to_sRGB16);
+    switch (O32_HOST_ORDER) {
+    case O32_LITTLE_ENDIAN:
+      cr->bytecopy = byte_n_switch_16;
+      break;
+    case O32_BIG_ENDIAN:
+      cr->bytecopy = memcpy;
+      break;
+    default:
+      destroy_wheel(&(cr->colors));
+      return PW_BAD_CALL; //I'm not handling PDP or HONEYWELL at the moment
+    }
+  }
+
+  cr->swatchrgb = malloc(cr->datasize);
+  if (cr->swatchrgb == NULL) {
+    destroy_wheel(&(cr->colors));
+    return PW_MALLOC;
+  }
+  return 0;
+}
+
+
+void color_row_free(ColorRow * cr)
+{
+  if (cr->swatchrgb)
+    free(cr->swatchrgb);
+  cr->swatchrgb = NULL;
+  if (cr->lut)
+    free(cr->lut);
+  cr->lut = NULL;
+  if (cr->index)
+    free(cr->index);
+  cr->index = NULL;
+  destroy_wheel(&(cr->colors));
+}
+
+
+/* gray pixel for a normalized intensity in [0,1], opaque */
+static inline void gray_of(ColorRow * cr, double intensity, uint8 * out)
+{
+  uint16 v;
+
+  if (cr->datasize == sizeof(BaseC8)) {
+    v = (uint16)(intensity*255.0 + 0.5);
+    out[0] = out[1] = out[2] = (uint8)v;
+    out[3] = 0xff;
+  } else {
+    v = (uint16)(intensity*65535.0 + 0.5);
+    out[0] = out[2] = out[4] = (uint8)(v >> 8);
+    out[1] = out[3] = out[5] = (uint8)(v & 0xff);
+    out[6] = out[7] = 0xff;
+  }
+}
+
+
+/* pixel for a normalized intensity in [0,1] */
+static inline void color_of(ColorRow * cr, double intensity, uint8 * out)
+{
+  uint16 max_uint16 = MAX_SHORT;
+  void * swatchI;
+  BaseD swatchluv;
+  BaseD swatchxyz;
+
+  if (cr->colors == NULL) {
+    gray_of(cr, intensity, out);
+    return;
+  }
+  linear_by_intensity_norm(cr->colors, intensity, &swatchI);
+  convert_lch_to_lab(&swatchluv, (BaseI *)swatchI);
+  convert_lab_to_xyz(&swatchxyz, &swatchluv, &(cr->colorconvref));
+  cr->convertptr(cr->swatchrgb, &swatchxyz, max_uint16, &(cr->colorconvref));
+  cr->bytecopy(out, cr->swatchrgb, cr->datasize);
+  free((BaseI *)swatchI);
+}
+
+
+/* Counts only take the values 0..intensitymax, so their colors are worked
+   out once up front and each pixel becomes a copy out of the table. When
+   there are more counts than pixels the table would cost more than it
+   saves and the colors are worked out per pixel instead, as they are if
+   the table cannot be had. */
+void color_row_table(ColorRow * cr, uint32 intensitymax, uint64 npixels)
+{
+  uint64 n, start;
+  int k, m;
+  void * swatchI;
+  float64 l[COLOR_BATCH], c[COLOR_BATCH], h[COLOR_BATCH];
+  union {
+    BaseC8 c8[COLOR_BATCH];
+    BaseC16 c16[COLOR_BATCH];
+  } block;
+
+  if (cr->lut)
+    free(cr->lut);
+  cr->lut = NULL;
+  cr->lutmax = intensitymax;
+
+  if ((uint64)intensitymax >= npixels)
+    return;
+  cr->lut = malloc(sizeof(uint8)*cr->datasize*((size_t)intensitymax+1));
+  if (cr->lut == NULL)
+    return;
+
+  if (cr->colors == NULL) {
+    for (n=0; n<=intensitymax; n++)
+      gray_of(cr,
+	      intensitymax == 0 ? 0.0 : (double)n / (double)intensitymax,
+	      &(cr->lut[cr->datasize*n]));
+    return;
+  }
+
+  /* a block of swatches at a time through the batch conversion */
+  for (start=0; start<=intensitymax; start+=COLOR_BATCH) {
+    m = (intensitymax - start + 1 < COLOR_BATCH ? intensitymax - start + 1 : COLOR_BATCH);
+    for (k=0; k<m; k++) {
+      n = start + k;
+      linear_by_intensity_norm(cr->colors,
+			       intensitymax == 0 ? 0.0 : (double)n / (double)intensitymax,
+			       &swatchI);
+      l[k] = ((BaseI *)swatchI)->a;
+      c[k] = ((BaseI *)swatchI)->b;
+      h[k] = ((BaseI *)swatchI)->c;
+      free((BaseI *)swatchI);
+    }
+    if (cr->datasize == sizeof(BaseC8))
+      convert_lch_to_sRGB8_n(block.c8, l, c, h, m, MAX_SHORT, &(cr->batchref));
+    else
+      convert_lch_to_sRGB16_n(block.c16, l, c, h, m, MAX_SHORT, &(cr->batchref));
+    for (k=0; k<m; k++)
+      cr->bytecopy(&(cr->lut[cr->datasize*(start+k)]),
+		   (cr->datasize == sizeof(BaseC8) ? (void *)&(block.c8[k]) : (void *)&(block.c16[k])),
+		   cr->datasize);
+  }
+}
+
+
+/* Indexed color: when the 8 bit table holds no more than CR_PALETTE
+   colors, a format with a palette can carry them and one byte per pixel.
+   The palette is gathered through a small open-addressed hash of the RGBA
+   words, and the attempt ends at the color after the last that fits. */
+#define PALETTE_HASH    1024
+
+int color_row_index(ColorRow * cr)
+{
+  uint32 hashword[PALETTE_HASH];
+  int hashentry[PALETTE_HASH];
+  uint32 n, h;
+  BaseC8 c;
+
+  if ((cr->lut == NULL) || (cr->datasize != sizeof(BaseC8)))
+    return 0;
+  cr->index = malloc(sizeof(uint8)*((size_t)cr->lutmax+1));
+  if (cr->index == NULL)
+    return 0;
+
+  memset(hashentry, -1, sizeof(hashentry));
+  cr->ncolors = 0;
+  cr->ntrans = 0;
+  for (n=0; n<=cr->lutmax; n++) {
+    memcpy(&c, &(cr->lut[cr->datasize*n]), sizeof(BaseC8));
+    h = (c.word * 2654435761u) >> 22;
+    while ((hashentry[h] >= 0) && (hashword[h] != c.word))
+      h = (h + 1) % PALETTE_HASH;
+    if (hashentry[h] < 0) {
+      if (cr->ncolors == CR_PALETTE) {
+	free(cr->index);
+	cr->index = NULL;
+	return 0;
+      }
+      hashword[h] = c.word;
+      hashentry[h] = cr->ncolors;
+      cr->palette[cr->ncolors] = c;
+      if (c.rgba.alpha != 0xff)
+	cr->ntrans = cr->ncolors + 1;
+      cr->ncolors++;
+    }
+    cr->index[n] = (uint8)hashentry[h];
+  }
+  cr->pixelsize = 1;
+  return 1;
+}
+
+
+void color_row_fill(uint8 * row, const Canvas * canvas, uint32 j, ColorRow * cr)
+{
+  uint32 i, n;
+
+  if (cr->index) {
+    for (i=0; i<canvas->nx; i++) {
+      n = canvas_n(canvas, i, j);
+      row[i] = cr->index[n > cr->lutmax ? cr->lutmax : n];
+    }
+    return;
+  }
+
+  for (i=0; i<canvas->nx; i++) {
+    n = canvas_n(canvas, i, j);
+    if (n > cr->lutmax)
+      n = cr->lutmax;
+    if (cr->lut)
+      memcpy(&(row[cr->datasize*i]), &(cr->lut[cr->datasize*n]), cr->datasize);
+    else
+      color_of(cr,
+	       cr->lutmax == 0 ? 0.0 : (double)n / (double)(cr->lutmax),
+	       &(row[cr->datasize*i]));
+  }
+}
+
+
+
+/* outputs of cf for datal canvases and filel files */
+static inline int color_outputs(const ColorFinisher * cf, int datal, int filel)
+{
+  int max = (datal <= filel ? datal : filel);
+
+  if ((cf->most > 0) && (max > cf->most))
+    max = cf->most;
+  return max;
+}
+
+
+void color_finish(const ColorFinisher * cf,
+		  CanvasOpts * opts,
+		  Canvas * dataa,
+		  int datal,
+		  FILE ** filea,
+		  int filel)
+{
+  int max, rno, ret;
+  void * state;
+
+  max = color_outputs(cf, datal, filel);
+  if ((max < 1) || ((state = malloc(cf->size)) == NULL))
+    return;
+
+  for (rno=0; rno<max; rno++) {
+    memset(state, 0, cf->size);
+    ret = cf->begin(state, opts, filea[rno],
+		    (cf->byescape ? opts->escape : canvas_max_n(&(dataa[rno]))));
+    if (ret == 0)
+      ret = cf->canvas(state, &(dataa[rno]));
+    if ((ret == 0) && cf->end)
+      ret = cf->end(state, opts);
+    if (ret && cf->report)
+      cf->report(state, opts, rno, ret);
+    cf->free(state);
+  }
+  free(state);
+
+  return;
+}
+
+
+
+static void free_streams(ColorStreams * cs)
+{
+  int rno;
+
+  for (rno=0; rno<cs->statel; rno++)
+    cs->cf->free(cs->states + cs->cf->size*rno);
+  free(cs->states);
+  cs->states = NULL;
+  cs->statel = 0;
+}
+
+
+int color_stream_begin(ColorStreams * cs,
+		       const ColorFinisher * cf,
+		       CanvasOpts * opts,
+		       int datal,
+		       FILE ** filea,
+		       int filel)
+{
+  int rno, ret;
+
+  if ((opts==NULL) || (filea==NULL) || (datal < 1) || (filel < 1))
+    return PW_BAD_CALL;
+
+  cs->cf = cf;
+  cs->error = 0;
+  cs->statel = color_outputs(cf, datal, filel);
+  cs->states = calloc(cs->statel, cf->size);
+  if (cs->states == NULL) {
+    cs->statel = 0;
+    return PW_MALLOC;
+  }
+  for (rno=0; rno<cs->statel; rno++) {
+    ret = cf->begin(cs->states + cf->size*rno, opts, filea[rno], opts->escape);
+    if (ret) {
+      if (cf->report)
+	cf->report(cs->states + cf->size*rno, opts, rno, ret);
+      free_streams(cs);
+      return ret;
+    }
+  }
+  return 0;
+}
+
+
+int color_stream_band(ColorStreams * cs, Canvas * banda, int datal)
+{
+  int rno, ret;
+
+  if ((banda==NULL) || (cs->states==NULL) || (datal < cs->statel))
+    return PW_BAD_CALL;
+
+  for (rno=0; rno<cs->statel; rno++) {
+    if ((ret = cs->cf->canvas(cs->states + cs->cf->size*rno, &(banda[rno]))) != 0) {
+      cs->failed = rno;
+      cs->error = ret;
+      return ret;
+    }
+  }
+  return 0;
+}
+
+
+void color_stream_end(ColorStreams * cs, CanvasOpts * opts)
+{
+  const ColorFinisher * cf = cs->cf;
+  void * state;
+  int rno, ret;
+
+  for (rno=0; rno<cs->statel; rno++) {
+    state = cs->states + cf->size*rno;
+    if (cs->error)
+      ret = (rno == cs->failed ? cs->error : 0);
+    else
+      ret = (cf->end ? cf->end(state, opts) : 0);
+    if (ret && cf->report)
+      cf->report(state, opts, rno, ret);
+  }
+  free_streams(cs);
+  cs->error = 0;
+}
+
+
+
+int color_validate(Canvas * dataa,
+		   int datal,
+		   FILE ** filea,
+		   int filel)
+{
+  int i;
+  if ((dataa==NULL) || (filea==NULL))
+    return PW_BAD_CALL;
+
+  if ((datal < 1) || (filel < 1))
+    return PW_BAD_CALL;
+
+  for (i=0; i<datal; i++) {
+    if ((dataa[i].data == NULL) && (dataa[i].counts == NULL))
+      return PW_BAD_CALL;
+  }
+
+  for (i=0; i<filel; i++) {
+    if (filea[i] == NULL)
+      return PW_BAD_CALL;
+  }
+
+  return 0;
+}
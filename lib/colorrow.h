@@ -0,0 +1,144 @@
+/****************************************************************************/
+/* colorrow.h: rows of colored pixels for FRASCR finishers                  */
+/*   Turns the escape counts of a canvas row into a row of RGBA pixels, 8   */
+/*   or 16 bits per channel (16 bit channels big-endian, as png and pam     */
+/*   want them), by way of the color wheel and palette of the visualization */
+/*   options. Without colorization options, or with a MONO space, the row   */
+/*   is a gray ramp instead. Counts are colored from a table made once per  */
+/*   image (color_row_table), and an 8 bit table of no more than 256 colors */
+/*   can also be turned into a palette and one index byte per pixel         */
+/*   (color_row_index). Shared by libcolorpng and the other finishers,      */
+/*   and those that write one output per canvas also share their FINISH,    */
+/*   band and VALIDATE functions (color_finish, color_stream_*).            */
+/*   Last updated: 2024 June                                                */
+/****************************************************************************/
+/*  Author: Miguel Abele                                                    */
+/*  Copyrighted by Miguel Abele, 2024.                                      */
+/*                                                                          */
+/*  License information:                                                    */
+/*                                                                          */
+/*  This file is a part of the FRASCR application.                          */
+/*                                                                          */
+/*  FRASCR is free software; you can redistribute it and/or                 */
+/*  modify it under the terms of the GNU General Public License             */
+/*  as published by the Free Software Foundation; either version 3          */
+/*  of the License, or (at your option) any later version.                  */
+/*                                                                          */
+/*  FRASCR is distributed in the hope that it will be useful,               */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of          */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           */
+/*  GNU General Public License for more details.                            */
+/*                                                                          */
+/*  You should have received a copy of the GNU General Public License       */
+/*  along with this program; if not, write to the Free Software             */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor,                      */
+/*  Boston, MA  02110-1301, USA.                                            */
+/****************************************************************************/
+
+
+#ifndef COLORROW_H
+#define COLORROW_H
+
+
+#include "options.h"
+#include "utils.h"
+#include "color.h"
+#include <stdio.h>
+
+
+/* largest palette color_row_index will make */
+#define CR_PALETTE     256
+
+
+/* what it takes to turn intensities into a row of colors */
+struct color_row {
+  Wheel * colors;    /* or NULL for the gray ramp */
+  RefValues colorconvref;
+  BatchRef batchref;
+  int datasize;      /* bytes per RGBA pixel */
+  int (*convertptr)(void *, BaseD *, unsigned short, RefValues *);
+  void *(*bytecopy)(void *, const void *, size_t);
+  void * swatchrgb;
+  uint8 * lut;       /* color of every count in [0, lutmax], or NULL */
+  uint32 lutmax;
+  uint8 * index;     /* palette entry of every count in [0, lutmax], or NULL */
+  BaseC8 palette[CR_PALETTE];
+  int ncolors;
+  int ntrans;        /* entries up to the last that is not opaque */
+  int pixelsize;     /* bytes per pixel of a row: datasize, or 1 if indexed */
+};
+typedef struct color_row ColorRow;
+
+
+/* Prepare cr for depth (8 or 16) bits per channel. Returns 0 or a PW error
+   (color.h) */
+int color_row_init(ColorRow * cr, CanvasOpts * opts, int depth);
+
+void color_row_free(ColorRow * cr);
+
+/* Colors of the counts 0..intensitymax, for an image of npixels */
+void color_row_table(ColorRow * cr, uint32 intensitymax, uint64 npixels);
+
+/* Returns 1 if cr is now indexed, 0 if it stays RGBA */
+int color_row_index(ColorRow * cr);
+
+/* Image row from canvas row j: canvas->nx pixels of cr->pixelsize bytes.
+   Counts above the table are colored as its last. */
+void color_row_fill(uint8 * row, const Canvas * canvas, uint32 j, ColorRow * cr);
+
+
+
+/* A finisher that colors each canvas into one output, by way of a state
+   of size bytes. The color_finish and color_stream_* functions below are
+   its FINISH and band functions (see engine.h), and color_validate its
+   VALIDATE. Whole canvases are colored from 0 to their largest count (or
+   to the escape limit if byescape), bands always to the escape limit, as
+   the counts of the bands still to come are not known. */
+struct color_finisher {
+  size_t size;
+  int most;          /* outputs at most, or 0 for one per canvas */
+  int byescape;
+  int (*begin)(void * state, CanvasOpts * opts, FILE * output, uint32 intensitymax);
+  int (*canvas)(void * state, const Canvas * canvas);  /* rows of a canvas or a band */
+  int (*end)(void * state, CanvasOpts * opts);         /* or NULL */
+  void (*free)(void * state);
+  void (*report)(void * state, CanvasOpts * opts, int rno, int ret);  /* or NULL */
+};
+typedef struct color_finisher ColorFinisher;
+
+
+/* the outputs of a finisher being written band by band */
+struct color_streams {
+  const ColorFinisher * cf;
+  char * states;
+  int statel;
+  int failed;        /* the output that failed a band, if error */
+  int error;
+};
+typedef struct color_streams ColorStreams;
+
+
+void color_finish(const ColorFinisher * cf,
+		  CanvasOpts * opts,
+		  Canvas * dataa,
+		  int datal,
+		  FILE ** filea,
+		  int filel);
+
+/* Returns 0 or a PW error (color.h) or one of cf->begin */
+int color_stream_begin(ColorStreams * cs,
+		       const ColorFinisher * cf,
+		       CanvasOpts * opts,
+		       int datal,
+		       FILE ** filea,
+		       int filel);
+
+int color_stream_band(ColorStreams * cs, Canvas * banda, int datal);
+
+/* Ends the outputs, unless a band failed, and frees them */
+void color_stream_end(ColorStreams * cs, CanvasOpts * opts);
+
+int color_validate(Canvas * dataa, int datal, FILE ** filea, int filel);
+
+
+#endif /* COLORROW_H */
@@ -0,0 +1,324 @@
+/****************************************************************************/
+/* fixedpoint.c: multiprecision fixed-point numbers for FRASCR libraries    */
+/*   Products are formed on magnitudes with 128-bit partial products (GNU   */
+/*   C unsigned __int128) and truncated back to the fixed-point format.     */
+/*   Last updated: 2024 May                                                 */
+/****************************************************************************/
+/*  Author: Miguel Abele                                                    */
+/*  Copyrighted by Miguel Abele, 2024.                                      */
+/*                                                                          */
+/*  License information:                                                    */
+/*                                                                          */
+/*  This file is a part of the FRASCR application.                          */
+/*                                                                          */
+/*  FRASCR is free software; you can redistribute it and/or                 */
+/*  modify it under the terms of the GNU General Public License             */
+/*  as published by the Free Software Foundation; either version 3          */
+/*  of the License, or (at your option) any later version.                  */
+/*                                                                          */
+/*  FRASCR is distributed in the hope that it will be useful,               */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of          */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           */
+/*  GNU General Public License for more details.                            */
+/*                                                                          */
+/*  You should have received a copy of the GNU General Public License       */
+/*  along with this program; if not, write to the Free Software             */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor,                      */
+/*  Boston, MA  02110-1301, USA.                                            */
+/****************************************************************************/
+
+
+#include "fixedpoint.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <ctype.h>
+
+
+#define FP_MAXDIGITS  1024
+
+#define FP_NEGATIVE(a,n) ((a)->l[(n)-1] >> 63)
+
+
+typedef unsigned __int128 uint128;
+
+
+
+static inline void fp_zero(Fixed * r, int limbs)
+{
+  memset(r->l, 0, sizeof(uint64)*limbs);
+}
+
+
+
+static inline void fp_neg(Fixed * r, const Fixed * a, int limbs)
+{
+  int k;
+  uint64 carry = 1;
+  for (k=0; k<limbs; k++) {
+    r->l[k] = ~(a->l[k]) + carry;
+    carry = (carry && (r->l[k] == 0));
+  }
+}
+
+
+
+/* divide the unsigned number a by a small divisor, in place */
+static inline void fp_divsmall(Fixed * a, uint64 divisor, int limbs)
+{
+  uint128 cur;
+  uint64 rem = 0;
+  int k;
+  for (k=limbs-1; k>=0; k--) {
+    cur = (((uint128)rem) << 64) | a->l[k];
+    a->l[k] = (uint64)(cur / divisor);
+    rem = (uint64)(cur % divisor);
+  }
+}
+
+
+
+/* multiply the unsigned number a by a small factor, in place */
+static inline void fp_mulsmall(Fixed * a, uint64 factor, int limbs)
+{
+  uint128 cur;
+  uint64 carry = 0;
+  int k;
+  for (k=0; k<limbs; k++) {
+    cur = (uint128)a->l[k] * factor + carry;
+    a->l[k] = (uint64)cur;
+    carry = (uint64)(cur >> 64);
+  }
+}
+
+
+
+int fp_limbs(float64 spacing)
+{
+  int bits, limbs;
+
+  if ( !(spacing > 0.) || (spacing >= 1.) )
+    bits = 64;
+  else
+    bits = 64 + (int)ceil(-log2(spacing));
+  limbs = 1 + (bits + 63) / 64;
+  return (limbs > FP_MAXLIMBS ? FP_MAXLIMBS : limbs);
+}
+
+
+
+int fp_from_string(Fixed * r, const char * str, int limbs)
+{
+  char digits[FP_MAXDIGITS];
+  int ndigits = 0;
+  int point = -1;     /* digits before the decimal point */
+  int negative = 0;
+  int exponent = 0;
+  uint64 whole = 0;
+  int k;
+  const char * p = str;
+
+  if ((r==NULL) || (str==NULL) || (limbs < 2) || (limbs > FP_MAXLIMBS))
+    return FP_BADNUM;
+
+  while (isspace(*p))
+    p++;
+  if ((*p == '-') || (*p == '+'))
+    negative = (*(p++) == '-');
+
+  for (; *p; p++) {
+    if (isdigit(*p)) {
+      if (ndigits == FP_MAXDIGITS)
+	return FP_BADNUM;
+      digits[ndigits++] = *p - '0';
+    } else if ((*p == '.') && (point < 0)) {
+      point = ndigits;
+    } else {
+      break;
+    }
+  }
+  if (ndigits == 0)
+    return FP_BADNUM;
+  if (point < 0)
+    point = ndigits;
+
+  if ((*p == 'e') || (*p == 'E')) {
+    char * end;
+    exponent = (int)strtol(p+1, &end, 10);
+    if (end == p+1)
+      return FP_BADNUM;
+    p = end;
+  }
+  while (isspace(*p))
+    p++;
+  if (*p != '\0')
+    return FP_BADNUM;
+
+  point += exponent;
+  if (point > 18)
+    return FP_BADNUM;
+
+  /* integer part */
+  for (k=0; k<point; k++)
+    whole = whole*10 + (k < ndigits ? digits[k] : 0);
+
+  /* fraction, from the last digit up: f = (d + f) / 10 */
+  fp_zero(r, limbs);
+  for (k=ndigits-1; k>=(point > 0 ? point : 0); k--) {
+    r->l[limbs-1] = digits[k];
+    fp_divsmall(r, 10, limbs);
+  }
+  for (k=point; k<0; k++)
+    fp_divsmall(r, 10, limbs);
+
+  r->l[limbs-1] = whole;
+  if (negative)
+    fp_neg(r, r, limbs);
+  return 0;
+}
+
+
+
+float64 fp_to_double(const Fixed * a, int limbs)
+{
+  Fixed m;
+  float64 d = 0.;
+  int k, stop;
+
+  if (FP_NEGATIVE(a,limbs)) {
+    fp_neg(&m, a, limbs);
+    a = &m;
+  }
+  /* three limbs from the leading one cover the 53 bits of a double */
+  for (k=limbs-1; (k>0) && (a->l[k]==0); k--)
+    ;
+  stop = (k > 2 ? k-2 : 0);
+  for (; k>=stop; k--)
+    d += ldexp((float64)(a->l[k]), 64*(k-(limbs-1)));
+  return (a == &m ? -d : d);
+}
+
+
+
+int fp_to_string(char * str, size_t size, const Fixed * a, int digits, int limbs)
+{
+  Fixed m, half;
+  size_t n;
+  int negative, k;
+
+  negative = FP_NEGATIVE(a,limbs);
+  memcpy(m.l, a->l, sizeof(uint64)*limbs);
+  if (negative)
+    fp_neg(&m, &m, limbs);
+
+  /* round half a unit in the last digit away from zero */
+  fp_zero(&half, limbs);
+  half.l[limbs-1] = 5;
+  for (k=0; k<=digits; k++)
+    fp_divsmall(&half, 10, limbs);
+  fp_add(&m, &m, &half, limbs);
+
+  n = snprintf(str, size, "%s%lu", (negative ? "-" : ""), m.l[limbs-1]);
+  if (n + 2 >= size)
+    return FP_BADNUM;
+  str[n++] = '.';
+  /* each digit is the integer part of ten times the fraction left */
+  for (k=0; k<digits; k++) {
+    if (n + 1 >= size)
+      return FP_BADNUM;
+    m.l[limbs-1] = 0;
+    fp_mulsmall(&m, 10, limbs);
+    str[n++] = '0' + (char)m.l[limbs-1];
+  }
+  while (str[n-1] == '0')
+    n--;
+  if (str[n-1] == '.')
+    n--;
+  str[n] = '\0';
+  if (strcmp(str, "-0") == 0)
+    strcpy(str, "0");
+  return 0;
+}
+
+
+
+void fp_add(Fixed * r, const Fixed * a, const Fixed * b, int limbs)
+{
+  uint64 carry = 0, s;
+  int k;
+  for (k=0; k<limbs; k++) {
+    s = a->l[k] + carry;
+    carry = (s < carry);
+    r->l[k] = s + b->l[k];
+    carry += (r->l[k] < s);
+  }
+}
+
+
+
+void fp_sub(Fixed * r, const Fixed * a, const Fixed * b, int limbs)
+{
+  Fixed nb;
+  fp_neg(&nb, b, limbs);
+  fp_add(r, a, &nb, limbs);
+}
+
+
+
+void fp_mul(Fixed * r, const Fixed * a, const Fixed * b, int limbs)
+{
+  Fixed ma, mb;
+  uint64 prod[2*FP_MAXLIMBS];
+  uint128 cur;
+  uint64 carry;
+  int negative = 0;
+  int i, j;
+
+  if (FP_NEGATIVE(a,limbs)) {
+    fp_neg(&ma, a, limbs);
+    negative = !negative;
+  } else {
+    ma = *a;
+  }
+  if (FP_NEGATIVE(b,limbs)) {
+    fp_neg(&mb, b, limbs);
+    negative = !negative;
+  } else {
+    mb = *b;
+  }
+
+  /* schoolbook product of the magnitudes */
+  memset(prod, 0, sizeof(uint64)*2*limbs);
+  for (i=0; i<limbs; i++) {
+    carry = 0;
+    for (j=0; j<limbs; j++) {
+      cur = (uint128)ma.l[i] * mb.l[j] + prod[i+j] + carry;
+      prod[i+j] = (uint64)cur;
+      carry = (uint64)(cur >> 64);
+    }
+    prod[i+limbs] = carry;
+  }
+
+  /* drop the extra fraction limbs */
+  memcpy(r->l, &(prod[limbs-1]), sizeof(uint64)*limbs);
+  if (negative)
+    fp_neg(r, r, limbs);
+}
+
+
+
+void fp_scale(Fixed * r, const Fixed * a, uint64 num, uint64 den, int limbs)
+{
+  int negative = FP_NEGATIVE(a,limbs);
+
+  if (negative)
+    fp_neg(r, a, limbs);
+  else if (r != a)
+    memcpy(r->l, a->l, sizeof(uint64)*limbs);
+  /* dividing first keeps the integer part from overflowing */
+  fp_divsmall(r, den, limbs);
+  fp_mulsmall(r, num, limbs);
+  if (negative)
+    fp_neg(r, r, limbs);
+}
@@ -0,0 +1,82 @@
+/****************************************************************************/
+/* fixedpoint.h: multiprecision fixed-point numbers for FRASCR libraries    */
+/*   Just enough arithmetic for computing a reference orbit at depths       */
+/*   float64 cannot resolve, and for moving between decimal options         */
+/*   exactly: add, subtract, multiply, scale by a fraction, parse and print */
+/*   a decimal string and round to float64. A number is held in two's       */
+/*   complement as limbs of 64 bits, least significant first; the last limb */
+/*   used is the integer part and the others are the fraction, so the       */
+/*   precision is 64*(limbs-1) bits after the point for numbers in          */
+/*   [-2^63, 2^63).                                                         */
+/*   Last updated: 2024 May                                                 */
+/****************************************************************************/
+/*  Author: Miguel Abele                                                    */
+/*  Copyrighted by Miguel Abele, 2024.                                      */
+/*                                                                          */
+/*  License information:                                                    */
+/*                                                                          */
+/*  This file is a part of the FRASCR application.                          */
+/*                                                                          */
+/*  FRASCR is free software; you can redistribute it and/or                 */
+/*  modify it under the terms of the GNU General Public License             */
+/*  as published by the Free Software Foundation; either version 3          */
+/*  of the License, or (at your option) any later version.                  */
+/*                                                                          */
+/*  FRASCR is distributed in the hope that it will be useful,               */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of          */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           */
+/*  GNU General Public License for more details.                            */
+/*                                                                          */
+/*  You should have received a copy of the GNU General Public License       */
+/*  along with this program; if not, write to the Free Software             */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor,                      */
+/*  Boston, MA  02110-1301, USA.                                            */
+/****************************************************************************/
+
+
+#ifndef FIXEDPOINT_H
+#define FIXEDPOINT_H
+
+
+#include "utils.h"
+
+
+#define FP_MAXLIMBS   20
+
+#define FP_BADNUM     -1
+
+
+struct fixed {
+  uint64 l[FP_MAXLIMBS];
+};
+typedef struct fixed Fixed;
+
+
+/* Number of limbs needed to resolve steps of size spacing, with 64 bits
+   to spare, no more than FP_MAXLIMBS */
+int fp_limbs(float64 spacing);
+
+/* Parse a plain decimal number, e.g. "-0.7436438870371587047521915061",
+   optionally with an exponent, e.g. "1.25e-3". Returns 0 or FP_BADNUM. */
+int fp_from_string(Fixed * r, const char * str, int limbs);
+
+float64 fp_to_double(const Fixed * a, int limbs);
+
+/* Write a in decimal with at most digits after the point, rounded and
+   without trailing zeros, into str of size bytes. Returns 0 or
+   FP_BADNUM if it does not fit. */
+int fp_to_string(char * str, size_t size, const Fixed * a, int digits, int limbs);
+
+void fp_add(Fixed * r, const Fixed * a, const Fixed * b, int limbs);
+
+void fp_sub(Fixed * r, const Fixed * a, const Fixed * b, int limbs);
+
+/* r may be the same as a or b */
+void fp_mul(Fixed * r, const Fixed * a, const Fixed * b, int limbs);
+
+/* r = a * num / den, for num <= den; exact to within num units in the
+   last place */
+void fp_scale(Fixed * r, const Fixed * a, uint64 num, uint64 den, int limbs);
+
+
+#endif /* FIXEDPOINT_H */
@@ -0,0 +1,132 @@
+/****************************************************************************/
+/* frd.h: the .frd canvas dump of the FRASCR application                    */
+/*   A dump is one header of FRD_HEADER bytes and then the canvases of a    */
+/*   run, one after another, each as the compact canvases of utils.h lay    */
+/*   them out: counts of 16 or 32 bits, row by row from the bottom of the   */
+/*   view, every row padded to CANVAS_ALIGN bytes. The header records the   */
+/*   shape, the domain, the escape limit and the EXECUTE library that made  */
+/*   it. Everything is in the byte order and struct layout of the machine   */
+/*   that wrote it; byteorder tells a foreign dump from a good one. Written */
+/*   by libfrd.so, read (mapped, not copied) by librecolor.so.              */
+/*   Last updated: 2024 June                                                */
+/****************************************************************************/
+/*  Author: Miguel Abele                                                    */
+/*  Copyrighted by Miguel Abele, 2024.                                      */
+/*                                                                          */
+/*  License information:                                                    */
+/*                                                                          */
+/*  This file is a part of the FRASCR application.                          */
+/*                                                                          */
+/*  FRASCR is free software; you can redistribute it and/or                 */
+/*  modify it under the terms of the GNU General Public License             */
+/*  as published by the Free Software Foundation; either version 3          */
+/*  of the License, or (at your option) any later version.                  */
+/*                                                                          */
+/*  FRASCR is distributed in the hope that it will be useful,               */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of          */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           */
+/*  GNU General Public License for more details.                            */
+/*                                                                          */
+/*  You should have received a copy of the GNU General Public License       */
+/*  along with this program; if not, write to the Free Software             */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor,                      */
+/*  Boston, MA  02110-1301, USA.                                            */
+/****************************************************************************/
+
+
+#ifndef FRD_H
+#define FRD_H
+
+
+#include "utils.h"
+#include <string.h>
+
+
+#define FRD_MAGIC      "FRD1"
+#define FRD_BYTEORDER  0x01020304
+/* bytes before the first canvas, a multiple of CANVAS_ALIGN */
+#define FRD_HEADER     512
+#define FRD_NAME       256
+
+
+struct frd_header {
+  char magic[4];
+  uint32 byteorder;    /* FRD_BYTEORDER as the writer stored it */
+  uint32 header;       /* bytes before the first canvas */
+  uint32 canvl;
+  uint32 nx, ny;
+  uint32 stride;       /* counts per row, with the padding */
+  uint32 format;       /* CANVAS_N16 or CANVAS_N32 */
+  uint32 escape;
+  uint32 reserved;
+  uint64 canvasbytes;  /* bytes per canvas, a multiple of CANVAS_ALIGN */
+  float64 left, bottom, width, height;
+  float64 coord_Re, coord_Im;
+  char algorithm[FRD_NAME];
+};
+typedef struct frd_header FrdHeader;
+
+
+/* the layout of canvl canvases nx by ny in format */
+static inline void frd_layout(FrdHeader * fh,
+			      uint32 canvl,
+			      uint32 nx,
+			      uint32 ny,
+			      int format)
+{
+  size_t size = (format == CANVAS_N16 ? sizeof(uint16) : sizeof(uint32));
+  uint32 pad = CANVAS_ALIGN / size;
+
+  memset(fh, 0, sizeof(FrdHeader));
+  memcpy(fh->magic, FRD_MAGIC, 4);
+  fh->byteorder = FRD_BYTEORDER;
+  fh->header = FRD_HEADER;
+  fh->canvl = canvl;
+  fh->nx = nx;
+  fh->ny = ny;
+  fh->stride = (nx + pad - 1) / pad * pad;
+  fh->format = format;
+  fh->canvasbytes = size * (uint64)fh->stride * ny;
+}
+
+
+/* nonzero unless fh is a dump this machine can read, of filesize bytes */
+static inline int frd_check(const FrdHeader * fh, uint64 filesize)
+{
+  size_t size;
+
+  if ((filesize < sizeof(FrdHeader)) || memcmp(fh->magic, FRD_MAGIC, 4)
+      || (fh->byteorder != FRD_BYTEORDER))
+    return 1;
+  if ((fh->format != CANVAS_N16) && (fh->format != CANVAS_N32))
+    return 1;
+  size = (fh->format == CANVAS_N16 ? sizeof(uint16) : sizeof(uint32));
+  if ((fh->canvl == 0) || (fh->nx == 0) || (fh->ny == 0) || (fh->stride < fh->nx)
+      || (fh->header < sizeof(FrdHeader)) || (fh->header % CANVAS_ALIGN)
+      || (fh->canvasbytes != size * (uint64)fh->stride * fh->ny))
+    return 1;
+  /* divided rather than multiplied, so a forged header cannot overflow */
+  if ((fh->header > filesize)
+      || (fh->canvl > (filesize - fh->header) / fh->canvasbytes))
+    return 1;
+  return 0;
+}
+
+
+/* canvas k of the dump at base, in place */
+static inline void frd_canvas(const FrdHeader * fh, void * base, uint32 k, Canvas * c)
+{
+  c->data = NULL;
+  c->cols = NULL;
+  c->counts = (char *)base + fh->header + fh->canvasbytes * k;
+  c->nx = c->vnx = fh->nx;
+  c->ny = c->vny = fh->ny;
+  c->stride = fh->stride;
+  c->order = CANVAS_ROWS;
+  c->format = fh->format;
+  c->i0 = c->j0 = 0;
+  canvas_grid(c, fh->left, fh->bottom, fh->width, fh->height);
+}
+
+
+#endif /* FRD_H */
@@ -9,6 +9,10 @@
 /*   tionality.                                                             */
 /*   For a finishing library, this outputs only a single double array of    */
 /*   unsigned ints.                                                         */
+/*   Also provides TILE_SETUP and EXECUTE_TILE so that the core can drive   */
+/*   the computation itself (see engine.h). Orbits are checked for cycles   */
+/*   per the canvas option "periodicity" (periodicity.h); with 2, the       */
+/*   periods are output as a second canvas.                                 */
 /*   Last updated: 2024 May                                                 */
 /****************************************************************************/
 /*  Author: Miguel Abele                                                    */
@@ -36,12 +40,12 @@
 
 
 #include "libbrd.h"
+#include "periodicity.h"
 #include <stdlib.h>
 #include <math.h>
 
 
-#define FREE_DBL_ARRAY(arr,l,m) { if ((arr)) { for (l=0; l<m; l++) { free((arr)[l]); } free((arr)); (arr)=NULL; } }
-#define CLOSE_FILE_ARRAY(arr,l,m) { if ((arr)) { for (l=0; l<m; l++) { if ((arr)[l]) fclose((arr)[l]); free((arr)); (arr)=NULL; } } }
+#define CLOSE_FILE_ARRAY(arr,l,m) { if ((arr)) { for (l=0; l<m; l++) { if ((arr)[l]) output_close((arr)[l]); } free((arr)); (arr)=NULL; } }
 
 
 struct secondary_option {
@@ -51,6 +55,10 @@ struct secondary_option {
 typedef struct secondary_option SecondaryOpts;
 
 
+/* options parsed by TILE_SETUP for use by every EXECUTE_TILE call */
+static SecondaryOpts tilesecopts;
+
+
 static inline int process_sec_opts(char ** const src, const uint32 l, SecondaryOpts * targ) {
   if ((src==NULL) || (targ==NULL))
     return LIBBADCALL;
@@ -63,83 +71,30 @@ static inline int process_sec_opts(char ** const src, const uint32 l, SecondaryO
 
 
 
-int EXECUTE(CanvasOpts * canvopts,
-	    void (*finfunc)(),
-	    int (*validfunc)(),
-	    char ** outfn,
-	    uint32 outfl)
+/* compute the pixels [i0,i0+w) x [j0,j0+h): pixel (i,j) is stored at
+   canv[(i-i0)*stride + (j-j0)], and its period, if percanv is given, at the
+   same place in percanv */
+static void brd_region(CanvasOpts * canvopts,
+		       SecondaryOpts * secopts,
+		       uint32 i0,
+		       uint32 j0,
+		       uint32 w,
+		       uint32 h,
+		       Datum * canv,
+		       Datum * percanv,
+		       uint32 stride)
 {
-  /* The data holders used in execute */
-  Datum ** canv;
-  /* Validator will check dataa and datal, outfa and outfl.
-     dataa must be one spot for each data holder used above, datal the total num.
-     outfa is the array of file pointers, and outfl the total num. */
-  Datum *** canva = NULL;
-  const uint32 canvl = 1;
-  FILE ** outfa = NULL;
-  /* variables local to execute */
   float64 x, y, expbuf, inner, x0, y0, left, bottom, width, height;
   float64 lamexp1, lamexp2, cosy, siny;
-  uint32 n, max;
+  uint32 n, max, p;
+  float64 tolsq;
+  PeriodCheck pc;
   float64 w_re, w_im;
   float64 lam_re, lam_im, rhol, thetal;
   float64 biggerbound;
   uint32 nx, ny;
+  uint32 k;
   int i, j;
-  SecondaryOpts secopts;
-  int ret;
-
-  if ( (canvopts==NULL) || (finfunc==NULL) || (validfunc==NULL) || (outfn==NULL) )
-    return LIBBADCALL;
-
-  ret = process_sec_opts(canvopts->secondary, canvopts->secondaryl, &secopts);
-  if (ret)
-    return ret;
-
-  /* setup memory and organize for validator */
-
-  canv = malloc(sizeof(Datum *)*canvopts->nwidth);
-  if (canv == NULL)
-    return LIBMALLOC;
-  for (i=0; i<canvopts->nwidth; i++) {
-    canv[i] = malloc(sizeof(Datum)*canvopts->nheight);
-    if (canv[i-1] == NULL) {
-      FREE_DBL_ARRAY(canv,j,i-2);
-      return LIBMALLOC;
-    }
-  }
-
-  canva = malloc(sizeof(Datum **)*canvl);
-  if (canva == NULL) {
-    FREE_DBL_ARRAY(canv,j,canvopts->nwidth);
-    return LIBMALLOC;
-  }
-  canva[0] = canv;
-
-  outfa = malloc(sizeof(FILE *)*outfl);
-  if (outfa == NULL) {
-    FREE_DBL_ARRAY(canv,j,canvopts->nwidth);
-    free(canva);
-    return LIBMALLOC;
-  }
-  for (i=0; i<outfl; i++) {
-    outfa[i] = fopen(outfn[i], "wb");
-    if (!outfa[i-1]) {
-      CLOSE_FILE_ARRAY(outfa,j,i-2);
-      FREE_DBL_ARRAY(canv,j,canvopts->nwidth);
-      free(canva);
-      return LIBFILE;
-    }
-  }
-
-  if (validfunc(canva, canvl, outfa, outfl) != 0) {
-    FREE_DBL_ARRAY(canv,j,canvopts->nwidth);
-    free(canva);
-    CLOSE_FILE_ARRAY(outfa,j,outfl);
-    return LIBVALIDATE;
-  }
-
-  /* need to "palettize" here */
 
   left = canvopts->left;
   nx = canvopts->nwidth;
@@ -148,19 +103,20 @@ int EXECUTE(CanvasOpts * canvopts,
   ny = canvopts->nheight;
   height = canvopts->height;
   max = canvopts->escape;
-  w_re = secopts.wre;
-  w_im = secopts.wim;
-
-  /* core functionality, execute */
+  w_re = secopts->wre;
+  w_im = secopts->wim;
+  tolsq = period_tolerance(canvopts->periodicity,
+			   (width/(float64)nx < height/(float64)ny ? width/(float64)nx : height/(float64)ny));
 
-  for (i=0; i<nx; i++) {
-    for (j=0; j<ny; j++) {
+  for (i=i0; i<i0+w; i++) {
+    for (j=j0; j<j0+h; j++) {
 
       lam_re = left + ((float64)i) * width / ((float64)nx);
       lam_im = bottom + ((float64)j) * height / ((float64)ny);
       rhol = sqrt(lam_re*lam_re + lam_im*lam_im);
       thetal = atan2(lam_im, lam_re);
 
+      p = 0;
       if ( lam_re > 50. ) {
 	n = 0;
       } else {
@@ -168,6 +124,7 @@ int EXECUTE(CanvasOpts * canvopts,
 	x = 0.;
 	y = 0.;
 	n = 0;
+	period_start(&pc, x, y, tolsq);
 
 	while ( n < max ) {
 	  
@@ -177,6 +134,10 @@ int EXECUTE(CanvasOpts * canvopts,
 	    x = expbuf*cos(inner);
 	    y = expbuf*sin(inner);
 	    n += 1;
+	    if ( (tolsq > 0.) && (p = period_step(&pc, x, y)) ) {
+	      n = max;
+	      break;
+	    }
 	  }
 	  else
 	    break; 
@@ -185,23 +146,121 @@ int EXECUTE(CanvasOpts * canvopts,
 
       } /* else */
       
-      canv[i][j].re = lam_re;
-      canv[i][j].im = lam_im;
-      canv[i][j].n = n;
+      k = (i-i0)*stride + (j-j0);
+      canv[k].re = lam_re;
+      canv[k].im = lam_im;
+      canv[k].n = n;
+      if (percanv) {
+	percanv[k].re = lam_re;
+	percanv[k].im = lam_im;
+	percanv[k].n = p;
+      }
       
     } /* for j */
   } /* for i */
 
+}
+
+
+
+int EXECUTE(CanvasOpts * canvopts,
+	    void (*finfunc)(),
+	    int (*validfunc)(),
+	    char ** outfn,
+	    uint32 outfl)
+{
+  /* The data holders used in execute */
+  /* Validator will check dataa and datal, outfa and outfl.
+     dataa must be one spot for each data holder used above, datal the total num.
+     outfa is the array of file pointers, and outfl the total num. */
+  Canvas * canva = NULL;
+  uint32 canvl;
+  FILE ** outfa = NULL;
+  /* variables local to execute */
+  int i, j;
+  SecondaryOpts secopts;
+  int ret;
+
+  if ( (canvopts==NULL) || (finfunc==NULL) || (validfunc==NULL) || (outfn==NULL) )
+    return LIBBADCALL;
+
+  ret = process_sec_opts(canvopts->secondary, canvopts->secondaryl, &secopts);
+  if (ret)
+    return ret;
+  canvl = (canvopts->periodicity == PERIOD_CANVAS ? 2 : 1);
+
+  /* setup memory and organize for validator */
+
+  canva = canvas_alloc_set(canvl, canvopts->nwidth, canvopts->nheight, CANVAS_COLUMNS, CANVAS_FULL);
+  if (canva == NULL)
+    return LIBMALLOC;
+
+  outfa = malloc(sizeof(FILE *)*outfl);
+  if (outfa == NULL) {
+    canvas_free_set(canva, canvl);
+    return LIBMALLOC;
+  }
+  for (i=0; i<outfl; i++) {
+    outfa[i] = output_open(outfn[i]);
+    if (!outfa[i-1]) {
+      CLOSE_FILE_ARRAY(outfa,j,i-2);
+      canvas_free_set(canva, canvl);
+      return LIBFILE;
+    }
+  }
+
+  if (validfunc(canva, canvl, outfa, outfl) != 0) {
+    canvas_free_set(canva, canvl);
+    CLOSE_FILE_ARRAY(outfa,j,outfl);
+    return LIBVALIDATE;
+  }
+
+  /* core functionality, execute */
+
+  brd_region(canvopts, &secopts, 0, 0, canvopts->nwidth, canvopts->nheight,
+	     canva[0].data, (canvl == 2 ? canva[1].data : NULL), canva[0].stride);
+
   /* output results */
 
   finfunc(canvopts, canva, canvl, outfa, outfl);
 
-  FREE_DBL_ARRAY(canv,i,canvopts->nwidth);
-  if (canva)
-    free(canva);
+  canvas_free_set(canva, canvl);
   CLOSE_FILE_ARRAY(outfa,i,outfl);
   
   return 0;
   
 }
 
+
+
+int TILE_SETUP(CanvasOpts * canvopts)
+{
+  int ret;
+
+  if (canvopts==NULL)
+    return LIBBADCALL;
+
+  ret = process_sec_opts(canvopts->secondary, canvopts->secondaryl, &tilesecopts);
+  if (ret)
+    return ret;
+
+  return (canvopts->periodicity == PERIOD_CANVAS ? 2 : 1);
+}
+
+
+
+int EXECUTE_TILE(CanvasOpts * canvopts,
+		 uint32 x0,
+		 uint32 y0,
+		 uint32 w,
+		 uint32 h,
+		 Datum * tile)
+{
+  if ( (canvopts==NULL) || (tile==NULL) )
+    return LIBBADCALL;
+
+  brd_region(canvopts, &tilesecopts, x0, y0, w, h, tile,
+	     (canvopts->periodicity == PERIOD_CANVAS ? &(tile[w*h]) : NULL), h);
+
+  return 0;
+}
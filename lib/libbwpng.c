@@ -31,6 +31,7 @@
 
 #include "libbwpng.h"
 #include "bitorder.h"
+#include "pngpar.h"
 #include <stdlib.h>
 #include <string.h>
 #include <png.h>
@@ -47,37 +48,105 @@ static inline void * byte_n_switch_16(void * destn, const void * source, size_t
 }
 
 
-static inline uint32 find_max_intensity(Datum ** const dat,
-					   const int rows,
-					   const int cols)
+/* bytes per sample, and how to store a sample, for a channel depth */
+static inline int select_bytecopy(int depth,
+				  int * datasize,
+				  void *(**bytecopy)(void *, const void *, size_t))
 {
-  int i, j;
-  uint32 n;
-  uint32 max = 0;
-  for (i=0; i<rows; i++) {
-    for (j=0; j<cols; j++) {
-      n = dat[i][j].n;
-      if (n > max)
-	max = n;
-    }
+  if (depth == 8) {
+    *bytecopy = memcpy;
+    *datasize = sizeof(uint8);
+    return 0;
+  }
+  *datasize = sizeof(uint16);
+  switch (O32_HOST_ORDER) {
+  case O32_LITTLE_ENDIAN:
+    *bytecopy = byte_n_switch_16;
+    return 0;
+  case O32_BIG_ENDIAN:
+    *bytecopy = memcpy;
+    return 0;
+  default:
+    return 1;
   }
+}
+
+
+/* image row from canvas row j, in (for now) black & white */
+static inline void fill_row(png_byte * row,
+			    const Canvas * canvas,
+			    uint32 j,
+			    uint32 intensitymax,
+			    int datasize,
+			    void *(*bytecopy)(void *, const void *, size_t))
+{
+  uint32 i;
+  double storevald;
 
-  return max;
+  for (i=0; i<canvas->nx; i++) {
+    storevald = intensitymax == 0 ? 0.0 : (double)(canvas_n(canvas, i, j)) / (double)(intensitymax);
+    bytecopy(&(row[datasize*i]), (void *)(&storevald), datasize);
+  }
+}
+
+
+/* the text chunks, which stay allocated until the image is written */
+static png_text * set_text_fields(png_structp pngptr, png_infop infoptr)
+{
+  const int textfields = 3;
+  png_text * textptr;
+
+  textptr = malloc(sizeof(png_text)*textfields);
+  if (textptr) {
+    textptr[0].compression = PNG_TEXT_COMPRESSION_NONE;
+    textptr[0].key = "Title";
+    textptr[0].text = "Frascr output image";
+    textptr[0].text_length = strlen(textptr[0].text);
+    textptr[0].lang = NULL;
+    textptr[1].compression = PNG_TEXT_COMPRESSION_NONE;
+    textptr[1].key = "Author";
+    textptr[1].text = "eightbitastronomy";
+    textptr[1].text_length = strlen(textptr[1].text);
+    textptr[1].lang = NULL;
+    //fprintf(stderr, "text 1: [key] %s [len] %d [text] %s [len] %d\n",
+    //            textptr[1].key, strlen(textptr[1].key), textptr[1].text, textptr[1].text_length);
+    //fprintf(stderr, "setting text 2\n");
+    textptr[2].compression = PNG_TEXT_COMPRESSION_NONE;
+    textptr[2].key = "Description";
+    //fprintf(stderr,"about to sprintf\n");
+    //sprintf(texttmp, "Size %d x %d. Color type %s. Re domain: [ %f , %f ]. Im domain: [ %f , %f ]. Offset: %f + i %f. Escape: %d",
+    //opts->nwidth, opts->nheight, "Gray", opts->left, opts->left + opts->width,
+    //opts->bottom, opts->bottom + opts->height, opts->coord_Re, opts->coord_Im,
+    //opts->escape);
+    //1, 2, "Gray", 4.0, 5.0, 6.0, 7.0, 8.0, 9.0, 10);
+    //textptr[2].text_length = strlen(texttmp);
+    //strncpy(textptr[2].text, texttmp, textptr[2].text_length);
+    textptr[2].text = "Some shit";
+    textptr[2].text_length = strlen(textptr[2].text);
+    textptr[2].lang = NULL;
+    //fprintf(stderr, "text 2: [key] %s [len] %d [text] %s [len] %d\n",
+    //            textptr[2].key, strlen(textptr[2].key), textptr[2].text, textptr[2].text_length);
+    //fflush(stderr);
+    //fprintf(stderr, "png_set_text\n");
+    png_set_text(pngptr, infoptr, textptr, textfields);
+  }
+
+  return textptr;
 }
 
 
 void FINISH(CanvasOpts * opts,
-	    Datum *** dataa,
+	    Canvas * dataa,
 	    int datal,
 	    FILE ** filea,
 	    int filel)
 {
 
-  int i, j;
+  int i;
 
   /* Data & control variables */
   int max, rno;
-  Datum ** canvas;
+  Canvas * canvas;
   FILE * output;
 
   /* libpng variables */ 
@@ -85,15 +154,14 @@ void FINISH(CanvasOpts * opts,
   png_structp pngptr = NULL;
   png_infop infoptr = NULL;
   png_text * textptr = NULL;
-  const int textfields = 3;
   char texttmp[511];
   png_byte ** rows;
+  PngPar pp;
 
   /* Intensity conversion helpers */
   uint16 MAX_VAL = ~(unsigned short)(0);
   int datasize;
   uint32 intensitymax;
-  double storevald;
 
   /* Intensity-to-libpng helpers */
   void *(*bytecopy)(void *, const void *, size_t);
@@ -103,7 +171,7 @@ void FINISH(CanvasOpts * opts,
   for (rno=0; rno<max; rno++) {
 
     output = filea[rno];
-    canvas = dataa[rno];
+    canvas = &(dataa[rno]);
     
     pngptr = png_create_write_struct(PNG_LIBPNG_VER_STRING,
 				     errorptr,
@@ -126,95 +194,40 @@ void FINISH(CanvasOpts * opts,
 
     png_init_io(pngptr, output);
 
-    /* only support on/off for compression at the moment */
-    if (opts->visuals.compression == 0) {
-      png_set_compression_level(pngptr, Z_NO_COMPRESSION);
-    } else {
-      png_set_compression_level(pngptr, Z_BEST_COMPRESSION); // if compile err, try include zlib.h
-    }
     
     png_set_IHDR(pngptr, infoptr, opts->nwidth, opts->nheight, opts->visuals.depth,
 		 PNG_COLOR_TYPE_GRAY, PNG_INTERLACE_NONE,
 		 PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
     
     /* set text fields */
-    textptr = malloc(sizeof(png_text)*textfields);
-    if (textptr) {
-      textptr[0].compression = PNG_TEXT_COMPRESSION_NONE;
-      textptr[0].key = "Title";
-      textptr[0].text = "Frascr output image";
-      textptr[0].text_length = strlen(textptr[0].text);
-      textptr[0].lang = NULL;
-      textptr[1].compression = PNG_TEXT_COMPRESSION_NONE;
-      textptr[1].key = "Author";
-      textptr[1].text = "eightbitastronomy";
-      textptr[1].text_length = strlen(textptr[1].text);
-      textptr[1].lang = NULL;
-      //fprintf(stderr, "text 1: [key] %s [len] %d [text] %s [len] %d\n",
-      //	    textptr[1].key, strlen(textptr[1].key), textptr[1].text, textptr[1].text_length);
-      //fprintf(stderr, "setting text 2\n");
-      textptr[2].compression = PNG_TEXT_COMPRESSION_NONE;
-      textptr[2].key = "Description";
-      //fprintf(stderr,"about to sprintf\n");
-      //sprintf(texttmp, "Size %d x %d. Color type %s. Re domain: [ %f , %f ]. Im domain: [ %f , %f ]. Offset: %f + i %f. Escape: %d",
-      //opts->nwidth, opts->nheight, "Gray", opts->left, opts->left + opts->width,
-      //opts->bottom, opts->bottom + opts->height, opts->coord_Re, opts->coord_Im,
-      //opts->escape);
-      //1, 2, "Gray", 4.0, 5.0, 6.0, 7.0, 8.0, 9.0, 10);
-      //textptr[2].text_length = strlen(texttmp);
-      //strncpy(textptr[2].text, texttmp, textptr[2].text_length);
-      textptr[2].text = "Some shit";
-      textptr[2].text_length = strlen(textptr[2].text);
-      textptr[2].lang = NULL;
-      //fprintf(stderr, "text 2: [key] %s [len] %d [text] %s [len] %d\n",
-      //	    textptr[2].key, strlen(textptr[2].key), textptr[2].text, textptr[2].text_length);
-      //fflush(stderr);
-      //fprintf(stderr, "png_set_text\n");
-      png_set_text(pngptr, infoptr, textptr, textfields);
-    }
+    textptr = set_text_fields(pngptr, infoptr);
 
     /* find maximum intensity */
 
-    intensitymax = find_max_intensity(canvas, opts->nwidth, opts->nheight);
+    intensitymax = canvas_max_n(canvas);
     
     /* transpose input data for libpng, and (for now) scale data into black & white */
 
     rows = malloc(sizeof(png_byte *)*opts->nheight);
-    if (opts->visuals.depth == 8) {
-      bytecopy = memcpy;
-      datasize = sizeof(uint8);\
-    } else {
-      datasize = sizeof(uint16);
-      switch (O32_HOST_ORDER) {
-      case O32_LITTLE_ENDIAN:
-	bytecopy = byte_n_switch_16;
-	break;
-      case O32_BIG_ENDIAN:
-	bytecopy = memcpy;
-	break;
-      default:
-	return; //I'm not handling PDP or HONEYWELL at the moment
-      }
-
-    }
+    if (select_bytecopy(opts->visuals.depth, &datasize, &bytecopy))
+      return; //I'm not handling PDP or HONEYWELL at the moment
     for (i=0; i<opts->nheight; i++)
       rows[i] = malloc(sizeof(png_byte)*opts->nwidth*datasize);
 
-    for (i=0; i<opts->nheight; i++) {
-      for (j=0; j<opts->nwidth; j++) {
-	storevald = intensitymax == 0 ? 0.0 : (double)(canvas[j][i].n) / (double)(intensitymax);
-	bytecopy(&(rows[opts->nheight-i-1][datasize*j]), (void *)(&storevald), datasize);
-      }
-    }
+    for (i=0; i<opts->nheight; i++)
+      fill_row(rows[opts->nheight-i-1], canvas, i, intensitymax, datasize, bytecopy);
     
     png_write_info(pngptr, infoptr);
-    png_set_rows(pngptr, infoptr, rows);  
-    
-    /* Write/Output */
     
-    png_write_png(pngptr, infoptr, PNG_TRANSFORM_IDENTITY, NULL);
-    png_write_image(pngptr, rows);
-    png_write_end(pngptr, infoptr);
+    /* Write/Output: libpng has written the header, the image data is
+       filtered and deflated on several threads */
+
+    if (pngpar_begin(&pp, pngptr, opts->nwidth*datasize, datasize, &(opts->visuals), opts->threads) == 0) {
+      if (pngpar_rows(&pp, rows, opts->nheight) == 0)
+	pngpar_end(&pp);
+      else
+	pngpar_free(&pp);
+    }
     
     /* Cleanup */
 
@@ -235,7 +248,160 @@ void FINISH(CanvasOpts * opts,
 }
 
 
-int VALIDATE(Datum *** dataa,
+/* One png per canvas being written band by band (see engine.h). Bands are
+   scaled by the escape limit, since the maximum is not known until the
+   end; this is the maximum whenever the view has interior points. */
+
+struct png_stream {
+  png_structp pngptr;
+  png_infop infoptr;
+  png_text * textptr;
+  PngPar pp;
+  png_byte * band;     /* rows of the band being written */
+  png_byte ** rows;
+  uint32 bandrows;     /* rows band has room for */
+};
+typedef struct png_stream PngStream;
+
+static PngStream * streams = NULL;
+static int streaml = 0;
+static int streamsize;
+static void *(*streamcopy)(void *, const void *, size_t);
+
+
+static void end_streams(int write)
+{
+  int rno;
+  PngStream * ps;
+
+  for (rno=0; rno<streaml; rno++) {
+    ps = &(streams[rno]);
+    if (ps->pngptr) {
+      if (write && !setjmp(png_jmpbuf(ps->pngptr)))
+	pngpar_end(&(ps->pp));
+      png_destroy_write_struct(&(ps->pngptr), &(ps->infoptr));
+    }
+    pngpar_free(&(ps->pp));
+    free(ps->textptr);
+    free(ps->band);
+    free(ps->rows);
+  }
+  free(streams);
+  streams = NULL;
+  streaml = 0;
+}
+
+
+static int begin_stream(CanvasOpts * opts, FILE * output, PngStream * ps)
+{
+  ps->pngptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  if (!ps->pngptr)
+    return PW_PNG_WRITE;
+  ps->infoptr = png_create_info_struct(ps->pngptr);
+  if (!ps->infoptr)
+    return PW_PNG_WRITE;
+
+  if (setjmp(png_jmpbuf(ps->pngptr)))
+    return PW_PNG_WRITE;
+
+  png_init_io(ps->pngptr, output);
+  png_set_IHDR(ps->pngptr, ps->infoptr, opts->nwidth, opts->nheight, opts->visuals.depth,
+	       PNG_COLOR_TYPE_GRAY, PNG_INTERLACE_NONE,
+	       PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+  ps->textptr = set_text_fields(ps->pngptr, ps->infoptr);
+  png_write_info(ps->pngptr, ps->infoptr);
+  if (pngpar_begin(&(ps->pp), ps->pngptr, opts->nwidth*streamsize, streamsize,
+		   &(opts->visuals), opts->threads))
+    return PW_MALLOC;
+  return 0;
+}
+
+
+/* room in the stream for a band of n rows */
+static int band_rows(PngStream * ps, uint32 n, uint32 rowbytes)
+{
+  uint32 j;
+
+  if (n <= ps->bandrows)
+    return 0;
+  free(ps->band);
+  free(ps->rows);
+  ps->bandrows = 0;
+  ps->band = malloc(sizeof(png_byte)*rowbytes*n);
+  ps->rows = malloc(sizeof(png_byte *)*n);
+  if ((ps->band == NULL) || (ps->rows == NULL))
+    return PW_MALLOC;
+  for (j=0; j<n; j++)
+    ps->rows[j] = ps->band + (size_t)j*rowbytes;
+  ps->bandrows = n;
+  return 0;
+}
+
+
+int FINISH_BEGIN(CanvasOpts * opts,
+		 int datal,
+		 FILE ** filea,
+		 int filel)
+{
+  int rno, ret;
+
+  if ((opts==NULL) || (filea==NULL) || (datal < 1) || (filel < 1))
+    return PW_BAD_CALL;
+  if (select_bytecopy(opts->visuals.depth, &streamsize, &streamcopy))
+    return PW_BAD_CALL;
+
+  streaml = (datal <= filel ? datal : filel);
+  streams = calloc(streaml, sizeof(PngStream));
+  if (streams == NULL) {
+    streaml = 0;
+    return PW_MALLOC;
+  }
+  for (rno=0; rno<streaml; rno++) {
+    ret = begin_stream(opts, filea[rno], &(streams[rno]));
+    if (ret) {
+      end_streams(0);
+      return ret;
+    }
+  }
+  return 0;
+}
+
+
+int FINISH_BAND(CanvasOpts * opts,
+		Canvas * banda,
+		int datal)
+{
+  int rno;
+  uint32 j;
+  PngStream * ps;
+
+  if ((banda==NULL) || (datal < streaml))
+    return PW_BAD_CALL;
+
+  for (rno=0; rno<streaml; rno++) {
+    ps = &(streams[rno]);
+    if (band_rows(ps, banda[rno].ny, opts->nwidth*streamsize))
+      return PW_MALLOC;
+    /* the image runs top down, the canvas bottom up */
+    for (j=0; j<banda[rno].ny; j++)
+      fill_row(ps->rows[j], &(banda[rno]), banda[rno].ny-j-1, opts->escape, streamsize, streamcopy);
+    if (setjmp(png_jmpbuf(ps->pngptr)))
+      return PW_PNG_WRITE;
+    if (pngpar_rows(&(ps->pp), ps->rows, banda[rno].ny))
+      return PW_PNG_WRITE;
+  }
+  return 0;
+}
+
+
+void FINISH_END(CanvasOpts * opts)
+{
+  end_streams(1);
+}
+
+
+
+int VALIDATE(Canvas * dataa,
 	    int datal,
 	    FILE ** filea,
 	    int filel)
@@ -249,15 +415,13 @@ int VALIDATE(Datum *** dataa,
     return PW_BAD_CALL;
 
   for (i=0; i<datal; i++) {
-    if (dataa[i] == NULL)
+    if ((dataa[i].data == NULL) && (dataa[i].counts == NULL))
       return PW_BAD_CALL;
   }
 
   for (i=0; i<filel; i++) {
     if (filea[i] == NULL)
       return PW_BAD_CALL;
-    if (ftell(filea[0]) < 0)
-      return PW_BAD_CALL;
   }
 
   return 0;
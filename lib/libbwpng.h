@@ -1,6 +1,8 @@
 /****************************************************************************/
 /* Libbwpng.h: printing shared object for the FRASCR application.           */
-/*   Provides a FINISH function and VALIDATE function.                      */
+/*   Provides a FINISH function and VALIDATE function, and FINISH_BEGIN,    */
+/*   FINISH_BAND and FINISH_END to write the rows as the bands of a         */
+/*   streamed canvas arrive (see engine.h).                                 */
 /*   FINISH outputs black and white png files by converting unsigned        */
 /*   integer data into an intensity.                                        */
 /****************************************************************************/
@@ -38,13 +40,27 @@
 
 
 void FINISH(CanvasOpts * opts,
-	    Datum *** dataa,
+	    Canvas * dataa,
 	    int datal,
 	    FILE ** filea,
 	    int filel);
 
 
-int VALIDATE(Datum *** dataa,
+int FINISH_BEGIN(CanvasOpts * opts,
+		 int datal,
+		 FILE ** filea,
+		 int filel);
+
+
+int FINISH_BAND(CanvasOpts * opts,
+		Canvas * banda,
+		int datal);
+
+
+void FINISH_END(CanvasOpts * opts);
+
+
+int VALIDATE(Canvas * dataa,
 	    int datal,
 	    FILE ** filea,
 	    int filel);
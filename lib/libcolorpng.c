@@ -35,7 +35,8 @@
 #include "options.h"
 #include "utils.h"
 #include "color.h"
-#include "bitorder.h"
+#include "colorrow.h"
+#include "pngpar.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
@@ -44,88 +45,78 @@
 #include <zlib.h>
 
 
-#define MAX_SHORT      ((unsigned short)~(0))
-#define MAX_INT        ((unsigned int)~(0)) 
-
-
-static inline void * byte_n_switch_16(void * destn, const void * source, size_t sz) {
-  int i;
-  unsigned char * dest = destn;
-  const unsigned char * src = source;
-  //for (i=0; i<sz; i++) {
-  //  *(dest + i) = *(src + i);
-  //}
-  /*for (i=0; i<sz; i++) 
-    if (i % 2 == 0)
-    *(dest + i/2) = *(src + i);*/
-  *(dest) = *(src + 1);
-  *(dest + 1) = *(src);
-  *(dest + 2) = *(src + 3);
-  *(dest + 3) = *(src + 2);
-  *(dest + 4) = *(src + 5);
-  *(dest + 5) = *(src + 6);
-  *(dest + 6) = *(src + 6);
-  *(dest + 7) = *(src + 7);
-  return NULL;
-}
-
-
-static inline uint32 find_max_intensity(Datum ** const dat,
-					   const int rows,
-					   const int cols)
+/* IHDR, and PLTE and tRNS when indexed */
+static void set_color_header(png_structp pngptr,
+			     png_infop infoptr,
+			     CanvasOpts * opts,
+			     ColorRow * cr)
 {
-  int i, j;
-  uint32 n;
-  uint32 max = 0;
-  for (i=0; i<rows; i++) {
-    for (j=0; j<cols; j++) {
-      n = dat[i][j].n;
-      if (n > max)
-	max = n;
+  png_color palette[PNG_MAX_PALETTE_LENGTH];
+  png_byte trans[PNG_MAX_PALETTE_LENGTH];
+  int k;
+
+  if (cr->index) {
+    for (k=0; k<cr->ncolors; k++) {
+      palette[k].red = cr->palette[k].rgba.r;
+      palette[k].green = cr->palette[k].rgba.g;
+      palette[k].blue = cr->palette[k].rgba.b;
+      trans[k] = cr->palette[k].rgba.alpha;
     }
+    png_set_IHDR(pngptr, infoptr, opts->nwidth, opts->nheight, 8,
+		 PNG_COLOR_TYPE_PALETTE, PNG_INTERLACE_NONE,
+		 PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_set_PLTE(pngptr, infoptr, palette, cr->ncolors);
+    if (cr->ntrans)
+      png_set_tRNS(pngptr, infoptr, trans, cr->ntrans, NULL);
+  } else {
+    png_set_IHDR(pngptr, infoptr, opts->nwidth, opts->nheight, opts->visuals.depth,
+		 PNG_COLOR_TYPE_RGB_ALPHA, PNG_INTERLACE_NONE,
+		 PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
   }
-
-  return max;
 }
 
 
-static inline uint32 prepare_color_reference(RefType type,
-					     RefValues * refholder)
+/* the text chunks, which stay allocated until the image is written */
+static png_text * set_text_fields(png_structp pngptr, png_infop infoptr)
 {
-  switch(type) {
-  case D65_2DEG:
-    std_illuminant_for_D65_2deg(refholder);
-    matrix_for_XYZ_sRGB_D65(refholder);
-    return 0;
-  case D65_10DEG:
-    std_illuminant_for_D65_10deg(refholder);
-    matrix_for_XYZ_sRGB_D65(refholder);
-    return 0;
-  case D50_2DEG:
-    std_illuminant_for_D50_2deg(refholder);
-    matrix_for_XYZ_wgRGB_D50(refholder);
-    return 0;
-  case D50_10DEG:
-    std_illuminant_for_D50_10deg(refholder);
-    matrix_for_XYZ_wgRGB_D50(refholder);
-    return 0;
-  default:
-    return 1;
+  const int textfields = 3;
+  png_text * textptr;
+
+  textptr = malloc(sizeof(png_text)*textfields);
+  if (textptr) {
+    textptr[0].compression = PNG_TEXT_COMPRESSION_NONE;
+    textptr[0].key = "Title";
+    textptr[0].text = "Frascr output image with pixelart palette";
+    textptr[0].text_length = strlen(textptr[0].text);
+    textptr[0].lang = NULL;
+    textptr[1].compression = PNG_TEXT_COMPRESSION_NONE;
+    textptr[1].key = "Author";
+    textptr[1].text = "eightbitastronomy";
+    textptr[1].text_length = strlen(textptr[1].text);
+    textptr[1].lang = NULL;
+    textptr[2].compression = PNG_TEXT_COMPRESSION_NONE;
+    textptr[2].key = "Description";
+    textptr[2].text = "Some shit";
+    textptr[2].text_length = strlen(textptr[2].text);
+    textptr[2].lang = NULL;
+    png_set_text(pngptr, infoptr, textptr, textfields);
   }
+
+  return textptr;
 }
 
 
 void FINISH(CanvasOpts * opts,
-	    Datum *** dataa,
+	    Canvas * dataa,
 	    int datal,
 	    FILE ** filea,
 	    int filel)
 {
-  int i, j, k, ret;
+  int i, ret;
 
   /* Data & control variables */
   int max, rno;
-  Datum ** canvas = dataa[0];
+  Canvas * canvas = &(dataa[0]);
   FILE * output = filea[0];
   
   /* libpng variables */ 
@@ -134,38 +125,19 @@ void FINISH(CanvasOpts * opts,
   png_infop infoptr = NULL;
   png_text * textptr = NULL;
   png_color_8 sig_bit;
-  const int textfields = 3;
-  char texttmp[511];
   png_byte ** rows;
+  PngPar pp;
 
   /* Color conversion */
-  Wheel * colors = NULL;
-  RefValues colorconvref;
-  BaseI basecolor;
-  BaseC8 converted;
-  void * swatchI;
-  BaseD swatchluv;
-  BaseD swatchxyz;
-  void * swatchrgb;
-
-  /* Color conversion helpers */
-  uint16 max_uint16 = MAX_SHORT; /* see below */
-  uint32 max_uint32 = MAX_INT;
+  ColorRow cr;
   uint32 intensitymax;
-  uint16 storeval;
-  double storevald;
-
-  /* Color-to-libpng helpers */
-  int datasize;
-  int (*convertptr)(void *, BaseD *, unsigned short, RefValues *) = NULL;
-  void *(*bytecopy)(void *, const void *, size_t);
   
   max = (datal <= filel ? datal : filel);
 
   for (rno=0; rno<max; rno++) {
 
     output = filea[rno];
-    canvas = dataa[rno];
+    canvas = &(dataa[rno]);
 
     pngptr = png_create_write_struct(PNG_LIBPNG_VER_STRING,
 				     errorptr,
@@ -186,17 +158,6 @@ void FINISH(CanvasOpts * opts,
 
     png_init_io(pngptr, output);
 
-    /* only support on/off for compression at the moment */
-    if (opts->visuals.compression == 0) {
-      png_set_compression_level(pngptr, Z_NO_COMPRESSION);
-    } else {
-      png_set_compression_level(pngptr, Z_BEST_COMPRESSION); // if compile err, try include zlib.h
-    }
-
-    png_set_IHDR(pngptr, infoptr, opts->nwidth, opts->nheight, opts->visuals.depth,
-		 PNG_COLOR_TYPE_RGB_ALPHA, PNG_INTERLACE_NONE,
-		 PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
-
     /*sig_bit.red = opts->visuals.depth;
     sig_bit.green = opts->visuals.depth;
     sig_bit.blue = opts->visuals.depth;
@@ -205,42 +166,12 @@ void FINISH(CanvasOpts * opts,
     
     /* set text fields -- this section isn't working the way I want it to */
 
-    textptr = malloc(sizeof(png_text)*textfields);
-    if (textptr) {
-      textptr[0].compression = PNG_TEXT_COMPRESSION_NONE;
-      textptr[0].key = "Title";
-      textptr[0].text = "Frascr output image with pixelart palette";
-      textptr[0].text_length = strlen(textptr[0].text);
-      textptr[0].lang = NULL;
-      textptr[1].compression = PNG_TEXT_COMPRESSION_NONE;
-      textptr[1].key = "Author";
-      textptr[1].text = "eightbitastronomy";
-      textptr[1].text_length = strlen(textptr[1].text);
-      textptr[1].lang = NULL;
-      textptr[2].compression = PNG_TEXT_COMPRESSION_NONE;
-      textptr[2].key = "Description";
-      textptr[2].text = "Some shit";
-      textptr[2].text_length = strlen(textptr[2].text);
-      textptr[2].lang = NULL;
-      png_set_text(pngptr, infoptr, textptr, textfields);
-      }
+    textptr = set_text_fields(pngptr, infoptr);
     
-    /* Create a LCH color wheel. */
+    /* Create a LCH color wheel and the reference values for color conversion. */
 
-    if (ret = initialize_wheel(&colors,
-			       opts->visuals.colors->swatch_n,
-			       opts->visuals.colors->space,
-			       opts->visuals.colors->mode,
-			       opts->visuals.colors->swatch)) {
+    if ((ret = color_row_init(&cr, opts, opts->visuals.depth)) != 0) {
       png_destroy_write_struct(&pngptr, &infoptr);
-      return;
-    }
-
-    /* Prepare the reference values for color conversion */
-
-    if (prepare_color_reference(opts->visuals.colors->reference, &colorconvref)) {
-      png_destroy_write_struct(&pngptr, &infoptr);
-      destroy_wheel(&colors);
       if (textptr)
 	free(textptr);
       return;
@@ -248,67 +179,41 @@ void FINISH(CanvasOpts * opts,
       
     /* find maximum intensity */
 
-    intensitymax = find_max_intensity(canvas, opts->nwidth, opts->nheight);
+    intensitymax = canvas_max_n(canvas);
+    color_row_table(&cr, intensitymax, (uint64)opts->nwidth*opts->nheight);
+    if (opts->visuals.indexed)
+      color_row_index(&cr);
+    set_color_header(pngptr, infoptr, opts, &cr);
     
     /* transpose input data for libpng while converting from black & white to color */
 
     rows = malloc(sizeof(png_byte *)*opts->nheight);
-    if (opts->visuals.depth == 8) {
-      convertptr = convert_xyz_to_sRGB8;
-      bytecopy = memcpy;
-      datasize = sizeof(BaseC8);\
-      swatchrgb = malloc(sizeof(datasize));
-    } else {
-      convertptr = convert_xyz_to_sRGB16;
-      datasize = sizeof(BaseC16);
-      swatchrgb = malloc(sizeof(datasize));
-      switch (O32_HOST_ORDER) {
-      case O32_LITTLE_ENDIAN:
-	bytecopy = byte_n_switch_16;
-	break;
-      case O32_BIG_ENDIAN:
-	bytecopy = memcpy;
-	break;
-      default:
-	return; //I'm not handling PDP or HONEYWELL at the moment
-      }
-    }
     for (i=0; i<opts->nheight; i++)
-      rows[i] = malloc(sizeof(png_byte)*opts->nwidth*datasize);
-
-    for (i=0; i<opts->nheight; i++) {
-      for (j=0; j<opts->nwidth; j++) {
-	storevald = intensitymax == 0 ? 0.0 : (double)(canvas[j][i].n) / (double)(intensitymax);
-	linear_by_intensity_norm(colors, storevald, &swatchI);
-	convert_lch_to_lab(&swatchluv, (BaseI *)swatchI);
-	convert_lab_to_xyz(&swatchxyz, &swatchluv, &colorconvref);
-	convertptr(swatchrgb, &swatchxyz, max_uint16, &colorconvref);
-	//Next line was the original, before BaseC8 & BaseC16 required swatchrgb to be void * ptr
-	//storage[opts->nheight-i-1][j] = swatchrgb.word;
-	bytecopy(&(rows[opts->nheight-i-1][datasize*j]), swatchrgb, datasize);
-	free((BaseI *)swatchI);
-      }
-    }
+      rows[i] = malloc(sizeof(png_byte)*opts->nwidth*cr.pixelsize);
+
+    for (i=0; i<opts->nheight; i++)
+      color_row_fill(rows[opts->nheight-i-1], canvas, i, &cr);
 
     png_write_info(pngptr, infoptr);
-    png_set_rows(pngptr, infoptr, rows);  
 
-    /* Write/Output */
-    
-    png_write_png(pngptr, infoptr, PNG_TRANSFORM_IDENTITY, NULL);
-    png_write_image(pngptr, rows);
-    png_write_end(pngptr, infoptr);
+    /* Write/Output: libpng has written the header, the image data is
+       filtered and deflated on several threads */
+
+    if (pngpar_begin(&pp, pngptr, opts->nwidth*cr.pixelsize, cr.pixelsize, &(opts->visuals), opts->threads) == 0) {
+      if (pngpar_rows(&pp, rows, opts->nheight) == 0)
+	pngpar_end(&pp);
+      else
+	pngpar_free(&pp);
+    }
 
     /* Cleanup */
     png_destroy_write_struct(&pngptr, &infoptr);
-    if (swatchrgb)
-      free(swatchrgb);
     if (rows) {
       for (i=0; i<opts->nheight; i++)
 	free(rows[i]);
       free(rows);
     }
-    destroy_wheel(&colors);
+    color_row_free(&cr);
     if (textptr)
       free(textptr);
 
@@ -319,7 +224,164 @@ void FINISH(CanvasOpts * opts,
 
 
 
-int VALIDATE(Datum *** dataa,
+/* One png per canvas being written band by band (see engine.h). Bands are
+   scaled by the escape limit, since the maximum is not known until the
+   end; this is the maximum whenever the view has interior points. */
+
+struct png_stream {
+  png_structp pngptr;
+  png_infop infoptr;
+  png_text * textptr;
+  PngPar pp;
+  png_byte * band;     /* rows of the band being written */
+  png_byte ** rows;
+  uint32 bandrows;     /* rows band has room for */
+  ColorRow cr;
+};
+typedef struct png_stream PngStream;
+
+static PngStream * streams = NULL;
+static int streaml = 0;
+
+
+static void end_streams(int write)
+{
+  int rno;
+  PngStream * ps;
+
+  for (rno=0; rno<streaml; rno++) {
+    ps = &(streams[rno]);
+    if (ps->pngptr) {
+      if (write && !setjmp(png_jmpbuf(ps->pngptr)))
+	pngpar_end(&(ps->pp));
+      png_destroy_write_struct(&(ps->pngptr), &(ps->infoptr));
+    }
+    pngpar_free(&(ps->pp));
+    free(ps->textptr);
+    free(ps->band);
+    free(ps->rows);
+    color_row_free(&(ps->cr));
+  }
+  free(streams);
+  streams = NULL;
+  streaml = 0;
+}
+
+
+static int begin_stream(CanvasOpts * opts, FILE * output, PngStream * ps)
+{
+  int ret;
+
+  ret = color_row_init(&(ps->cr), opts, opts->visuals.depth);
+  if (ret)
+    return ret;
+  color_row_table(&(ps->cr), opts->escape, (uint64)opts->nwidth*opts->nheight);
+  if (opts->visuals.indexed)
+    color_row_index(&(ps->cr));
+  ps->pngptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  if (!ps->pngptr)
+    return PW_PNG_WRITE;
+  ps->infoptr = png_create_info_struct(ps->pngptr);
+  if (!ps->infoptr)
+    return PW_PNG_WRITE;
+
+  if (setjmp(png_jmpbuf(ps->pngptr)))
+    return PW_PNG_WRITE;
+
+  png_init_io(ps->pngptr, output);
+  set_color_header(ps->pngptr, ps->infoptr, opts, &(ps->cr));
+  ps->textptr = set_text_fields(ps->pngptr, ps->infoptr);
+  png_write_info(ps->pngptr, ps->infoptr);
+  if (pngpar_begin(&(ps->pp), ps->pngptr, opts->nwidth*ps->cr.pixelsize, ps->cr.pixelsize,
+		   &(opts->visuals), opts->threads))
+    return PW_MALLOC;
+  return 0;
+}
+
+
+/* room in the stream for a band of n rows */
+static int band_rows(PngStream * ps, uint32 n, uint32 rowbytes)
+{
+  uint32 j;
+
+  if (n <= ps->bandrows)
+    return 0;
+  free(ps->band);
+  free(ps->rows);
+  ps->bandrows = 0;
+  ps->band = malloc(sizeof(png_byte)*rowbytes*n);
+  ps->rows = malloc(sizeof(png_byte *)*n);
+  if ((ps->band == NULL) || (ps->rows == NULL))
+    return PW_MALLOC;
+  for (j=0; j<n; j++)
+    ps->rows[j] = ps->band + (size_t)j*rowbytes;
+  ps->bandrows = n;
+  return 0;
+}
+
+
+int FINISH_BEGIN(CanvasOpts * opts,
+		 int datal,
+		 FILE ** filea,
+		 int filel)
+{
+  int rno, ret;
+
+  if ((opts==NULL) || (filea==NULL) || (datal < 1) || (filel < 1))
+    return PW_BAD_CALL;
+
+  streaml = (datal <= filel ? datal : filel);
+  streams = calloc(streaml, sizeof(PngStream));
+  if (streams == NULL) {
+    streaml = 0;
+    return PW_MALLOC;
+  }
+  for (rno=0; rno<streaml; rno++) {
+    ret = begin_stream(opts, filea[rno], &(streams[rno]));
+    if (ret) {
+      end_streams(0);
+      return ret;
+    }
+  }
+  return 0;
+}
+
+
+int FINISH_BAND(CanvasOpts * opts,
+		Canvas * banda,
+		int datal)
+{
+  int rno;
+  uint32 j;
+  PngStream * ps;
+
+  if ((banda==NULL) || (datal < streaml))
+    return PW_BAD_CALL;
+
+  for (rno=0; rno<streaml; rno++) {
+    ps = &(streams[rno]);
+    if (band_rows(ps, banda[rno].ny, opts->nwidth*ps->cr.pixelsize))
+      return PW_MALLOC;
+    /* the image runs top down, the canvas bottom up */
+    for (j=0; j<banda[rno].ny; j++)
+      color_row_fill(ps->rows[j], &(banda[rno]), banda[rno].ny-j-1, &(ps->cr));
+    if (setjmp(png_jmpbuf(ps->pngptr)))
+      return PW_PNG_WRITE;
+    if (pngpar_rows(&(ps->pp), ps->rows, banda[rno].ny))
+      return PW_PNG_WRITE;
+  }
+  return 0;
+}
+
+
+void FINISH_END(CanvasOpts * opts)
+{
+  end_streams(1);
+}
+
+
+
+int VALIDATE(Canvas * dataa,
 	    int datal,
 	    FILE ** filea,
 	    int filel)
@@ -332,15 +394,13 @@ int VALIDATE(Datum *** dataa,
     return PW_BAD_CALL;
   
   for (i=0; i<datal; i++) {
-    if (dataa[i] == NULL)
+    if ((dataa[i].data == NULL) && (dataa[i].counts == NULL))
       return PW_BAD_CALL;
   }
 
   for (i=0; i<filel; i++) {
     if (filea[i] == NULL)
       return PW_BAD_CALL;
-    if (ftell(filea[0]) < 0)
-      return PW_BAD_CALL;
   }
   
   return 0;
@@ -0,0 +1,409 @@
+/****************************************************************************/
+/* Libdzi.c: tile pyramid shared object for the FRASCR application.         */
+/*   Each level gathers the rows of its current row of tiles in a strip,    */
+/*   writes the tiles once the last row they reach is in, and keeps the     */
+/*   overlap rows for the next. Every second row it receives is averaged    */
+/*   with the one before into a row of the level below, which takes it      */
+/*   the same way, so the whole pyramid is made in one pass over the        */
+/*   image, top row first. The box filter takes four pixels at a time with  */
+/*   SSE2 where the compiler targets it (always, on x86-64), and gives the  */
+/*   same bytes as its scalar loop.                                         */
+/*   Last updated: 2024 June                                                */
+/****************************************************************************/
+/*  Author: Miguel Abele                                                    */
+/*  Copyrighted by Miguel Abele, 2024.                                      */
+/*                                                                          */
+/*  License information:                                                    */
+/*                                                                          */
+/*  This file is a part of the FRASCR application.                          */
+/*                                                                          */
+/*  FRASCR is free software; you can redistribute it and/or                 */
+/*  modify it under the terms of the GNU General Public License             */
+/*  as published by the Free Software Foundation; either version 3          */
+/*  of the License, or (at your option) any later version.                  */
+/*                                                                          */
+/*  FRASCR is distributed in the hope that it will be useful,               */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of          */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           */
+/*  GNU General Public License for more details.                            */
+/*                                                                          */
+/*  You should have received a copy of the GNU General Public License       */
+/*  along with this program; if not, write to the Free Software             */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor,                      */
+/*  Boston, MA  02110-1301, USA.                                            */
+/****************************************************************************/
+
+
+#include "libdzi.h"
+#include "color.h"
+#include "colorrow.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <png.h>
+#include <zlib.h>
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define DZ_SSE2
+#include <emmintrin.h>
+#endif
+
+
+/* one level of the pyramid */
+struct dzi_level {
+  uint32 w, h;
+  uint32 y;            /* rows received */
+  uint32 r;            /* row of tiles being gathered */
+  uint32 y0;           /* the row strip starts with */
+  uint8 * strip;       /* rows [y0, y), RGBA */
+  uint8 * pending;     /* an even row, waiting for the one below it */
+  uint8 * down;        /* the row made for the level below */
+};
+typedef struct dzi_level DziLevel;
+
+
+struct dzi_pyramid {
+  FILE * output;       /* for the descriptor */
+  const char * tiles;
+  uint32 tilesize, overlap;
+  int level;           /* zlib level of the tiles */
+  uint32 nx, ny;
+  uint32 levell;       /* levels 0 (1x1) to levell-1 (the image) */
+  DziLevel * levels;
+  ColorRow cr;
+  uint8 * row;         /* one canvas row, colored */
+  char * path;
+};
+typedef struct dzi_pyramid DziPyramid;
+
+static ColorStreams streams;
+
+
+
+/* one row of the level below from rows a and b of this one, w pixels
+   wide: each pixel the rounded mean of a 2x2 block. A lone last row is
+   passed as both a and b, and an odd last column is paired with itself. */
+static void box_filter(uint8 * dst, const uint8 * a, const uint8 * b, uint32 w)
+{
+  uint32 i = 0, i1, k;
+#ifdef DZ_SSE2
+  __m128i zero = _mm_setzero_si128();
+  __m128i two = _mm_set1_epi16(2);
+  __m128i a0, a1, b0, b1, s0, s1, s2, s3, p0, p1;
+
+  /* eight pixels of each row to four: channels widened to 16 bits, the
+     rows added, then each pixel added to its neighbour */
+  for (; i+8<=w; i+=8) {
+    a0 = _mm_loadu_si128((const __m128i *)(a + 4*i));
+    a1 = _mm_loadu_si128((const __m128i *)(a + 4*i + 16));
+    b0 = _mm_loadu_si128((const __m128i *)(b + 4*i));
+    b1 = _mm_loadu_si128((const __m128i *)(b + 4*i + 16));
+    s0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+    s1 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+    s2 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+    s3 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+    p0 = _mm_add_epi16(_mm_unpacklo_epi64(s0, s1), _mm_unpackhi_epi64(s0, s1));
+    p1 = _mm_add_epi16(_mm_unpacklo_epi64(s2, s3), _mm_unpackhi_epi64(s2, s3));
+    p0 = _mm_srli_epi16(_mm_add_epi16(p0, two), 2);
+    p1 = _mm_srli_epi16(_mm_add_epi16(p1, two), 2);
+    _mm_storeu_si128((__m128i *)(dst + 2*i), _mm_packus_epi16(p0, p1));
+  }
+#endif
+  for (; i<w; i+=2) {
+    i1 = (i+1 < w ? i+1 : i);
+    for (k=0; k<4; k++)
+      dst[2*i + k] = (a[4*i + k] + a[4*i1 + k] + b[4*i + k] + b[4*i1 + k] + 2) >> 2;
+  }
+}
+
+
+
+/* w by h RGBA pixels, rows stride bytes apart, as a png at path */
+static int write_tile(DziPyramid * dp, const uint8 * pixels, size_t stride, uint32 w, uint32 h)
+{
+  png_structp pngptr;
+  png_infop infoptr;
+  FILE * out;
+  uint32 j;
+
+  out = fopen(dp->path, "wb");
+  if (out == NULL)
+    return DZI_WRITE;
+  pngptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  infoptr = (pngptr ? png_create_info_struct(pngptr) : NULL);
+  if (infoptr == NULL) {
+    png_destroy_write_struct(&pngptr, (png_infopp)NULL);
+    fclose(out);
+    return PW_MALLOC;
+  }
+  if (setjmp(png_jmpbuf(pngptr))) {
+    png_destroy_write_struct(&pngptr, &infoptr);
+    fclose(out);
+    return DZI_WRITE;
+  }
+
+  png_init_io(pngptr, out);
+  png_set_compression_level(pngptr, dp->level);
+  png_set_IHDR(pngptr, infoptr, w, h, 8, PNG_COLOR_TYPE_RGB_ALPHA,
+	       PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+  png_write_info(pngptr, infoptr);
+  for (j=0; j<h; j++)
+    png_write_row(pngptr, (png_const_bytep)(pixels + j*stride));
+  png_write_end(pngptr, NULL);
+
+  png_destroy_write_struct(&pngptr, &infoptr);
+  return (fclose(out) == 0 ? 0 : DZI_WRITE);
+}
+
+
+
+/* the tiles of level l's current row, from its strip */
+static int tile_row(DziPyramid * dp, uint32 l)
+{
+  DziLevel * lv = &(dp->levels[l]);
+  size_t line = 4*(size_t)lv->w;
+  uint32 c, x0, x1;
+  int ret;
+
+  for (c=0; (uint64)c*dp->tilesize < lv->w; c++) {
+    x0 = (c*dp->tilesize > dp->overlap ? c*dp->tilesize - dp->overlap : 0);
+    x1 = (uint32)((uint64)(c+1)*dp->tilesize + dp->overlap < lv->w ?
+		  (c+1)*dp->tilesize + dp->overlap : lv->w);
+    sprintf(dp->path, "%s/%u/%u_%u.png", dp->tiles, l, c, lv->r);
+    ret = write_tile(dp, lv->strip + 4*(size_t)x0, line, x1 - x0, lv->y - lv->y0);
+    if (ret)
+      return ret;
+  }
+  return 0;
+}
+
+
+
+/* the next row of level l, top down; rows of the levels below follow */
+static int level_row(DziPyramid * dp, uint32 l, const uint8 * row)
+{
+  DziLevel * lv = &(dp->levels[l]);
+  size_t line = 4*(size_t)lv->w;
+  uint64 end;
+  uint32 y0;
+  int ret;
+
+  memcpy(lv->strip + (size_t)(lv->y - lv->y0)*line, row, line);
+  lv->y++;
+
+  end = (uint64)(lv->r + 1)*dp->tilesize + dp->overlap;
+  if ((lv->y == end) || (lv->y == lv->h)) {
+    ret = tile_row(dp, l);
+    if (ret)
+      return ret;
+    /* the next row of tiles starts overlap rows back; at the bottom of
+       the level it can be in already */
+    lv->r++;
+    if ((uint64)lv->r*dp->tilesize < lv->h) {
+      y0 = lv->r*dp->tilesize - dp->overlap;
+      memmove(lv->strip, lv->strip + (size_t)(y0 - lv->y0)*line, (size_t)(lv->y - y0)*line);
+      lv->y0 = y0;
+      if (lv->y == lv->h) {
+	ret = tile_row(dp, l);
+	if (ret)
+	  return ret;
+	lv->r++;
+      }
+    }
+  }
+  if (l == 0)
+    return 0;
+
+  if ((lv->y & 1) == 0)
+    box_filter(lv->down, lv->pending, row, lv->w);
+  else if (lv->y == lv->h)
+    box_filter(lv->down, row, row, lv->w);
+  else {
+    memcpy(lv->pending, row, line);
+    return 0;
+  }
+  return level_row(dp, l-1, lv->down);
+}
+
+
+
+static void dzi_free(void * state)
+{
+  DziPyramid * dp = state;
+  uint32 l;
+
+  if (dp->levels) {
+    for (l=0; l<dp->levell; l++) {
+      free(dp->levels[l].strip);
+      free(dp->levels[l].pending);
+      free(dp->levels[l].down);
+    }
+    free(dp->levels);
+    dp->levels = NULL;
+  }
+  free(dp->row);
+  free(dp->path);
+  dp->row = NULL;
+  dp->path = NULL;
+  color_row_free(&(dp->cr));
+}
+
+
+/* Prepare the DziPyramid state for the canvas of opts, making the
+   directories of the tiles. Colors run from 0 to intensitymax. */
+static int dzi_begin(void * state, CanvasOpts * opts, FILE * output, uint32 intensitymax)
+{
+  DziPyramid * dp = state;
+  DziLevel * lv;
+  uint32 l, s, rows;
+  int ret;
+
+  memset(dp, 0, sizeof(DziPyramid));
+  dp->output = output;
+  dp->tiles = opts->visuals.tiles;
+  dp->tilesize = opts->visuals.tilesize;
+  dp->overlap = opts->visuals.overlap;
+  dp->nx = opts->nwidth;
+  dp->ny = opts->nheight;
+  if ((dp->tiles == NULL) || (dp->tilesize == 0) || (dp->overlap >= dp->tilesize))
+    return DZI_NO_TILES;
+  if (!opts->visuals.compression)
+    dp->level = 0;
+  else
+    dp->level = (opts->visuals.level < 0 ? Z_DEFAULT_COMPRESSION : opts->visuals.level);
+
+  ret = color_row_init(&(dp->cr), opts, 8);
+  if (ret)
+    return ret;
+  color_row_table(&(dp->cr), intensitymax, (uint64)dp->nx*dp->ny);
+
+  /* level l is the image halved levell-1-l times, rounding up */
+  for (dp->levell=1; ((uint64)1 << (dp->levell-1)) < (dp->nx > dp->ny ? dp->nx : dp->ny); dp->levell++)
+    ;
+  dp->levels = calloc(dp->levell, sizeof(DziLevel));
+  dp->row = malloc(4*(size_t)dp->nx);
+  dp->path = malloc(strlen(dp->tiles) + 40);
+  if ((dp->levels == NULL) || (dp->row == NULL) || (dp->path == NULL))
+    return PW_MALLOC;
+
+  mkdir(dp->tiles, 0755);
+  for (l=0; l<dp->levell; l++) {
+    lv = &(dp->levels[l]);
+    s = dp->levell - 1 - l;
+    lv->w = (uint32)(((uint64)dp->nx + ((uint64)1 << s) - 1) >> s);
+    lv->h = (uint32)(((uint64)dp->ny + ((uint64)1 << s) - 1) >> s);
+    rows = dp->tilesize + 2*dp->overlap;
+    if (rows > lv->h)
+      rows = lv->h;
+    lv->strip = malloc(4*(size_t)lv->w*rows);
+    lv->pending = malloc(4*(size_t)lv->w);
+    lv->down = malloc(4*(size_t)((lv->w + 1)/2));
+    if ((lv->strip == NULL) || (lv->pending == NULL) || (lv->down == NULL))
+      return PW_MALLOC;
+    sprintf(dp->path, "%s/%u", dp->tiles, l);
+    mkdir(dp->path, 0755);
+  }
+  return 0;
+}
+
+
+/* rows [0, canvas->ny) of canvas, top down */
+static int dzi_canvas(void * state, const Canvas * canvas)
+{
+  DziPyramid * dp = state;
+  uint32 j;
+  int ret;
+
+  for (j=canvas->ny; j>0; j--) {
+    color_row_fill(dp->row, canvas, j-1, &(dp->cr));
+    ret = level_row(dp, dp->levell-1, dp->row);
+    if (ret)
+      return ret;
+  }
+  return 0;
+}
+
+
+/* the descriptor, once every tile is written */
+static int dzi_end(void * state, CanvasOpts * opts)
+{
+  DziPyramid * dp = state;
+
+  if (fprintf(dp->output,
+	      "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+	      "<Image xmlns=\"http://schemas.microsoft.com/deepzoom/2008\"\n"
+	      "       Format=\"png\" Overlap=\"%u\" TileSize=\"%u\">\n"
+	      "  <Size Width=\"%u\" Height=\"%u\"/>\n"
+	      "</Image>\n",
+	      dp->overlap, dp->tilesize, dp->nx, dp->ny) < 0)
+    return DZI_WRITE;
+  return 0;
+}
+
+
+static void dzi_report(void * state, CanvasOpts * opts, int rno, int ret)
+{
+  DziPyramid * dp = state;
+
+  if (opts->debug) {
+    if (ret == DZI_NO_TILES) {
+      DEBUG(opts->debug, D0, "libdzi: visualization option \"pyramid\" needs a \"tiles\" directory, and an overlap less than the tile size\n");
+    } else {
+      DEBUG(opts->debug, D0, "libdzi: could not write the pyramid in %s: %d\n",
+	    (dp->tiles ? dp->tiles : "(none)"), ret);
+    }
+  }
+}
+
+
+
+/* one pyramid, of the first canvas */
+static const ColorFinisher dzi_finisher = {
+  sizeof(DziPyramid), 1, 0, dzi_begin, dzi_canvas, dzi_end, dzi_free, dzi_report
+};
+
+
+
+void FINISH(CanvasOpts * opts,
+	    Canvas * dataa,
+	    int datal,
+	    FILE ** filea,
+	    int filel)
+{
+  color_finish(&dzi_finisher, opts, dataa, datal, filea, filel);
+}
+
+
+
+int FINISH_BEGIN(CanvasOpts * opts,
+		 int datal,
+		 FILE ** filea,
+		 int filel)
+{
+  return color_stream_begin(&streams, &dzi_finisher, opts, datal, filea, filel);
+}
+
+
+int FINISH_BAND(CanvasOpts * opts,
+		Canvas * banda,
+		int datal)
+{
+  return color_stream_band(&streams, banda, datal);
+}
+
+
+void FINISH_END(CanvasOpts * opts)
+{
+  color_stream_end(&streams, opts);
+}
+
+
+
+int VALIDATE(Canvas * dataa,
+	    int datal,
+	    FILE ** filea,
+	    int filel)
+{
+  return color_validate(dataa, datal, filea, filel);
+}
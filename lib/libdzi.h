@@ -0,0 +1,84 @@
+/****************************************************************************/
+/* Libdzi.h: tile pyramid shared object for the FRASCR application.         */
+/*   Provides a FINISH function and VALIDATE function, and FINISH_BEGIN,    */
+/*   FINISH_BAND and FINISH_END for streamed canvases (see engine.h).       */
+/*   FINISH cuts the first canvas into a Deep Zoom (DZI) pyramid of png     */
+/*   tiles, colored as libcolorpng colors its pngs (colorrow.h), 8 bits per */
+/*   channel: the output file gets the .dzi descriptor and the tiles go in  */
+/*   the directory of visualization option "pyramid" ("tiles"), as          */
+/*   <tiles>/<level>/<column>_<row>.png, "tilesize" pixels square (254 by   */
+/*   default) plus an "overlap" (1) on each side that has a neighbour. The  */
+/*   full image is the highest level; each level below is the one above it  */
+/*   halved by a 2x2 box filter, down to a single pixel at level 0.         */
+/*   Rows go through every level as they come, so only one row of tiles     */
+/*   of each level is ever held: with canvas option "stream" the canvas     */
+/*   itself is never whole in memory either, and a render far larger        */
+/*   than memory can be published as a pyramid.                             */
+/*   Last updated: 2024 June                                                */
+/****************************************************************************/
+/*  Author: Miguel Abele                                                    */
+/*  Copyrighted by Miguel Abele, 2024.                                      */
+/*                                                                          */
+/*  License information:                                                    */
+/*                                                                          */
+/*  This file is a part of the FRASCR application.                          */
+/*                                                                          */
+/*  FRASCR is free software; you can redistribute it and/or                 */
+/*  modify it under the terms of the GNU General Public License             */
+/*  as published by the Free Software Foundation; either version 3          */
+/*  of the License, or (at your option) any later version.                  */
+/*                                                                          */
+/*  FRASCR is distributed in the hope that it will be useful,               */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of          */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           */
+/*  GNU General Public License for more details.                            */
+/*                                                                          */
+/*  You should have received a copy of the GNU General Public License       */
+/*  along with this program; if not, write to the Free Software             */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor,                      */
+/*  Boston, MA  02110-1301, USA.                                            */
+/****************************************************************************/
+
+
+#ifndef LIBDZI_H
+#define LIBDZI_H
+
+
+#include "options.h"
+#include "utils.h"
+#include <stdio.h>
+
+
+#define DZI_WRITE      -83
+#define DZI_NO_TILES   -84
+
+
+void FINISH(CanvasOpts * opts,
+	    Canvas * dataa,
+	    int datal,
+	    FILE ** filea,
+	    int filel);
+
+
+int FINISH_BEGIN(CanvasOpts * opts,
+		 int datal,
+		 FILE ** filea,
+		 int filel);
+
+
+int FINISH_BAND(CanvasOpts * opts,
+		Canvas * banda,
+		int datal);
+
+
+void FINISH_END(CanvasOpts * opts);
+
+
+int VALIDATE(Canvas * dataa,
+	    int datal,
+	    FILE ** filea,
+	    int filel);
+
+
+
+#endif /* LIBDZI_H */
@@ -0,0 +1,217 @@
+/****************************************************************************/
+/* Libfrd.c: printing shared object for the FRASCR application.             */
+/*   Provides a FINISH function and VALIDATE function, and the streaming    */
+/*   FINISH_BEGIN, FINISH_BAND and FINISH_END (see libfrd.h).               */
+/*   Counts go out a row at a time through a padded line buffer, whatever   */
+/*   the order and format of the canvas. A whole canvas is dumped in the    */
+/*   smallest format holding its largest count; a streamed one in the       */
+/*   format holding the escape limit, since its largest count is not known  */
+/*   in time, and each band is written in its place in the file.            */
+/*   Last updated: 2024 June                                                */
+/****************************************************************************/
+/*  Author: Miguel Abele                                                    */
+/*  Copyrighted by Miguel Abele, 2024.                                      */
+/*                                                                          */
+/*  License information:                                                    */
+/*                                                                          */
+/*  This file is a part of the FRASCR application.                          */
+/*                                                                          */
+/*  FRASCR is free software; you can redistribute it and/or                 */
+/*  modify it under the terms of the GNU General Public License             */
+/*  as published by the Free Software Foundation; either version 3          */
+/*  of the License, or (at your option) any later version.                  */
+/*                                                                          */
+/*  FRASCR is distributed in the hope that it will be useful,               */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of          */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           */
+/*  GNU General Public License for more details.                            */
+/*                                                                          */
+/*  You should have received a copy of the GNU General Public License       */
+/*  along with this program; if not, write to the Free Software             */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor,                      */
+/*  Boston, MA  02110-1301, USA.                                            */
+/****************************************************************************/
+
+
+#include "libfrd.h"
+#include "frd.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* the streamed dump */
+static FILE * streamfile = NULL;
+static FrdHeader streamhead;
+static void * streamline = NULL;
+
+
+/* the header, from the canvas options, padded out to fh->header bytes */
+static int write_header(FrdHeader * fh, CanvasOpts * opts, FILE * output)
+{
+  char block[FRD_HEADER];
+
+  fh->escape = opts->escape;
+  fh->left = opts->left;
+  fh->bottom = opts->bottom;
+  fh->width = opts->width;
+  fh->height = opts->height;
+  fh->coord_Re = opts->coord_Re;
+  fh->coord_Im = opts->coord_Im;
+  if (opts->algorithm)
+    strncpy(fh->algorithm, opts->algorithm, FRD_NAME-1);
+
+  memset(block, 0, FRD_HEADER);
+  memcpy(block, fh, sizeof(FrdHeader));
+  if (fwrite(block, 1, FRD_HEADER, output) != FRD_HEADER)
+    return FRD_WRITE;
+  return 0;
+}
+
+
+/* rows [0, canvas->ny) of canvas, as rows [0, canvas->ny) of the dump's
+   canvas wherever output stands; line has room for a padded row */
+static int write_rows(const FrdHeader * fh,
+		      const Canvas * canvas,
+		      void * line,
+		      FILE * output)
+{
+  uint32 i, j, n;
+  size_t rowbytes = fh->canvasbytes / fh->ny;
+
+  memset(line, 0, rowbytes);
+  for (j=0; j<canvas->ny; j++) {
+    if (fh->format == CANVAS_N16) {
+      for (i=0; i<canvas->nx; i++) {
+	n = canvas_n(canvas, i, j);
+	((uint16 *)line)[i] = (n > CANVAS_N16_MAX ? CANVAS_N16_MAX : n);
+      }
+    } else {
+      for (i=0; i<canvas->nx; i++)
+	((uint32 *)line)[i] = canvas_n(canvas, i, j);
+    }
+    if (fwrite(line, 1, rowbytes, output) != rowbytes)
+      return FRD_WRITE;
+  }
+  return 0;
+}
+
+
+void FINISH(CanvasOpts * opts,
+	    Canvas * dataa,
+	    int datal,
+	    FILE ** filea,
+	    int filel)
+{
+  FrdHeader fh;
+  void * line;
+  uint32 max, n;
+  int rno;
+
+  max = 0;
+  for (rno=0; rno<datal; rno++) {
+    n = canvas_max_n(&(dataa[rno]));
+    if (n > max)
+      max = n;
+  }
+  frd_layout(&fh, datal, opts->nwidth, opts->nheight, canvas_compact_format(max));
+
+  line = malloc(fh.canvasbytes / fh.ny);
+  if (line == NULL)
+    return;
+  if (write_header(&fh, opts, filea[0]) == 0) {
+    for (rno=0; rno<datal; rno++)
+      if (write_rows(&fh, &(dataa[rno]), line, filea[0]))
+	break;
+  }
+  free(line);
+
+  return;
+}
+
+
+
+int FINISH_BEGIN(CanvasOpts * opts,
+		 int datal,
+		 FILE ** filea,
+		 int filel)
+{
+  int ret;
+
+  if ((opts==NULL) || (filea==NULL) || (datal < 1) || (filel < 1))
+    return FRD_BAD_CALL;
+
+  frd_layout(&streamhead, datal, opts->nwidth, opts->nheight,
+	     canvas_compact_format(opts->escape));
+  streamline = malloc(streamhead.canvasbytes / streamhead.ny);
+  if (streamline == NULL)
+    return FRD_MALLOC;
+  ret = write_header(&streamhead, opts, filea[0]);
+  if (ret) {
+    free(streamline);
+    streamline = NULL;
+    return ret;
+  }
+  streamfile = filea[0];
+  return 0;
+}
+
+
+int FINISH_BAND(CanvasOpts * opts,
+		Canvas * banda,
+		int datal)
+{
+  uint32 rno;
+  uint64 at;
+  int ret;
+
+  if ((banda==NULL) || (streamfile==NULL) || (datal < streamhead.canvl))
+    return FRD_BAD_CALL;
+
+  for (rno=0; rno<streamhead.canvl; rno++) {
+    at = streamhead.header + streamhead.canvasbytes * rno
+      + streamhead.canvasbytes / streamhead.ny * banda[rno].j0;
+    if (fseeko(streamfile, (off_t)at, SEEK_SET))
+      return FRD_WRITE;
+    if ((ret = write_rows(&streamhead, &(banda[rno]), streamline, streamfile)) != 0)
+      return ret;
+  }
+  return 0;
+}
+
+
+void FINISH_END(CanvasOpts * opts)
+{
+  if (streamfile)
+    fflush(streamfile);
+  free(streamline);
+  streamline = NULL;
+  streamfile = NULL;
+}
+
+
+
+int VALIDATE(Canvas * dataa,
+	    int datal,
+	    FILE ** filea,
+	    int filel)
+{
+  int i;
+  if ((dataa==NULL) || (filea==NULL))
+    return FRD_BAD_CALL;
+
+  if ((datal < 1) || (filel < 1))
+    return FRD_BAD_CALL;
+
+  for (i=0; i<datal; i++) {
+    if ((dataa[i].data == NULL) && (dataa[i].counts == NULL))
+      return FRD_BAD_CALL;
+  }
+
+  /* the bands of a stream are written in place, so unlike the other
+     finishers this one cannot write to a pipe ("-") */
+  if ((filea[0] == NULL) || (ftell(filea[0]) < 0))
+    return FRD_BAD_CALL;
+
+  return 0;
+}
@@ -8,7 +8,10 @@
 /*   iteration types are carried out in separate functions: Mandelbrot or   */
 /*   Julia set computation for each of the functions. UNDER CONSTRUCTION.   */
 /*   For a finishing library, this outputs only a single double array of    */
-/*   unsigned ints.                                                         */
+/*   unsigned ints. TILE_SETUP and EXECUTE_TILE let the core drive the      */
+/*   computation itself (see engine.h). Orbits are checked for cycles per   */
+/*   the canvas option "periodicity" (periodicity.h); with 2, the periods   */
+/*   are output as a second canvas.                                         */
 /*   Last updated: 2024 May                                                 */
 /****************************************************************************/
 /*  Author: Miguel Abele                                                    */
@@ -36,12 +39,12 @@
 
 
 #include "libgeneralmjexponential.h"
+#include "periodicity.h"
 #include <stdlib.h>
 #include <math.h>
 
 
-#define FREE_DBL_ARRAY(arr,l,m) { if ((arr)) { for (l=0; l<m; l++) { free((arr)[l]); } free((arr)); (arr)=NULL; } }
-#define CLOSE_FILE_ARRAY(arr,l,m) { if ((arr)) { for (l=0; l<m; l++) { if ((arr)[l]) fclose((arr)[l]); free((arr)); (arr)=NULL; } } }
+#define CLOSE_FILE_ARRAY(arr,l,m) { if ((arr)) { for (l=0; l<m; l++) { if ((arr)[l]) output_close((arr)[l]); } free((arr)); (arr)=NULL; } }
 #define ABS(x) (x < 0 ? -1.*x : x)
 #define NEARZERO(x,w) (ABS(x) < w ? 1 : 0)
 #define MIN(x,y) (x < y ? x : y)
@@ -54,29 +57,69 @@ struct secondary_option {
 typedef struct secondary_option SecondaryOpts;
 
 
+/* Each iteration type computes the pixels [i0,i0+w) x [j0,j0+h): pixel
+   (i,j) is stored at canv[(i-i0)*stride + (j-j0)], and its period, if
+   percanv is given, at the same place in percanv */
+
 void type1_julia(CanvasOpts * canvopts,
 		 SecondaryOpts * secopts,
-		 Datum *** canv);
+		 uint32 i0,
+		 uint32 j0,
+		 uint32 w,
+		 uint32 h,
+		 Datum * canv,
+		 Datum * percanv,
+		 uint32 stride);
 
 void type2_julia(CanvasOpts * canvopts,
 		 SecondaryOpts * secopts,
-		 Datum *** canv);
+		 uint32 i0,
+		 uint32 j0,
+		 uint32 w,
+		 uint32 h,
+		 Datum * canv,
+		 Datum * percanv,
+		 uint32 stride);
 
 void type3_julia(CanvasOpts * canvopts,
 		 SecondaryOpts * secopts,
-		 Datum *** canv);
+		 uint32 i0,
+		 uint32 j0,
+		 uint32 w,
+		 uint32 h,
+		 Datum * canv,
+		 Datum * percanv,
+		 uint32 stride);
 
 void type1_mandel(CanvasOpts * canvopts,
 		  SecondaryOpts * secopts,
-		  Datum *** canv);
+		  uint32 i0,
+		  uint32 j0,
+		  uint32 w,
+		  uint32 h,
+		  Datum * canv,
+		  Datum * percanv,
+		  uint32 stride);
 
 void type2_mandel(CanvasOpts * canvopts,
 		  SecondaryOpts * secopts,
-		  Datum *** canv);
+		  uint32 i0,
+		  uint32 j0,
+		  uint32 w,
+		  uint32 h,
+		  Datum * canv,
+		  Datum * percanv,
+		  uint32 stride);
 
 void type3_mandel(CanvasOpts * canvopts,
 		  SecondaryOpts * secopts,
-		  Datum *** canv);
+		  uint32 i0,
+		  uint32 j0,
+		  uint32 w,
+		  uint32 h,
+		  Datum * canv,
+		  Datum * percanv,
+		  uint32 stride);
 
 
 static inline void * process_type(int x) {
@@ -121,6 +164,10 @@ static inline int process_sec_opts(char ** const src, const uint32 l, SecondaryO
 }
 
 
+/* options parsed by TILE_SETUP for use by every EXECUTE_TILE call */
+static SecondaryOpts tilesecopts;
+
+
 
 int EXECUTE(CanvasOpts * canvopts,
 	    void (*finfunc)(),
@@ -129,12 +176,11 @@ int EXECUTE(CanvasOpts * canvopts,
 	    uint32 outfl)
 {
   /* The data holders used in execute */
-  Datum ** canv;
   /* Validator will check dataa and datal, outfa and outfl.
      dataa must be one spot for each data holder used above, datal the total num.
      outfa is the array of file pointers, and outfl the total num. */
-  Datum *** canva = NULL;
-  const uint32 canvl = 1;
+  Canvas * canva = NULL;
+  uint32 canvl;
   FILE ** outfa = NULL;
   int i, j;
   SecondaryOpts secopts;
@@ -149,61 +195,44 @@ int EXECUTE(CanvasOpts * canvopts,
   ret = process_sec_opts(canvopts->secondary, canvopts->secondaryl, &secopts);
   if (ret)
     return ret;
+  canvl = (canvopts->periodicity == PERIOD_CANVAS ? 2 : 1);
 
   /* setup memory and organize for validator */
 
-  canv = malloc(sizeof(Datum *)*canvopts->nwidth);
-  if (canv == NULL)
-    return LIBMALLOC;
-  for (i=0; i<canvopts->nwidth; i++) {
-    canv[i] = malloc(sizeof(Datum)*canvopts->nheight);
-    if (canv[i-1] == NULL) {
-      FREE_DBL_ARRAY(canv,j,i-2);
-      return LIBMALLOC;
-    }
-  }
-
-  canva = malloc(sizeof(Datum **)*canvl);
-  if (canva == NULL) {
-    FREE_DBL_ARRAY(canv,j,canvopts->nwidth);
+  canva = canvas_alloc_set(canvl, canvopts->nwidth, canvopts->nheight, CANVAS_COLUMNS, CANVAS_FULL);
+  if (canva == NULL)
     return LIBMALLOC;
-  }
-  canva[0] = canv;
 
   outfa = malloc(sizeof(FILE *)*outfl);
   if (outfa == NULL) {
-    FREE_DBL_ARRAY(canv,j,canvopts->nwidth);
-    free(canva);
+    canvas_free_set(canva, canvl);
     return LIBMALLOC;
   }
   for (i=0; i<outfl; i++) {
-    outfa[i] = fopen(outfn[i], "wb");
+    outfa[i] = output_open(outfn[i]);
     if (!outfa[i-1]) {
       CLOSE_FILE_ARRAY(outfa,j,i-2);
-      FREE_DBL_ARRAY(canv,j,canvopts->nwidth);
-      free(canva);
+      canvas_free_set(canva, canvl);
       return LIBFILE;
     }
   }
 
   if (validfunc(canva, canvl, outfa, outfl) != 0) {
-    FREE_DBL_ARRAY(canv,j,canvopts->nwidth);
-    free(canva);
+    canvas_free_set(canva, canvl);
     CLOSE_FILE_ARRAY(outfa,j,outfl);
     return LIBVALIDATE;
   }
 
   /* Execute iteration type */
 
-  secopts.iterfunc(canvopts, &secopts, &canv);
+  secopts.iterfunc(canvopts, &secopts, 0, 0, canvopts->nwidth, canvopts->nheight,
+		   canva[0].data, (canvl == 2 ? canva[1].data : NULL), canva[0].stride);
 
   /* output results */
 
   finfunc(canvopts, canva, canvl, outfa, outfl);
 
-  FREE_DBL_ARRAY(canv,i,canvopts->nwidth);
-  if (canva)
-    free(canva);
+  canvas_free_set(canva, canvl);
   CLOSE_FILE_ARRAY(outfa,i,outfl);
   
   return 0;
@@ -212,17 +241,60 @@ int EXECUTE(CanvasOpts * canvopts,
 
 
 
+int TILE_SETUP(CanvasOpts * canvopts)
+{
+  int ret;
+
+  if ( (canvopts==NULL) || (canvopts->secondary == NULL) )
+    return LIBBADCALL;
+
+  ret = process_sec_opts(canvopts->secondary, canvopts->secondaryl, &tilesecopts);
+  if (ret)
+    return ret;
+
+  return (canvopts->periodicity == PERIOD_CANVAS ? 2 : 1);
+}
+
+
+
+int EXECUTE_TILE(CanvasOpts * canvopts,
+		 uint32 x0,
+		 uint32 y0,
+		 uint32 w,
+		 uint32 h,
+		 Datum * tile)
+{
+  if ( (canvopts==NULL) || (tile==NULL) || (tilesecopts.iterfunc==NULL) )
+    return LIBBADCALL;
+
+  tilesecopts.iterfunc(canvopts, &tilesecopts, x0, y0, w, h, tile,
+		       (canvopts->periodicity == PERIOD_CANVAS ? &(tile[w*h]) : NULL), h);
+
+  return 0;
+}
+
+
+
 void type1_julia(CanvasOpts * canvopts,
 		 SecondaryOpts * secopts,
-		 Datum *** canv){
+		 uint32 i0,
+		 uint32 j0,
+		 uint32 w,
+		 uint32 h,
+		 Datum * canv,
+		 Datum * percanv,
+		 uint32 stride){
   float64 x, y, expbuf, modbuf, prodbuf, inner, x0, y0, left, bottom, width, height;
   float64 logrhoz;
   float64 thetaz, rhoz, thetal, rhol;
-  uint32 n, max;
+  uint32 n, max, p;
+  PeriodCheck pc;
+  float64 tolsq;
   float64 w_re, w_im;
   float64 lam_re, lam_im;
   float64 smallerinterval;
   uint32 nx, ny;
+  uint32 k;
   int i, j;
 
   left = canvopts->left;
@@ -233,6 +305,7 @@ void type1_julia(CanvasOpts * canvopts,
   height = canvopts->height;
   max = canvopts->escape;
   smallerinterval = MIN((width/(double)nx),(height/(double)ny));
+  tolsq = period_tolerance(canvopts->periodicity, smallerinterval);
   w_re = secopts->wre;
   w_im = secopts->wim;
   lam_re = secopts->lre;
@@ -243,8 +316,8 @@ void type1_julia(CanvasOpts * canvopts,
   
   /* core functionality, execute */
 
-  for (i=0; i<nx; i++) {
-    for (j=0; j<ny; j++) {
+  for (i=i0; i<i0+w; i++) {
+    for (j=j0; j<j0+h; j++) {
 
       //julia set: iterate x0, y0, not lambda
       x0 = left + ((float64)i) * width / ((float64)nx);
@@ -254,12 +327,14 @@ void type1_julia(CanvasOpts * canvopts,
       rhoz = sqrt(x0*x0 + y0*y0);
       thetaz = atan2(y0,x0);
       n = 0;
+      p = 0;
       if ( x0 > 50. ) {
 
-	continue;
+	/* escaped at once: n and p stay 0, and the point is still written */
 
       } else {
 
+	period_start(&pc, x0, y0, tolsq);
 	while ( n < max ) {
 
 	  if (NEARZERO(rhoz,smallerinterval) == 1) {
@@ -282,14 +357,25 @@ void type1_julia(CanvasOpts * canvopts,
 	    else 
 	      break;
 	  }
-	  
+
+	  if ( (tolsq > 0.) && (p = period_step(&pc, x, y)) ) {
+	    n = max;
+	    break;
+	  }
+
 	} /* while n < max */
 
       } /* if x < 50 */
       
-      (*canv)[i][j].re = x0;
-      (*canv)[i][j].im = y0;
-      (*canv)[i][j].n = n;
+      k = (i-i0)*stride + (j-j0);
+      canv[k].re = x0;
+      canv[k].im = y0;
+      canv[k].n = n;
+      if (percanv) {
+	percanv[k].re = x0;
+	percanv[k].im = y0;
+	percanv[k].n = p;
+      }
 
     } /* for j */
   } /* for i */
@@ -301,15 +387,24 @@ void type1_julia(CanvasOpts * canvopts,
 
 void type2_julia(CanvasOpts * canvopts,
 		 SecondaryOpts * secopts,
-		 Datum *** canv){
+		 uint32 i0,
+		 uint32 j0,
+		 uint32 w,
+		 uint32 h,
+		 Datum * canv,
+		 Datum * percanv,
+		 uint32 stride){
   float64 x, y, expbuf, modbuf, prodbuf, inner, x0, y0, left, bottom, width, height;
   float64 logrhoz;
   float64 thetaz, rhoz, thetal, rhol;
-  uint32 n, max;
+  uint32 n, max, p;
+  PeriodCheck pc;
+  float64 tolsq;
   float64 w_re, w_im;
   float64 lam_re, lam_im;
   float64 smallerinterval;
   uint32 nx, ny;
+  uint32 k;
   int i, j;
 
   left = canvopts->left;
@@ -320,6 +415,7 @@ void type2_julia(CanvasOpts * canvopts,
   height = canvopts->height;
   max = canvopts->escape;
   smallerinterval = MIN((width/(double)nx),(height/(double)ny));
+  tolsq = period_tolerance(canvopts->periodicity, smallerinterval);
   w_re = secopts->wre;
   w_im = secopts->wim;
   lam_re = secopts->lre;
@@ -328,8 +424,8 @@ void type2_julia(CanvasOpts * canvopts,
   
   /* core functionality, execute */
 
-  for (i=0; i<nx; i++) {
-    for (j=0; j<ny; j++) {
+  for (i=i0; i<i0+w; i++) {
+    for (j=j0; j<j0+h; j++) {
 
       //julia set: iterate x0, y0, not lambda
       x0 = left + ((float64)i) * width / ((float64)nx);
@@ -339,12 +435,14 @@ void type2_julia(CanvasOpts * canvopts,
       rhoz = sqrt(x0*x0 + y0*y0);
       thetaz = atan2(y0,x0);
       n = 0;
+      p = 0;
       if ( x0 > 50. ) {
 
-	continue;
+	/* escaped at once: n and p stay 0, and the point is still written */
 
       } else {
 
+	period_start(&pc, x0, y0, tolsq);
 	while ( n < max ) {
 
 	  if (NEARZERO(rhoz,smallerinterval) == 1) {
@@ -368,14 +466,25 @@ void type2_julia(CanvasOpts * canvopts,
 	    else 
 	      break;
 	  }
-	  
+
+	  if ( (tolsq > 0.) && (p = period_step(&pc, x, y)) ) {
+	    n = max;
+	    break;
+	  }
+
 	} /* while n < max */
 
       } /* if x < 50 */
       
-      (*canv)[i][j].re = x0;
-      (*canv)[i][j].im = y0;
-      (*canv)[i][j].n = n;
+      k = (i-i0)*stride + (j-j0);
+      canv[k].re = x0;
+      canv[k].im = y0;
+      canv[k].n = n;
+      if (percanv) {
+	percanv[k].re = x0;
+	percanv[k].im = y0;
+	percanv[k].n = p;
+      }
 
     } /* for j */
   } /* for i */
@@ -387,15 +496,24 @@ void type2_julia(CanvasOpts * canvopts,
 
 void type3_julia(CanvasOpts * canvopts,
 		 SecondaryOpts * secopts,
-		 Datum *** canv){
+		 uint32 i0,
+		 uint32 j0,
+		 uint32 w,
+		 uint32 h,
+		 Datum * canv,
+		 Datum * percanv,
+		 uint32 stride){
   float64 x, y, expbuf, modbuf, prodbuf, inner, x0, y0, left, bottom, width, height;
   float64 logrhoz;
   float64 thetaz, rhoz, thetal, rhol;
-  uint32 n, max;
+  uint32 n, max, p;
+  PeriodCheck pc;
+  float64 tolsq;
   float64 w_re, w_im;
   float64 lam_re, lam_im;
   float64 smallerinterval;
   uint32 nx, ny;
+  uint32 k;
   int i, j;
 
   left = canvopts->left;
@@ -406,6 +524,7 @@ void type3_julia(CanvasOpts * canvopts,
   height = canvopts->height;
   max = canvopts->escape;
   smallerinterval = MIN((width/(double)nx),(height/(double)ny));
+  tolsq = period_tolerance(canvopts->periodicity, smallerinterval);
   w_re = secopts->wre;
   w_im = secopts->wim;
   lam_re = secopts->lre;
@@ -416,8 +535,8 @@ void type3_julia(CanvasOpts * canvopts,
   
   /* core functionality, execute */
 
-  for (i=0; i<nx; i++) {
-    for (j=0; j<ny; j++) {
+  for (i=i0; i<i0+w; i++) {
+    for (j=j0; j<j0+h; j++) {
 
       //julia set: iterate x0, y0, not lambda
       x0 = left + ((float64)i) * width / ((float64)nx);
@@ -427,12 +546,14 @@ void type3_julia(CanvasOpts * canvopts,
       rhoz = sqrt(x0*x0 + y0*y0);
       thetaz = atan2(y0,x0);
       n = 0;
+      p = 0;
       if ( x0 > 50. ) {
 
-	continue;
+	/* escaped at once: n and p stay 0, and the point is still written */
 
       } else {
 
+	period_start(&pc, x0, y0, tolsq);
 	while ( n < max ) {
 
 	  if (NEARZERO(rhoz,smallerinterval) == 1) {
@@ -455,14 +576,25 @@ void type3_julia(CanvasOpts * canvopts,
 	    else 
 	      break;
 	  }
-	  
+
+	  if ( (tolsq > 0.) && (p = period_step(&pc, x, y)) ) {
+	    n = max;
+	    break;
+	  }
+
 	} /* while n < max */
 
       } /* if x < 50 */
       
-      (*canv)[i][j].re = x0;
-      (*canv)[i][j].im = y0;
-      (*canv)[i][j].n = n;
+      k = (i-i0)*stride + (j-j0);
+      canv[k].re = x0;
+      canv[k].im = y0;
+      canv[k].n = n;
+      if (percanv) {
+	percanv[k].re = x0;
+	percanv[k].im = y0;
+	percanv[k].n = p;
+      }
 
     } /* for j */
   } /* for i */
@@ -473,15 +605,24 @@ void type3_julia(CanvasOpts * canvopts,
 
 void type1_mandel(CanvasOpts * canvopts,
 		  SecondaryOpts * secopts,
-		  Datum *** canv) {
+		  uint32 i0,
+		  uint32 j0,
+		  uint32 w,
+		  uint32 h,
+		  Datum * canv,
+		  Datum * percanv,
+		  uint32 stride) {
   float64 x, y, expbuf, modbuf, prodbuf, inner, left, bottom, width, height;
   float64 logrhoz;
   float64 thetaz, rhoz, thetal, rhol;
-  uint32 n, max;
+  uint32 n, max, p;
+  PeriodCheck pc;
+  float64 tolsq;
   float64 w_re, w_im;
   float64 lam_re, lam_im;
   float64 smallerinterval;
   uint32 nx, ny;
+  uint32 k;
   int i, j;
 
   left = canvopts->left;
@@ -492,13 +633,14 @@ void type1_mandel(CanvasOpts * canvopts,
   height = canvopts->height;
   max = canvopts->escape;
   smallerinterval = MIN((width/(double)nx),(height/(double)ny));
+  tolsq = period_tolerance(canvopts->periodicity, smallerinterval);
   w_re = secopts->wre;
   w_im = secopts->wim;
   
   /* core functionality, execute */
 
-  for (i=0; i<nx; i++) {
-    for (j=0; j<ny; j++) {
+  for (i=i0; i<i0+w; i++) {
+    for (j=j0; j<j0+h; j++) {
 
       //mandelbrot set: iterate lambda, but z starts at 0
       lam_re = left + ((float64)i) * width / ((float64)nx);
@@ -506,16 +648,18 @@ void type1_mandel(CanvasOpts * canvopts,
       rhol = sqrt(lam_re*lam_re + lam_im*lam_im);
       thetal = atan2(lam_im, lam_re);
       n = 0;
+      p = 0;
 
       if ( lam_re > 50. ) {
 
-	continue;
+	/* escaped at once: n and p stay 0, and the point is still written */
 
       } else {
 
 	x = 0.;
 	y = 0.;
 
+	period_start(&pc, x, y, tolsq);
 	while ( n < max ) {
 
 	  rhoz = sqrt(x*x + y*y);
@@ -538,14 +682,25 @@ void type1_mandel(CanvasOpts * canvopts,
 	    else 
 	      break;
 	  }
-	  
+
+	  if ( (tolsq > 0.) && (p = period_step(&pc, x, y)) ) {
+	    n = max;
+	    break;
+	  }
+
 	} /* while n < max */
 
       } /* if lam > 50 */
       
-      (*canv)[i][j].re = lam_re;
-      (*canv)[i][j].im = lam_im;
-      (*canv)[i][j].n = n;
+      k = (i-i0)*stride + (j-j0);
+      canv[k].re = lam_re;
+      canv[k].im = lam_im;
+      canv[k].n = n;
+      if (percanv) {
+	percanv[k].re = lam_re;
+	percanv[k].im = lam_im;
+	percanv[k].n = p;
+      }
 
     } /* for j */
   } /* for i */
@@ -556,15 +711,24 @@ void type1_mandel(CanvasOpts * canvopts,
 
 void type2_mandel(CanvasOpts * canvopts,
 		  SecondaryOpts * secopts,
-		  Datum *** canv) {
+		  uint32 i0,
+		  uint32 j0,
+		  uint32 w,
+		  uint32 h,
+		  Datum * canv,
+		  Datum * percanv,
+		  uint32 stride) {
   float64 x, y, expbuf, modbuf, prodbuf, inner, left, bottom, width, height;
   float64 logrhoz;
   float64 thetaz, rhoz, thetal, rhol;
-  uint32 n, max;
+  uint32 n, max, p;
+  PeriodCheck pc;
+  float64 tolsq;
   float64 w_re, w_im;
   float64 lam_re, lam_im;
   float64 smallerinterval;
   uint32 nx, ny;
+  uint32 k;
   int i, j;
 
   left = canvopts->left;
@@ -575,28 +739,31 @@ void type2_mandel(CanvasOpts * canvopts,
   height = canvopts->height;
   max = canvopts->escape;
   smallerinterval = MIN((width/(double)nx),(height/(double)ny));
+  tolsq = period_tolerance(canvopts->periodicity, smallerinterval);
   w_re = secopts->wre;
   w_im = secopts->wim;
   
   /* core functionality, execute */
 
-  for (i=0; i<nx; i++) {
-    for (j=0; j<ny; j++) {
+  for (i=i0; i<i0+w; i++) {
+    for (j=j0; j<j0+h; j++) {
 
       //mandelbrot set: iterate lambda, but z starts at 0
       lam_re = left + ((float64)i) * width / ((float64)nx);
       lam_im = bottom + ((float64)j) * height / ((float64)ny);
       n = 0;
+      p = 0;
 
       if ( lam_re > 50. ) {
 
-	continue;
+	/* escaped at once: n and p stay 0, and the point is still written */
 
       } else {
 
 	x = 0.;
 	y = 0.;
 
+	period_start(&pc, x, y, tolsq);
 	while ( n < max ) {
 
 	  rhoz = sqrt(x*x + y*y);
@@ -620,14 +787,25 @@ void type2_mandel(CanvasOpts * canvopts,
 	    else 
 	      break;
 	  }
-	  
+
+	  if ( (tolsq > 0.) && (p = period_step(&pc, x, y)) ) {
+	    n = max;
+	    break;
+	  }
+
 	} /* while n < max */
 
       } /* if x < 50 */
       
-      (*canv)[i][j].re = lam_re;
-      (*canv)[i][j].im = lam_im;
-      (*canv)[i][j].n = n;
+      k = (i-i0)*stride + (j-j0);
+      canv[k].re = lam_re;
+      canv[k].im = lam_im;
+      canv[k].n = n;
+      if (percanv) {
+	percanv[k].re = lam_re;
+	percanv[k].im = lam_im;
+	percanv[k].n = p;
+      }
 
     } /* for j */
   } /* for i */
@@ -639,15 +817,24 @@ void type2_mandel(CanvasOpts * canvopts,
 
 void type3_mandel(CanvasOpts * canvopts,
 		  SecondaryOpts * secopts,
-		  Datum *** canv) {
+		  uint32 i0,
+		  uint32 j0,
+		  uint32 w,
+		  uint32 h,
+		  Datum * canv,
+		  Datum * percanv,
+		  uint32 stride) {
   float64 x, y, expbuf, modbuf, prodbuf, inner, left, bottom, width, height;
   float64 logrhoz;
   float64 thetaz, rhoz, thetal, rhol;
-  uint32 n, max;
+  uint32 n, max, p;
+  PeriodCheck pc;
+  float64 tolsq;
   float64 w_re, w_im;
   float64 lam_re, lam_im;
   float64 smallerinterval;
   uint32 nx, ny;
+  uint32 k;
   int i, j;
 
   left = canvopts->left;
@@ -658,13 +845,14 @@ void type3_mandel(CanvasOpts * canvopts,
   height = canvopts->height;
   max = canvopts->escape;
   smallerinterval = MIN((width/(double)nx),(height/(double)ny));
+  tolsq = period_tolerance(canvopts->periodicity, smallerinterval);
   w_re = secopts->wre;
   w_im = secopts->wim;
   
   /* core functionality, execute */
 
-  for (i=0; i<nx; i++) {
-    for (j=0; j<ny; j++) {
+  for (i=i0; i<i0+w; i++) {
+    for (j=j0; j<j0+h; j++) {
 
       //mandelbrot set: iterate lambda, but z starts at 0
       lam_re = left + ((float64)i) * width / ((float64)nx);
@@ -672,16 +860,18 @@ void type3_mandel(CanvasOpts * canvopts,
       rhol = sqrt(lam_re*lam_re + lam_im*lam_im);
       thetal = atan2(lam_im, lam_re);
       n = 0;
+      p = 0;
       
       if ( lam_re > 50. ) {
 
-	continue;
+	/* escaped at once: n and p stay 0, and the point is still written */
 
       } else {
 
 	x = 0.;
 	y = 0.;
 
+	period_start(&pc, x, y, tolsq);
 	while ( n < max ) {
 
 	  rhoz = sqrt(x*x + y*y);
@@ -704,14 +894,25 @@ void type3_mandel(CanvasOpts * canvopts,
 	    else 
 	      break;
 	  }
-	  
+
+	  if ( (tolsq > 0.) && (p = period_step(&pc, x, y)) ) {
+	    n = max;
+	    break;
+	  }
+
 	} /* while n < max */
 
       } /* if x < 50 */
       
-      (*canv)[i][j].re = lam_re;
-      (*canv)[i][j].im = lam_im;
-      (*canv)[i][j].n = n;
+      k = (i-i0)*stride + (j-j0);
+      canv[k].re = lam_re;
+      canv[k].im = lam_im;
+      canv[k].n = n;
+      if (percanv) {
+	percanv[k].re = lam_re;
+	percanv[k].im = lam_im;
+	percanv[k].n = p;
+      }
 
     } /* for j */
   } /* for i */
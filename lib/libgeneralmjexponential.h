@@ -57,6 +57,15 @@ int EXECUTE(CanvasOpts * canvopts,
 	    char ** outfn,
 	    uint32 outfl); 
 
+int TILE_SETUP(CanvasOpts * canvopts);
+
+int EXECUTE_TILE(CanvasOpts * canvopts,
+		 uint32 x0,
+		 uint32 y0,
+		 uint32 w,
+		 uint32 h,
+		 Datum * tile);
+
 
 
 #endif /* LIBGENERALMJEXPONENTIAL_H */
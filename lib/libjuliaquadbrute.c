@@ -4,7 +4,20 @@
 /*   for the quadratic function z^2 + c.                                    */
 /*   For a finishing library, this outputs only a single double array of    */
 /*   unsigned ints.                                                         */
-/*   Last updated: 2024 May                                                 */
+/*   Also provides TILE_SETUP and EXECUTE_TILE so that the core can drive   */
+/*   the computation itself (see engine.h). The iteration runs in the       */
+/*   vector kernels of quadkernel.c, chosen for the CPU at setup, with      */
+/*   cycle detection per the canvas option "periodicity" (periodicity.h);   */
+/*   with 2, the periods are output as a second canvas.                     */
+/*   With canvas option "subdivide", tiles are filled from their borders    */
+/*   wherever these are solid (subdivide.h). Where the view is symmetric    */
+/*   through the origin, the pixels with a mirror image are copied from it  */
+/*   (symmetry.h), by TILE_COMPLETE when the core drives the tiles.         */
+/*   With canvas option "resume" naming a file, the orbits of the pixels    */
+/*   are kept there, and a later render of the same view and constant with  */
+/*   a higher escape limit iterates only the unfinished ones on             */
+/*   (resume.h); this turns subdivision off.                                */
+/*   Last updated: 2024 June                                                */
 /****************************************************************************/
 /*  Author: Miguel Abele                                                    */
 /*  Copyrighted by Miguel Abele, 2024.                                      */
@@ -31,11 +44,292 @@
 
 
 #include "libjuliaquadbrute.h"
+#include "quadkernel.h"
+#include "periodicity.h"
+#include "subdivide.h"
+#include "symmetry.h"
+#include "resume.h"
+#include "schedule.h"
 #include <stdlib.h>
+#include <string.h>
 
 
-#define FREE_DBL_ARRAY(arr,l,m) { if ((arr)) { for (l=0; l<m; l++) { free((arr)[l]); } free((arr)); (arr)=NULL; } }
-#define CLOSE_FILE_ARRAY(arr,l,m) { if ((arr)) { for (l=0; l<m; l++) { if ((arr)[l]) fclose((arr)[l]); free((arr)); (arr)=NULL; } } }
+#define CLOSE_FILE_ARRAY(arr,l,m) { if ((arr)) { for (l=0; l<m; l++) { if ((arr)[l]) output_close((arr)[l]); } free((arr)); (arr)=NULL; } }
+
+
+/* escape-time kernel for this CPU, chosen by EXECUTE or TILE_SETUP */
+static QuadKernel kernel = quadkernel_scalar;
+
+/* pixels filled by subdivision rather than computed, for the debug output */
+static uint64 filled_count = 0;
+
+/* the rows EXECUTE_TILE leaves for TILE_COMPLETE to mirror */
+static Mirror tilemirror;
+
+/* orbits kept for canvas option "resume", and those taken up as final */
+static ResumeState resume;
+static uint64 resumed_count = 0;
+
+
+/* what a subdivision computes into: pixel (i,j) is at
+   canv[(i-i0)*stride + (j-j0)], and likewise in percanv if requested */
+struct region_context {
+  CanvasOpts * canvopts;
+  uint32 i0, j0;
+  Datum * canv;
+  Datum * percanv;
+  uint32 stride;
+};
+typedef struct region_context RegionContext;
+
+
+static inline int prepare_resume(CanvasOpts * canvopts) {
+  resumed_count = 0;
+  return (resume_begin(&resume, canvopts, "libjuliaqb") ? LIBMALLOC : 0);
+}
+
+
+static inline void report_resume(CanvasOpts * canvopts) {
+  if (canvopts->debug && resume_loaded(&resume))
+    DEBUG(canvopts->debug, D1, "libjuliaqb: %lu of %lu pixels final in the resumed orbits, not iterated\n",
+	  resumed_count, (uint64)canvopts->nwidth * canvopts->nheight);
+}
+
+
+/* subdivision leaves no orbits to keep */
+static inline int use_subdivide(CanvasOpts * canvopts) {
+  return ((canvopts->subdivide != SUB_OFF) && (resume.points == NULL));
+}
+
+
+static inline void report_subdivide(CanvasOpts * canvopts) {
+  if (canvopts->debug && (canvopts->subdivide != SUB_OFF))
+    DEBUG(canvopts->debug, D1, "libjuliaqb: %lu of %lu pixels filled by subdivision, not computed\n",
+	  filled_count, (uint64)canvopts->nwidth * canvopts->nheight);
+}
+
+
+/* compute the pixels [i0,i0+w) x [j0,j0+h): pixel (i,j) is stored at
+   canv[(i-i0)*stride + (j-j0)], and its period, if percanv is given, at the
+   same place in percanv */
+static void julia_region(CanvasOpts * canvopts,
+			 uint32 i0,
+			 uint32 j0,
+			 uint32 w,
+			 uint32 h,
+			 Datum * canv,
+			 Datum * percanv,
+			 uint32 stride)
+{
+  float64 zre[QK_BATCH], zim[QK_BATCH], cre[QK_BATCH], cim[QK_BATCH];
+  float64 kzre[QK_BATCH], kzim[QK_BATCH];
+  uint32 cnt[QK_BATCH], per[QK_BATCH], pos[QK_BATCH], kcnt[QK_BATCH], kper[QK_BATCH];
+  float64 x, y, x0, y0, left, bottom, width, height;
+  float64 tolsq;
+  uint32 max, start;
+  uint32 nx, ny;
+  uint32 k, b, m, q;
+  uint64 final = 0;
+  ResumePoint * rp;
+  int i, j;
+
+  left = canvopts->left;
+  nx = canvopts->nwidth;
+  width = canvopts->width;
+  bottom = canvopts->bottom;
+  ny = canvopts->nheight;
+  height = canvopts->height;
+  max = canvopts->escape;
+  x0 = canvopts->coord_Re;
+  y0 = canvopts->coord_Im;
+  start = resume.start;
+  tolsq = period_tolerance(canvopts->periodicity,
+			   (width/(float64)nx < height/(float64)ny ? width/(float64)nx : height/(float64)ny));
+
+  for (i=i0; i<i0+w; i++) {
+
+    x = left + ((float64)i) * width / ((float64)nx);
+
+    for (j=j0; j<j0+h; j+=QK_BATCH) {
+
+      m = (j0+h-j < QK_BATCH ? j0+h-j : QK_BATCH);
+      q = 0;
+      for (b=0; b<m; b++) {
+	y = bottom + ((float64)(j+b)) * height / ((float64)ny);
+	k = (i-i0)*stride + (j+b-j0);
+	canv[k].re = x;
+	canv[k].im = y;
+	cre[b] = x0;
+	cim[b] = y0;
+	if (start) {
+	  /* final orbits are taken as they are, the rest iterated on past
+	     the old limit */
+	  rp = resume_at(&resume, i, j+b);
+	  if (resume_final(&resume, rp)) {
+	    zre[b] = rp->zre;
+	    zim[b] = rp->zim;
+	    cnt[b] = (rp->n < start ? rp->n : max);
+	    per[b] = rp->period;
+	    final++;
+	    continue;
+	  }
+	  kzre[q] = rp->zre;
+	  kzim[q] = rp->zim;
+	} else {
+	  /* the count here starts after the first step, so take that step
+	     and let the kernel test and count the rest */
+	  kzim[q] = (x+x)*y + y0;
+	  kzre[q] = x*x - y*y + x0;
+	}
+	pos[q] = b;
+	q++;
+      }
+
+      kernel(kzre, kzim, cre, cim, kcnt, kper, q, max - start, tolsq);
+      for (b=0; b<q; b++) {
+	zre[pos[b]] = kzre[b];
+	zim[pos[b]] = kzim[b];
+	cnt[pos[b]] = kcnt[b] + start;
+	per[pos[b]] = kper[b];
+      }
+      if (resume.points)
+	resume_store(&resume, i, j, m, zre, zim, cnt, per);
+
+      for (b=0; b<m; b++) {
+	k = (i-i0)*stride + (j+b-j0);
+	canv[k].n = cnt[b];
+	if (percanv) {
+	  percanv[k].re = canv[k].re;
+	  percanv[k].im = canv[k].im;
+	  percanv[k].n = (cnt[b] == max ? per[b] : 0);
+	}
+      }
+
+    } /* for j */
+  } /* for i */
+
+  if (final)
+    __atomic_fetch_add(&resumed_count, final, __ATOMIC_RELAXED);
+
+}
+
+
+/* SubCompute for julia_subdivide */
+static void julia_subregion(void * context,
+			    uint32 i0,
+			    uint32 j0,
+			    uint32 w,
+			    uint32 h)
+{
+  RegionContext * rc = (RegionContext *)context;
+  uint32 k = (i0 - rc->i0)*rc->stride + (j0 - rc->j0);
+
+  julia_region(rc->canvopts, i0, j0, w, h, &(rc->canv[k]),
+	       (rc->percanv ? &(rc->percanv[k]) : NULL), rc->stride);
+}
+
+
+/* as julia_region, but by subdivision */
+static void julia_subdivide(CanvasOpts * canvopts,
+			    uint32 i0,
+			    uint32 j0,
+			    uint32 w,
+			    uint32 h,
+			    Datum * canv,
+			    Datum * percanv,
+			    uint32 stride)
+{
+  RegionContext rc;
+  SubRegion sr;
+
+  rc.canvopts = canvopts;
+  rc.i0 = i0;
+  rc.j0 = j0;
+  rc.canv = canv;
+  rc.percanv = percanv;
+  rc.stride = stride;
+
+  sr.compute = julia_subregion;
+  sr.context = &rc;
+  sr.canv[0] = canv;
+  sr.canv[1] = percanv;
+  sr.canvl = (percanv ? 2 : 1);
+  sr.i0 = i0;
+  sr.j0 = j0;
+  sr.w = w;
+  sr.h = h;
+  sr.stride = stride;
+  sr.verify = canvopts->subdivide;
+
+  __atomic_fetch_add(&filled_count, subdivide(&sr), __ATOMIC_RELAXED);
+}
+
+
+/* Kc is symmetric through the origin, whatever c */
+static inline void prepare_mirror(CanvasOpts * canvopts, Mirror * m) {
+  mirror_point(m, canvopts);
+  if (canvopts->debug && mirror_count(m))
+    DEBUG(canvopts->debug, D1, "libjuliaqb: %lu of %lu pixels mirrored through the origin, not computed\n",
+	  mirror_count(m), (uint64)canvopts->nwidth * canvopts->nheight);
+}
+
+
+/* part of a tile, with the layout of julia_region */
+static void julia_part(CanvasOpts * canvopts,
+		       uint32 i0,
+		       uint32 j0,
+		       uint32 w,
+		       uint32 h,
+		       Datum * canv,
+		       Datum * percanv,
+		       uint32 stride)
+{
+  if (h == 0)
+    return;
+  if (use_subdivide(canvopts))
+    julia_subdivide(canvopts, i0, j0, w, h, canv, percanv, stride);
+  else
+    julia_region(canvopts, i0, j0, w, h, canv, percanv, stride);
+}
+
+
+/* a tile, less the rows that are mirrored */
+static void julia_tile(CanvasOpts * canvopts,
+		       Mirror * m,
+		       uint32 i0,
+		       uint32 j0,
+		       uint32 w,
+		       uint32 h,
+		       Datum * canv,
+		       Datum * percanv,
+		       uint32 stride)
+{
+  uint32 a0, a1, skip;
+
+  mirror_rows(m, i0, j0, w, h, &a0, &a1);
+  julia_part(canvopts, i0, j0, w, a0 - j0, canv, percanv, stride);
+  skip = a1 - j0;
+  julia_part(canvopts, i0, a1, w, j0 + h - a1,
+	     &(canv[skip]), (percanv ? &(percanv[skip]) : NULL), stride);
+}
+
+
+/* EXECUTE's canvases, tile by tile in place */
+static void julia_blocks(CanvasOpts * canvopts, Mirror * m, Canvas * canv, Canvas * percanv)
+{
+  uint32 i0, j0, w, h;
+
+  for (i0=0; i0<canvopts->nwidth; i0+=SCHED_TILE_SIZE) {
+    w = (i0 + SCHED_TILE_SIZE > canvopts->nwidth ? canvopts->nwidth - i0 : SCHED_TILE_SIZE);
+    for (j0=0; j0<canvopts->nheight; j0+=SCHED_TILE_SIZE) {
+      h = (j0 + SCHED_TILE_SIZE > canvopts->nheight ? canvopts->nheight - j0 : SCHED_TILE_SIZE);
+      julia_tile(canvopts, m, i0, j0, w, h,
+		 canvas_at(canv, i0, j0),
+		 (percanv ? canvas_at(percanv, i0, j0) : NULL),
+		 canv->stride);
+    }
+  }
+}
 
 
 int EXECUTE(CanvasOpts * canvopts,
@@ -45,116 +339,139 @@ int EXECUTE(CanvasOpts * canvopts,
 	    uint32 outfl)
 {
   /* The data holders used in execute */
-  Datum ** canv;
+  Mirror mirror;
   /* Validator will check dataa and datal, outfa and outfl.
      dataa must be one spot for each data holder used above, datal the total num.
      outfa is the array of file pointers, and outfl the total num. */
-  Datum *** canva = NULL;
-  const uint32 canvl = 1;
+  Canvas * canva = NULL;
+  uint32 canvl;
   FILE ** outfa = NULL;
   /* variables local to execute */
-  float64 x, y, xtmp, ytmp, x0, y0, left, bottom, width, height;
-  uint32 n, max;
-  uint32 nx, ny;
   int i, j;
 
   if ( (canvopts==NULL) || (finfunc==NULL) || (validfunc==NULL) || (outfn==NULL) )
     return LIBBADCALL;
 
-  /* setup memory and organize for validator */
+  kernel = quadkernel_select();
+  canvl = (canvopts->periodicity == PERIOD_CANVAS ? 2 : 1);
 
-  canv = malloc(sizeof(Datum *)*canvopts->nwidth);
-  if (canv == NULL)
-    return LIBMALLOC;
-  for (i=0; i<canvopts->nwidth; i++) {
-    canv[i] = malloc(sizeof(Datum)*canvopts->nheight);
-    if (canv[i-1] == NULL) {
-      FREE_DBL_ARRAY(canv,j,i-2);
-      return LIBMALLOC;
-    }
-  }
+  /* setup memory and organize for validator */
 
-  canva = malloc(sizeof(Datum **)*canvl);
-  if (canva == NULL) {
-    FREE_DBL_ARRAY(canv,j,canvopts->nwidth);
+  canva = canvas_alloc_set(canvl, canvopts->nwidth, canvopts->nheight, CANVAS_COLUMNS, CANVAS_FULL);
+  if (canva == NULL)
     return LIBMALLOC;
-  }
-  canva[0] = canv;
 
   outfa = malloc(sizeof(FILE *)*outfl);
   if (outfa == NULL) {
-    FREE_DBL_ARRAY(canv,j,canvopts->nwidth);
-    free(canva);
+    canvas_free_set(canva, canvl);
     return LIBMALLOC;
   }
   for (i=0; i<outfl; i++) {
-    outfa[i] = fopen(outfn[i], "wb");
+    outfa[i] = output_open(outfn[i]);
     if (!outfa[i-1]) {
       CLOSE_FILE_ARRAY(outfa,j,i-2);
-      FREE_DBL_ARRAY(canv,j,canvopts->nwidth);
-      free(canva);
+      canvas_free_set(canva, canvl);
       return LIBFILE;
     }
   }
 
   if (validfunc(canva, canvl, outfa, outfl) != 0) {
-    FREE_DBL_ARRAY(canv,j,canvopts->nwidth);
-    free(canva);
+    canvas_free_set(canva, canvl);
     CLOSE_FILE_ARRAY(outfa,j,outfl);
     return LIBVALIDATE;
   }
 
-  /* need to "palettize" here */
+  if (prepare_resume(canvopts) != 0) {
+    canvas_free_set(canva, canvl);
+    CLOSE_FILE_ARRAY(outfa,j,outfl);
+    return LIBMALLOC;
+  }
 
-  left = canvopts->left;
-  nx = canvopts->nwidth;
-  width = canvopts->width;
-  bottom = canvopts->bottom;
-  ny = canvopts->nheight;
-  height = canvopts->height;
-  max = canvopts->escape;
-  x0 = canvopts->coord_Re;
-  y0 = canvopts->coord_Im;
-  
   /* core functionality, execute */
 
-  for (i=0; i<nx; i++) {
-    for (j=0; j<ny; j++) {
+  filled_count = 0;
+  prepare_mirror(canvopts, &mirror);
+  julia_blocks(canvopts, &mirror, &(canva[0]), (canvl == 2 ? &(canva[1]) : NULL));
+  mirror_fill(&mirror, canva, canvl);
+  /* f(-z) = f(z), and the orbits are kept from the first step on */
+  resume_mirror(&resume, &mirror, 0);
+  report_subdivide(canvopts);
+  report_resume(canvopts);
+  resume_end(&resume, canvopts);
 
-      x = left + ((float64)i) * width / ((float64)nx);
-      y = bottom + ((float64)j) * height / ((float64)ny);
-      n = 0;
-      canv[i][j].re = x;
-      canv[i][j].im = y;
+  /* output results */
 
-      while ( n < max ) {
-	
-	ytmp = (x+x)*y + y0;
-	x = x*x - y*y + x0;
-	y = ytmp;
+  finfunc(canvopts, canva, canvl, outfa, outfl);
 
-	if (x*x + y*y > 4.0) {
-	  break;
-	}
-	
-	n += 1;
+  canvas_free_set(canva, canvl);
+  CLOSE_FILE_ARRAY(outfa,i,outfl);
+  
+  return 0;
+  
+}
 
-      }
 
-      canv[i][j].n = n;
 
-    } /* for j */
-  } /* for i */
+int TILE_SETUP(CanvasOpts * canvopts)
+{
+  if (canvopts==NULL)
+    return LIBBADCALL;
 
-  /* output results */
+  kernel = quadkernel_select();
+  filled_count = 0;
+  if (prepare_resume(canvopts) != 0)
+    return LIBMALLOC;
+  /* streamed bands leave before their mirror images are computed */
+  if (canvopts->stream)
+    mirror_none(&tilemirror);
+  else
+    prepare_mirror(canvopts, &tilemirror);
 
-  finfunc(canvopts, canva, canvl, outfa, outfl);
+  return (canvopts->periodicity == PERIOD_CANVAS ? 2 : 1);
+}
+
+
+
+int TILE_COMPLETE(CanvasOpts * canvopts, Canvas * canva, uint32 canvl)
+{
+  if ( (canvopts==NULL) || (canva==NULL) )
+    return LIBBADCALL;
+
+  mirror_fill(&tilemirror, canva, canvl);
+  resume_mirror(&resume, &tilemirror, 0);
+
+  return 0;
+}
+
+
+
+void TILE_CLEANUP(CanvasOpts * canvopts)
+{
+  report_subdivide(canvopts);
+  report_resume(canvopts);
+  resume_end(&resume, canvopts);
+}
+
+
+
+int EXECUTE_TILE(CanvasOpts * canvopts,
+		 uint32 x0,
+		 uint32 y0,
+		 uint32 w,
+		 uint32 h,
+		 Datum * tile)
+{
+  uint32 a0, a1;
+
+  if ( (canvopts==NULL) || (tile==NULL) )
+    return LIBBADCALL;
+
+  /* rows left out are mirrored by TILE_COMPLETE */
+  julia_tile(canvopts, &tilemirror, x0, y0, w, h, tile,
+	     (canvopts->periodicity == PERIOD_CANVAS ? &(tile[w*h]) : NULL), h);
+  mirror_rows(&tilemirror, x0, y0, w, h, &a0, &a1);
+  mirror_clear(tile, w, h, y0, a0, a1,
+	       (canvopts->periodicity == PERIOD_CANVAS ? 2 : 1));
 
-  FREE_DBL_ARRAY(canv,i,canvopts->nwidth);
-  if (canva)
-    free(canva);
-  CLOSE_FILE_ARRAY(outfa,i,outfl);
-  
   return 0;
-  
 }
@@ -50,6 +50,19 @@ int EXECUTE(CanvasOpts * canvopts,
 	    char ** outfn,
 	    uint32 outfl); 
 
+int TILE_SETUP(CanvasOpts * canvopts);
+
+int EXECUTE_TILE(CanvasOpts * canvopts,
+		 uint32 x0,
+		 uint32 y0,
+		 uint32 w,
+		 uint32 h,
+		 Datum * tile);
+
+int TILE_COMPLETE(CanvasOpts * canvopts, Canvas * canva, uint32 canvl);
+
+void TILE_CLEANUP(CanvasOpts * canvopts);
+
 
 
 #endif /* LIBJULIAQUADBRUTE_H */
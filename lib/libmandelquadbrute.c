@@ -5,7 +5,35 @@
 /*   For a finishing library, this outputs up to two double arrays of       */
 /*   unsigned ints. Use "secondary" in conf file, one double for the mult   */
 /*   variable and one integer for the option produce this second array.     */
-/*   Last updated: 2024 May                                                 */
+/*   The canvas is computed in tiles; with canvas option "threads" above 1  */
+/*   the tiles are shared among worker threads (see schedule.h). Each pixel */
+/*   is computed identically either way.                                    */
+/*   Also provides TILE_SETUP and EXECUTE_TILE so that the core can drive   */
+/*   the computation itself (see engine.h). The iteration runs in the       */
+/*   vector kernels of quadkernel.c, chosen for the CPU at setup. Pixels in */
+/*   the main cardioid or the period-2 bulb are recognized in closed form   */
+/*   and not iterated (unless the distance canvas is wanted). Other points  */
+/*   are checked for cycles (periodicity.h) as they iterate, per the canvas */
+/*   option "periodicity"; with 2, the periods are output as an extra       */
+/*   canvas, after the distance canvas if that is requested. Perturbation   */
+/*   does no cycle detection.                                               */
+/*   With canvas option "subdivide", each tile is filled from its borders   */
+/*   (subdivide.h) wherever they are solid, except for the distance canvas. */
+/*   When the view straddles the real axis symmetrically, the rows on one   */
+/*   side are mirrored from the other (symmetry.h), by TILE_COMPLETE when   */
+/*   the core drives the tiles.                                             */
+/*   With canvas option "resume" naming a file, the orbits of the pixels    */
+/*   are kept there, and a later render of the same view with a higher    */
+/*   escape limit iterates only the unfinished ones on (resume.h); this     */
+/*   turns subdivision off, and perturbation does not keep them.            */
+/*   A third secondary option selects the engine: 0 iterates each pixel     */
+/*   directly, 1 uses perturbation (perturbation.h) for deep zooms. With    */
+/*   1, two more secondary options give the real and imaginary parts of     */
+/*   the center of the view as decimal strings, to as many digits as the    */
+/*   zoom needs; left and bottom are then unused. The first iterations are  */
+/*   skipped by series approximation, reported in the debug output. E.g.    */
+/*     "secondary": [ 0, 0, 1, "-0.743643887037158704752", "0.13182590" ]   */
+/*   Last updated: 2024 June                                                */
 /****************************************************************************/
 /*  Author: Miguel Abele                                                    */
 /*  Copyrighted by Miguel Abele, 2024.                                      */
@@ -32,21 +60,81 @@
 
 
 #include "libmandelquadbrute.h"
+#include "schedule.h"
+#include "quadkernel.h"
+#include "perturbation.h"
+#include "periodicity.h"
+#include "subdivide.h"
+#include "symmetry.h"
+#include "resume.h"
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 
-#define FREE_DBL_ARRAY(arr,l,m) { if ((arr)) { for (l=0; l<m; l++) { free((arr)[l]); } free((arr)); (arr)=NULL; } }
-#define CLOSE_FILE_ARRAY(arr,l,m) { if ((arr)) { for (l=0; l<m; l++) { if ((arr)[l]) fclose((arr)[l]); } free((arr)); (arr)=NULL; } } 
+#define CLOSE_FILE_ARRAY(arr,l,m) { if ((arr)) { for (l=0; l<m; l++) { if ((arr)[l]) output_close((arr)[l]); } free((arr)); (arr)=NULL; } } 
+
+
+/* engines, third secondary option */
+#define ENGINE_DIRECT     0
+#define ENGINE_PERTURB    1
 
 
 struct secondary_option {
   float64 mult;
   int option;
+  int engine;
+  char * centre_re;     /* perturbation: center of the view, in decimal */
+  char * centre_im;
+  RefOrbit ref;
 };
 typedef struct secondary_option SecondaryOpts;
 
 
+struct tile_context {
+  CanvasOpts * canvopts;
+  SecondaryOpts * secopts;
+  Canvas * canv;
+  Canvas * distcanv;
+  Canvas * percanv;
+  Mirror mirror;
+};
+typedef struct tile_context TileContext;
+
+
+/* what a subdivision computes into: pixel (i,j) is at
+   canv[(i-i0)*stride + (j-j0)], and likewise in percanv if requested */
+struct region_context {
+  CanvasOpts * canvopts;
+  SecondaryOpts * secopts;
+  uint32 i0, j0;
+  Datum * canv;
+  Datum * percanv;
+  uint32 stride;
+};
+typedef struct region_context RegionContext;
+
+
+/* options parsed by TILE_SETUP for use by every EXECUTE_TILE call */
+static SecondaryOpts tilesecopts;
+
+/* and the rows EXECUTE_TILE leaves for TILE_COMPLETE to mirror */
+static Mirror tilemirror;
+
+/* escape-time kernel for this CPU, chosen by EXECUTE or TILE_SETUP */
+static QuadKernel kernel = quadkernel_scalar;
+
+/* pixels found inside the main cardioid or bulb, for the debug output */
+static uint64 shortcut_count = 0;
+
+/* pixels filled by subdivision rather than computed, likewise */
+static uint64 filled_count = 0;
+
+/* orbits kept for canvas option "resume", and those taken up as final */
+static ResumeState resume;
+static uint64 resumed_count = 0;
+
+
 static inline int process_sec_opts(char ** const src, const uint32 l, SecondaryOpts * targ) {
   if ((src==NULL) || (targ==NULL))
     return LIBBADCALL;
@@ -54,6 +142,386 @@ static inline int process_sec_opts(char ** const src, const uint32 l, SecondaryO
     return LIBBADAUXLEN;
   targ->mult = atof(src[0]);
   targ->option = atoi(src[1]);
+  targ->engine = (l > 2 ? atoi(src[2]) : ENGINE_DIRECT);
+  targ->centre_re = NULL;
+  targ->centre_im = NULL;
+  if (targ->engine == ENGINE_PERTURB) {
+    if (l < 5)
+      return LIBBADAUXLEN;
+    targ->centre_re = src[3];
+    targ->centre_im = src[4];
+  } else if (targ->engine != ENGINE_DIRECT) {
+    return LIBBADAUXOPT;
+  }
+  return 0;
+}
+
+
+/* secondary options are not required for this lib */
+static inline int read_sec_opts(CanvasOpts * canvopts, SecondaryOpts * targ) {
+  if (canvopts->secondary)
+    return process_sec_opts(canvopts->secondary, canvopts->secondaryl, targ);
+  targ->mult = 0.0;
+  targ->option = 0;
+  targ->engine = ENGINE_DIRECT;
+  return 0;
+}
+
+
+/* perturbation needs its reference orbit before any pixel is computed */
+static inline int prepare_engine(CanvasOpts * canvopts, SecondaryOpts * secopts) {
+  float64 spacing;
+  int ret;
+  secopts->ref.zre = NULL;
+  secopts->ref.zim = NULL;
+  if (secopts->engine != ENGINE_PERTURB)
+    return 0;
+  spacing = canvopts->width / (float64)canvopts->nwidth;
+  if (canvopts->height / (float64)canvopts->nheight < spacing)
+    spacing = canvopts->height / (float64)canvopts->nheight;
+  ret = perturb_reference(&(secopts->ref), secopts->centre_re, secopts->centre_im,
+			  spacing, canvopts->escape);
+  if (ret == PT_MALLOC)
+    return LIBMALLOC;
+  if (ret != 0)
+    return LIBBADAUXOPT;
+  perturb_series(&(secopts->ref), 0.5*canvopts->width, 0.5*canvopts->height, canvopts->escape);
+  if (canvopts->debug)
+    DEBUG(canvopts->debug, D1, "libmandelqb: reference orbit of %u iterations at %d bits, series approximation skips %u\n",
+	  secopts->ref.len - 1, 64*(secopts->ref.limbs-1), secopts->ref.skip);
+  return 0;
+}
+
+
+/* The set is symmetric about the real axis; perturbation is left out, as
+   its pixels are placed about its own center */
+static inline void prepare_mirror(CanvasOpts * canvopts, SecondaryOpts * secopts, Mirror * m) {
+  if (secopts->engine == ENGINE_DIRECT)
+    mirror_conjugate(m, canvopts);
+  else
+    mirror_none(m);
+  if (canvopts->debug && mirror_count(m))
+    DEBUG(canvopts->debug, D1, "libmandelqb: rows %u to %u mirrored about the real axis, not computed\n",
+	  m->j0, m->j1 - 1);
+}
+
+
+/* closed-form membership of the main cardioid and the period-2 bulb,
+   where every point runs to the escape limit: returns the period of the
+   attracting cycle, 1 or 2, or 0 outside both */
+static inline int in_main_bulbs(float64 x, float64 y) {
+  float64 xq = x - 0.25;
+  float64 ysq = y*y;
+  float64 q = xq*xq + ysq;
+  if (q*(q + xq) <= 0.25*ysq)
+    return 1;
+  return ((x+1.)*(x+1.) + ysq <= 0.0625 ? 2 : 0);
+}
+
+
+/* canvases after the first: distance if option 1, then periods */
+static inline uint32 count_canvases(CanvasOpts * canvopts, SecondaryOpts * secopts) {
+  return 1 + (secopts->option == 1) + (canvopts->periodicity == PERIOD_CANVAS);
+}
+
+
+static inline void report_shortcut(CanvasOpts * canvopts) {
+  if (canvopts->debug)
+    DEBUG(canvopts->debug, D1, "libmandelqb: %lu of %lu pixels inside the main cardioid or period-2 bulb, not iterated\n",
+	  shortcut_count, (uint64)canvopts->nwidth * canvopts->nheight);
+}
+
+
+/* orbits are kept only by the direct engine, whose pixels lie on the grid
+   the file records */
+static inline int prepare_resume(CanvasOpts * canvopts, SecondaryOpts * secopts) {
+  resumed_count = 0;
+  if (secopts->engine == ENGINE_DIRECT)
+    return (resume_begin(&resume, canvopts, "libmandelqb") ? LIBMALLOC : 0);
+  resume_none(&resume);
+  if (canvopts->debug && canvopts->resume)
+    DEBUG(canvopts->debug, D1, "libmandelqb: orbits are not resumed under perturbation\n");
+  return 0;
+}
+
+
+static inline void report_resume(CanvasOpts * canvopts) {
+  if (canvopts->debug && resume_loaded(&resume))
+    DEBUG(canvopts->debug, D1, "libmandelqb: %lu of %lu pixels final in the resumed orbits, not iterated\n",
+	  resumed_count, (uint64)canvopts->nwidth * canvopts->nheight);
+}
+
+
+/* subdivision fills from borders, which the distance canvas does not
+   allow, and which leaves no orbits to keep */
+static inline int use_subdivide(CanvasOpts * canvopts, SecondaryOpts * secopts) {
+  return ((canvopts->subdivide != SUB_OFF) && (secopts->option != 1)
+	  && (resume.points == NULL));
+}
+
+
+static inline void report_subdivide(CanvasOpts * canvopts) {
+  if (canvopts->debug && (canvopts->subdivide != SUB_OFF))
+    DEBUG(canvopts->debug, D1, "libmandelqb: %lu of %lu pixels filled by subdivision, not computed\n",
+	  filled_count, (uint64)canvopts->nwidth * canvopts->nheight);
+}
+
+
+/* compute the pixels [i0,i0+w) x [j0,j0+h): pixel (i,j) is stored at
+   canv[(i-i0)*stride + (j-j0)], and likewise in distcanv and percanv if
+   requested */
+static void mandel_region(CanvasOpts * canvopts,
+			  SecondaryOpts * secopts,
+			  uint32 i0,
+			  uint32 j0,
+			  uint32 w,
+			  uint32 h,
+			  Datum * canv,
+			  Datum * distcanv,
+			  Datum * percanv,
+			  uint32 stride)
+{
+  float64 zre[QK_BATCH], zim[QK_BATCH], cim[QK_BATCH];
+  float64 kzre[QK_BATCH], kzim[QK_BATCH], kre[QK_BATCH], kim[QK_BATCH];
+  uint32 cnt[QK_BATCH], pos[QK_BATCH], per[QK_BATCH], kcnt[QK_BATCH], kper[QK_BATCH];
+  float64 xsq, ysq, x0, y0, dx, dy, left, bottom, width, height;
+  uint32 n, max, start;
+  uint32 nx, ny;
+  uint32 k, b, m, q;
+  uint64 inside = 0, final = 0;
+  ResumePoint * rp;
+  float64 tolsq;
+  int shortcut;
+  int i, j;
+
+  left = canvopts->left;
+  nx = canvopts->nwidth;
+  width = canvopts->width;
+  bottom = canvopts->bottom;
+  ny = canvopts->nheight;
+  height = canvopts->height;
+  max = canvopts->escape;
+  start = resume.start;
+  tolsq = period_tolerance(canvopts->periodicity,
+			   (width/(float64)nx < height/(float64)ny ? width/(float64)nx : height/(float64)ny));
+
+  /* the distance canvas needs the final z, which the shortcut does not give */
+  shortcut = (secopts->option != 1);
+
+  /* perturbation: offsets from the center, and pixels are placed there */
+  if (secopts->engine == ENGINE_PERTURB) {
+    left = -0.5*width;
+    bottom = -0.5*height;
+  }
+
+  for (i=i0; i<i0+w; i++) {
+    
+    dx = left + ((float64)i) * width / ((float64)nx);
+    x0 = (secopts->engine == ENGINE_PERTURB ? secopts->ref.cre + dx : dx);
+
+    for (j=j0; j<j0+h; j+=QK_BATCH) {
+
+      m = (j0+h-j < QK_BATCH ? j0+h-j : QK_BATCH);
+
+      if (secopts->engine == ENGINE_PERTURB) {
+	for (b=0; b<m; b++) {
+	  dy = bottom + ((float64)(j+b)) * height / ((float64)ny);
+	  cim[b] = secopts->ref.cim + dy;
+	  cnt[b] = perturb_point(&(secopts->ref), dx, dy, max, &(zre[b]), &(zim[b]));
+	  per[b] = 0;
+	}
+      } else {
+	/* only points not known to be inside, nor final in the resumed
+	   orbits, are handed to the kernel: resumed ones for the
+	   iterations past the old limit */
+	q = 0;
+	for (b=0; b<m; b++) {
+	  cim[b] = bottom + ((float64)(j+b)) * height / ((float64)ny);
+	  zre[b] = 0.;
+	  zim[b] = 0.;
+	  cnt[b] = max;
+	  if (shortcut && (per[b] = in_main_bulbs(x0, cim[b]))) {
+	    inside++;
+	    continue;
+	  }
+	  kzre[q] = 0.;
+	  kzim[q] = 0.;
+	  if (start) {
+	    rp = resume_at(&resume, i, j+b);
+	    if (resume_final(&resume, rp)) {
+	      zre[b] = rp->zre;
+	      zim[b] = rp->zim;
+	      cnt[b] = (rp->n < start ? rp->n : max);
+	      per[b] = rp->period;
+	      final++;
+	      continue;
+	    }
+	    kzre[q] = rp->zre;
+	    kzim[q] = rp->zim;
+	  }
+	  pos[q] = b;
+	  kre[q] = x0;
+	  kim[q] = cim[b];
+	  q++;
+	}
+	kernel(kzre, kzim, kre, kim, kcnt, kper, q, max - start, tolsq);
+	for (b=0; b<q; b++) {
+	  zre[pos[b]] = kzre[b];
+	  zim[pos[b]] = kzim[b];
+	  cnt[pos[b]] = kcnt[b] + start;
+	  per[pos[b]] = kper[b];
+	}
+	if (resume.points)
+	  resume_store(&resume, i, j, m, zre, zim, cnt, per);
+      }
+
+      for (b=0; b<m; b++) {
+
+	y0 = cim[b];
+	k = (i-i0)*stride + (j+b-j0);
+
+	/* points outside the radius-2 disk are not counted as iterated */
+	if ( x0*x0+y0*y0 > 4. )
+	  n = 0;
+	else
+	  n = cnt[b];
+
+	canv[k].re = x0;
+	canv[k].im = y0;
+	canv[k].n = n;
+
+	if (percanv) {
+	  percanv[k].re = x0;
+	  percanv[k].im = y0;
+	  percanv[k].n = (n == max ? per[b] : 0);
+	}
+
+	/* the "distance canvas" computation (currently too brute force to be of value) */
+	if (secopts->option == 1) {
+	  if (n == max) {
+	    distcanv[k].re = x0;
+	    distcanv[k].im = y0;
+	    xsq = zre[b] - x0;
+	    ysq = zim[b] - y0;
+	    distcanv[k].n = (uint32)(sqrt(xsq*xsq+ysq*ysq) / secopts->mult);
+	  } else {
+	    //distcanv[k].n = (uint32)(sqrt(width*width+height*height) / secopts->mult);
+	    distcanv[k].n = 0.0;
+	  }
+	}
+
+      } /* for b */
+
+    } /* for j */
+  } /* for i */
+
+  if (inside)
+    __atomic_fetch_add(&shortcut_count, inside, __ATOMIC_RELAXED);
+  if (final)
+    __atomic_fetch_add(&resumed_count, final, __ATOMIC_RELAXED);
+
+}
+
+
+/* SubCompute for mandel_subdivide */
+static void mandel_subregion(void * context,
+			     uint32 i0,
+			     uint32 j0,
+			     uint32 w,
+			     uint32 h)
+{
+  RegionContext * rc = (RegionContext *)context;
+  uint32 k = (i0 - rc->i0)*rc->stride + (j0 - rc->j0);
+
+  mandel_region(rc->canvopts, rc->secopts, i0, j0, w, h,
+		&(rc->canv[k]), NULL,
+		(rc->percanv ? &(rc->percanv[k]) : NULL),
+		rc->stride);
+}
+
+
+/* as mandel_region, without the distance canvas, but by subdivision */
+static void mandel_subdivide(CanvasOpts * canvopts,
+			     SecondaryOpts * secopts,
+			     uint32 i0,
+			     uint32 j0,
+			     uint32 w,
+			     uint32 h,
+			     Datum * canv,
+			     Datum * percanv,
+			     uint32 stride)
+{
+  RegionContext rc;
+  SubRegion sr;
+
+  rc.canvopts = canvopts;
+  rc.secopts = secopts;
+  rc.i0 = i0;
+  rc.j0 = j0;
+  rc.canv = canv;
+  rc.percanv = percanv;
+  rc.stride = stride;
+
+  sr.compute = mandel_subregion;
+  sr.context = &rc;
+  sr.canv[0] = canv;
+  sr.canv[1] = percanv;
+  sr.canvl = (percanv ? 2 : 1);
+  sr.i0 = i0;
+  sr.j0 = j0;
+  sr.w = w;
+  sr.h = h;
+  sr.stride = stride;
+  sr.verify = canvopts->subdivide;
+
+  __atomic_fetch_add(&filled_count, subdivide(&sr), __ATOMIC_RELAXED);
+}
+
+
+/* part of a tile, with the layout of mandel_region */
+static void mandel_part(CanvasOpts * canvopts,
+			SecondaryOpts * secopts,
+			uint32 i0,
+			uint32 j0,
+			uint32 w,
+			uint32 h,
+			Datum * canv,
+			Datum * distcanv,
+			Datum * percanv,
+			uint32 stride)
+{
+  if (h == 0)
+    return;
+  if (use_subdivide(canvopts, secopts))
+    mandel_subdivide(canvopts, secopts, i0, j0, w, h, canv, percanv, stride);
+  else
+    mandel_region(canvopts, secopts, i0, j0, w, h, canv, distcanv, percanv, stride);
+}
+
+
+/* TileWork for EXECUTE's own scheduling: the canvases share one stride, so
+   each piece is computed in place; mirrored rows are left out */
+static int mandel_tile(void * context,
+		       int worker,
+		       uint32 i0,
+		       uint32 j0,
+		       uint32 w,
+		       uint32 h)
+{
+  TileContext * tc = (TileContext *)context;
+  uint32 a0, a1;
+
+  mirror_rows(&(tc->mirror), i0, j0, w, h, &a0, &a1);
+  mandel_part(tc->canvopts, tc->secopts, i0, j0, w, a0 - j0,
+	      canvas_at(tc->canv, i0, j0),
+	      (tc->distcanv ? canvas_at(tc->distcanv, i0, j0) : NULL),
+	      (tc->percanv ? canvas_at(tc->percanv, i0, j0) : NULL),
+	      tc->canv->stride);
+  mandel_part(tc->canvopts, tc->secopts, i0, a1, w, j0 + h - a1,
+	      canvas_at(tc->canv, i0, a1),
+	      (tc->distcanv ? canvas_at(tc->distcanv, i0, a1) : NULL),
+	      (tc->percanv ? canvas_at(tc->percanv, i0, a1) : NULL),
+	      tc->canv->stride);
   return 0;
 }
 
@@ -69,18 +537,14 @@ int EXECUTE(CanvasOpts * canvopts,
      outfa is the array of file pointers, and outfl the total num. */
   
   /* The data holders used in execute */
-  Datum ** canv = NULL;
-  Datum ** distcanv = NULL;
-  Datum *** canva = NULL;
+  Canvas * canva = NULL;
   uint32 canvl;
   FILE ** outfa = NULL;
   SecondaryOpts secopts;
+  TileContext tc;
   int ret;
 
   /* variables local to execute */
-  float64 x, y, xsq, ysq, x0, y0, left, bottom, width, height;
-  uint32 n, max;
-  uint32 nx, ny;
   int i, j;
 
   /* check for problems in the function call / parameters */
@@ -88,158 +552,179 @@ int EXECUTE(CanvasOpts * canvopts,
   if ( (canvopts==NULL) || (finfunc==NULL) || (validfunc==NULL) || (outfn==NULL) )
     return LIBBADCALL;
 
-  if (canvopts->secondary) {
-    ret = process_sec_opts(canvopts->secondary, canvopts->secondaryl, &secopts);
-    if (ret)
-      return ret;
-  } else {
-    secopts.mult = 0.0;
-    secopts.option = 0;
-  }
+  ret = read_sec_opts(canvopts, &secopts);
+  if (ret)
+    return ret;
+
+  kernel = quadkernel_select();
+  shortcut_count = 0;
+  filled_count = 0;
 
   /* setup memory and organize for validator:
      Secondary options are not required for this lib, but this requires more logic
      whenever dealing with memory on the heap, e.g. canva */
 
-  if (secopts.option == 0)
-    canvl = 1;
-  else
-    canvl = 2;
-
-  canv = malloc(sizeof(Datum *)*canvopts->nwidth);
-  if (canv == NULL)
-    return LIBMALLOC;
-  for (i=0; i<canvopts->nwidth; i++) {
-    canv[i] = malloc(sizeof(Datum)*canvopts->nheight);
-    if (canv[i-1] == NULL) {
-      FREE_DBL_ARRAY(canv,j,i-2);
-      return LIBMALLOC;
-    }
-  }
-
-  if (secopts.option == 1) {
-    distcanv = malloc(sizeof(Datum *)*canvopts->nwidth);
-    if (distcanv == NULL)
-      return LIBMALLOC;
-    for (i=0; i<canvopts->nwidth; i++) {
-      distcanv[i] = malloc(sizeof(Datum)*canvopts->nheight);
-      if (distcanv[i-1] == NULL) {
-	FREE_DBL_ARRAY(distcanv,j,i-2);
-	FREE_DBL_ARRAY(canv,j,canvopts->nwidth);
-	return LIBMALLOC;
-      }
-    }
-  }
+  canvl = count_canvases(canvopts, &secopts);
 
-  canva = malloc(sizeof(Datum **)*canvl);
-  if (canva == NULL) {
-    FREE_DBL_ARRAY(canv,j,canvopts->nwidth);
-    FREE_DBL_ARRAY(distcanv,j,canvopts->nwidth);
+  canva = canvas_alloc_set(canvl, canvopts->nwidth, canvopts->nheight, CANVAS_COLUMNS, CANVAS_FULL);
+  if (canva == NULL)
     return LIBMALLOC;
-  }
-  canva[0] = canv;
-
-  if (secopts.option == 1)
-    canva[1] = distcanv;
 
   outfa = malloc(sizeof(FILE *)*outfl);
   if (outfa == NULL) {
-    FREE_DBL_ARRAY(canv,j,canvopts->nwidth);
-    FREE_DBL_ARRAY(distcanv,j,canvopts->nwidth);
-    free(canva);
+    canvas_free_set(canva, canvl);
     return LIBMALLOC;
   }
   for (i=0; i<outfl; i++) {
-    outfa[i] = fopen(outfn[i], "wb");
+    outfa[i] = output_open(outfn[i]);
     if (!outfa[i-1]) {
       CLOSE_FILE_ARRAY(outfa,j,i-2);
-      FREE_DBL_ARRAY(canv,j,canvopts->nwidth);
-      FREE_DBL_ARRAY(distcanv,j,canvopts->nwidth);
-      free(canva);
+      canvas_free_set(canva, canvl);
       return LIBFILE;
     }
   }
 
   if (validfunc(canva, canvl, outfa, outfl) != 0) {
-    FREE_DBL_ARRAY(canv,j,canvopts->nwidth);
-    FREE_DBL_ARRAY(distcanv,j,canvopts->nwidth);
-    free(canva);
+    canvas_free_set(canva, canvl);
     CLOSE_FILE_ARRAY(outfa,j,outfl);
     return LIBVALIDATE;
   }
 
-  /* need to "palettize" here */
+  ret = prepare_engine(canvopts, &secopts);
+  if (ret == 0)
+    ret = prepare_resume(canvopts, &secopts);
+  if (ret != 0) {
+    perturb_free(&(secopts.ref));
+    canvas_free_set(canva, canvl);
+    CLOSE_FILE_ARRAY(outfa,j,outfl);
+    return ret;
+  }
 
-  left = canvopts->left;
-  nx = canvopts->nwidth;
-  width = canvopts->width;
-  bottom = canvopts->bottom;
-  ny = canvopts->nheight;
-  height = canvopts->height;
-  max = canvopts->escape;
-  
   /* core functionality, execute */
 
-  for (i=0; i<nx; i++) {
-    for (j=0; j<ny; j++) {
-
-      x0 = left + ((float64)i) * width / ((float64)nx);
-      y0 = bottom + ((float64)j) * height / ((float64)ny);
-      
-      if ( x0*x0+y0*y0 > 4. ) {
-	n = 0;
-      } else {
-	
-	x = 0.;
-	y = 0.;
-	n = 0;
-
-	while ( n < max ) {
-	  
-	  xsq = x*x;
-	  ysq = y*y;
-	  if (xsq+ysq <= 4.) {
-	    y = (x+x)*y + y0;
-	    x = xsq - ysq + x0;
-	    n += 1;
-	  }
-	  else
-	    break; 
-	} /* while n < max */
-
-      } /* else */
-      
-      canv[i][j].re = x0;
-      canv[i][j].im = y0;
-      canv[i][j].n = n;
-
-      /* the "distance canvas" computation (currently too brute force to be of value) */
-      if (secopts.option == 1) {
-	if (n == max) {
-	  distcanv[i][j].re = x0;
-	  distcanv[i][j].im = y0;
-	  xsq = x - x0;
-	  ysq = y - y0;
-	  distcanv[i][i].n = (uint32)(sqrt(xsq*xsq+ysq*ysq) / secopts.mult);
-	} else {
-	  //distcanv[i][j].n = (uint32)(sqrt(width*width+height*height) / secopts.mult);
-	  distcanv[i][j].n = 0.0;
-	}
-      }
-
-    } /* for j */
-  } /* for i */
+  tc.canvopts = canvopts;
+  tc.secopts = &secopts;
+  tc.canv = &(canva[0]);
+  tc.distcanv = (secopts.option == 1 ? &(canva[1]) : NULL);
+  tc.percanv = (canvopts->periodicity == PERIOD_CANVAS ? &(canva[canvl-1]) : NULL);
+  prepare_mirror(canvopts, &secopts, &(tc.mirror));
+  ret = schedule_tiles(canvopts->nwidth, canvopts->nheight,
+		       SCHED_TILE_SIZE, SCHED_TILE_SIZE,
+		       schedule_threads(canvopts->threads),
+		       mandel_tile, &tc);
+  perturb_free(&(secopts.ref));
+  report_shortcut(canvopts);
+  report_subdivide(canvopts);
+  report_resume(canvopts);
+  if (ret != 0) {
+    resume_end(&resume, canvopts);
+    canvas_free_set(canva, canvl);
+    CLOSE_FILE_ARRAY(outfa,j,outfl);
+    return LIBTHREAD;
+  }
+  mirror_fill(&(tc.mirror), canva, canvl);
+  resume_mirror(&resume, &(tc.mirror), 1);
+  resume_end(&resume, canvopts);
 
   /* output results */
 
   finfunc(canvopts, canva, canvl, outfa, outfl);
 
-  FREE_DBL_ARRAY(canv,i,canvopts->nwidth);
-  FREE_DBL_ARRAY(distcanv,i,canvopts->nwidth);
-  if (canva)
-    free(canva);
+  canvas_free_set(canva, canvl);
   CLOSE_FILE_ARRAY(outfa,i,outfl);
   
   return 0;
   
 }
+
+
+
+int TILE_SETUP(CanvasOpts * canvopts)
+{
+  int ret;
+
+  if (canvopts==NULL)
+    return LIBBADCALL;
+
+  ret = read_sec_opts(canvopts, &tilesecopts);
+  if (ret)
+    return ret;
+
+  kernel = quadkernel_select();
+  shortcut_count = 0;
+  filled_count = 0;
+
+  ret = prepare_engine(canvopts, &tilesecopts);
+  if (ret)
+    return ret;
+  ret = prepare_resume(canvopts, &tilesecopts);
+  if (ret) {
+    perturb_free(&(tilesecopts.ref));
+    return ret;
+  }
+  /* streamed bands leave before their mirror images are computed */
+  if (canvopts->stream)
+    mirror_none(&tilemirror);
+  else
+    prepare_mirror(canvopts, &tilesecopts, &tilemirror);
+
+  return count_canvases(canvopts, &tilesecopts);
+}
+
+
+
+int TILE_COMPLETE(CanvasOpts * canvopts, Canvas * canva, uint32 canvl)
+{
+  if ( (canvopts==NULL) || (canva==NULL) )
+    return LIBBADCALL;
+
+  mirror_fill(&tilemirror, canva, canvl);
+  resume_mirror(&resume, &tilemirror, 1);
+
+  return 0;
+}
+
+
+
+void TILE_CLEANUP(CanvasOpts * canvopts)
+{
+  perturb_free(&(tilesecopts.ref));
+  report_shortcut(canvopts);
+  report_subdivide(canvopts);
+  report_resume(canvopts);
+  resume_end(&resume, canvopts);
+}
+
+
+
+int EXECUTE_TILE(CanvasOpts * canvopts,
+		 uint32 x0,
+		 uint32 y0,
+		 uint32 w,
+		 uint32 h,
+		 Datum * tile)
+{
+  Datum * distcanv;
+  Datum * percanv;
+  uint32 a0, a1, skip;
+
+  if ( (canvopts==NULL) || (tile==NULL) )
+    return LIBBADCALL;
+
+  distcanv = (tilesecopts.option == 1 ? &(tile[w*h]) : NULL);
+  percanv = (canvopts->periodicity == PERIOD_CANVAS ? &(tile[(count_canvases(canvopts, &tilesecopts)-1)*w*h]) : NULL);
+
+  /* rows [a0,a1) are mirrored by TILE_COMPLETE */
+  mirror_rows(&tilemirror, x0, y0, w, h, &a0, &a1);
+  mandel_part(canvopts, &tilesecopts, x0, y0, w, a0 - y0,
+	      tile, distcanv, percanv, h);
+  skip = a1 - y0;
+  mandel_part(canvopts, &tilesecopts, x0, a1, w, y0 + h - a1,
+	      &(tile[skip]),
+	      (distcanv ? &(distcanv[skip]) : NULL),
+	      (percanv ? &(percanv[skip]) : NULL),
+	      h);
+  mirror_clear(tile, w, h, y0, a0, a1, count_canvases(canvopts, &tilesecopts));
+
+  return 0;
+}
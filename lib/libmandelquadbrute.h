@@ -45,6 +45,7 @@
 #define LIBVALIDATE   -4
 #define LIBBADAUXLEN  -5
 #define LIBBADAUXOPT  -6
+#define LIBTHREAD     -7
 
 
 int EXECUTE(CanvasOpts * canvopts,
@@ -53,6 +54,19 @@ int EXECUTE(CanvasOpts * canvopts,
 	    char ** outfn,
 	    uint32 outfl); 
 
+int TILE_SETUP(CanvasOpts * canvopts);
+
+int EXECUTE_TILE(CanvasOpts * canvopts,
+		 uint32 x0,
+		 uint32 y0,
+		 uint32 w,
+		 uint32 h,
+		 Datum * tile);
+
+int TILE_COMPLETE(CanvasOpts * canvopts, Canvas * canva, uint32 canvl);
+
+void TILE_CLEANUP(CanvasOpts * canvopts);
+
 
 
 #endif /* LIBMANDELQUADBRUTE_H */
@@ -31,19 +31,21 @@
 
 
 void FINISH(CanvasOpts * opts,
-	    Datum *** dataa,
+	    Canvas * dataa,
 	    int datal,
 	    FILE ** filea,
 	    int filel)
 {
 
   int i, j;
-  Datum ** canvas = dataa[0];
+  Datum d;
+  Canvas * canvas = &(dataa[0]);
   FILE * output = filea[0];
   
   for (i=0; i<opts->nwidth; i++) {
     for (j=0; j<opts->nheight; j++) {
-      fprintf(output, "%f %f %d\n", canvas[i][j].re, canvas[i][j].im, canvas[i][j].n);
+      canvas_get(canvas, i, j, &d);
+      fprintf(output, "%f %f %d\n", d.re, d.im, d.n);
     }
   }
 
@@ -51,7 +53,7 @@ void FINISH(CanvasOpts * opts,
 }
 
 
-int VALIDATE(Datum *** dataa,
+int VALIDATE(Canvas * dataa,
 	    int datal,
 	    FILE ** filea,
 	    int filel)
@@ -8,13 +8,13 @@
 
 
 void FINISH(CanvasOpts * opts,
-	    Datum *** dataa,
+	    Canvas * dataa,
 	    int datal,
 	    FILE ** filea,
 	    int filel);
 
 
-int VALIDATE(Datum *** dataa,
+int VALIDATE(Canvas * dataa,
 	    int datal,
 	    FILE ** filea,
 	    int filel);
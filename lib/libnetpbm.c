@@ -0,0 +1,180 @@
+/****************************************************************************/
+/* Libnetpbm.c: printing shared object for the FRASCR application.          */
+/*   Provides a FINISH function and VALIDATE function, and the streaming    */
+/*   FINISH_BEGIN, FINISH_BAND and FINISH_END (see libnetpbm.h).            */
+/*   A header, then the rows top down, each straight from color_row_fill;   */
+/*   for PPM the alpha channel is dropped in place first.                   */
+/*   Last updated: 2024 June                                                */
+/****************************************************************************/
+/*  Author: Miguel Abele                                                    */
+/*  Copyrighted by Miguel Abele, 2024.                                      */
+/*                                                                          */
+/*  License information:                                                    */
+/*                                                                          */
+/*  This file is a part of the FRASCR application.                          */
+/*                                                                          */
+/*  FRASCR is free software; you can redistribute it and/or                 */
+/*  modify it under the terms of the GNU General Public License             */
+/*  as published by the Free Software Foundation; either version 3          */
+/*  of the License, or (at your option) any later version.                  */
+/*                                                                          */
+/*  FRASCR is distributed in the hope that it will be useful,               */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of          */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           */
+/*  GNU General Public License for more details.                            */
+/*                                                                          */
+/*  You should have received a copy of the GNU General Public License       */
+/*  along with this program; if not, write to the Free Software             */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor,                      */
+/*  Boston, MA  02110-1301, USA.                                            */
+/****************************************************************************/
+
+
+#include "libnetpbm.h"
+#include "color.h"
+#include "colorrow.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* one netpbm file being written */
+struct pnm_stream {
+  FILE * output;
+  ColorRow cr;
+  uint8 * row;         /* one row of RGBA pixels */
+};
+typedef struct pnm_stream PnmStream;
+
+static ColorStreams streams;
+
+
+/* Prepare the PnmStream state and write the header. Colors run from 0 to
+   intensitymax. */
+static int pnm_begin(void * state,
+		     CanvasOpts * opts,
+		     FILE * output,
+		     uint32 intensitymax)
+{
+  PnmStream * ps = state;
+  int ret, maxval;
+
+  ps->output = output;
+  ps->row = NULL;
+  ret = color_row_init(&(ps->cr), opts, opts->visuals.depth);
+  if (ret)
+    return ret;
+  color_row_table(&(ps->cr), intensitymax, (uint64)opts->nwidth*opts->nheight);
+  ps->row = malloc(sizeof(uint8)*opts->nwidth*ps->cr.pixelsize);
+  if (ps->row == NULL)
+    return PW_MALLOC;
+
+  maxval = (ps->cr.datasize == sizeof(BaseC8) ? 255 : 65535);
+#ifdef NETPBM_PPM
+  ret = fprintf(output, "P6\n%u %u\n%d\n", opts->nwidth, opts->nheight, maxval);
+#else
+  ret = fprintf(output,
+		"P7\nWIDTH %u\nHEIGHT %u\nDEPTH 4\nMAXVAL %d\nTUPLTYPE RGB_ALPHA\nENDHDR\n",
+		opts->nwidth, opts->nheight, maxval);
+#endif
+  if (ret < 0)
+    return PNM_WRITE;
+  return 0;
+}
+
+
+#ifdef NETPBM_PPM
+/* RGBA to RGB, in place */
+static inline void drop_alpha(uint8 * row, uint32 nx, size_t channel)
+{
+  uint32 i;
+  for (i=0; i<nx; i++)
+    memmove(&(row[3*channel*i]), &(row[4*channel*i]), 3*channel);
+}
+#endif
+
+
+/* rows [0, canvas->ny) of canvas, top down */
+static int pnm_canvas(void * state, const Canvas * canvas)
+{
+  PnmStream * ps = state;
+  uint32 j;
+  size_t rowbytes, channel;
+
+  channel = ps->cr.datasize / 4;
+#ifdef NETPBM_PPM
+  rowbytes = (size_t)canvas->nx*3*channel;
+#else
+  rowbytes = (size_t)canvas->nx*4*channel;
+#endif
+
+  for (j=canvas->ny; j>0; j--) {
+    color_row_fill(ps->row, canvas, j-1, &(ps->cr));
+#ifdef NETPBM_PPM
+    drop_alpha(ps->row, canvas->nx, channel);
+#endif
+    if (fwrite(ps->row, 1, rowbytes, ps->output) != rowbytes)
+      return PNM_WRITE;
+  }
+  return 0;
+}
+
+
+static void pnm_free(void * state)
+{
+  PnmStream * ps = state;
+
+  free(ps->row);
+  ps->row = NULL;
+  color_row_free(&(ps->cr));
+}
+
+
+static const ColorFinisher pnm_finisher = {
+  sizeof(PnmStream), 0, 0, pnm_begin, pnm_canvas, NULL, pnm_free, NULL
+};
+
+
+
+void FINISH(CanvasOpts * opts,
+	    Canvas * dataa,
+	    int datal,
+	    FILE ** filea,
+	    int filel)
+{
+  color_finish(&pnm_finisher, opts, dataa, datal, filea, filel);
+}
+
+
+
+int FINISH_BEGIN(CanvasOpts * opts,
+		 int datal,
+		 FILE ** filea,
+		 int filel)
+{
+  return color_stream_begin(&streams, &pnm_finisher, opts, datal, filea, filel);
+}
+
+
+int FINISH_BAND(CanvasOpts * opts,
+		Canvas * banda,
+		int datal)
+{
+  return color_stream_band(&streams, banda, datal);
+}
+
+
+void FINISH_END(CanvasOpts * opts)
+{
+  color_stream_end(&streams, opts);
+}
+
+
+
+int VALIDATE(Canvas * dataa,
+	    int datal,
+	    FILE ** filea,
+	    int filel)
+{
+  return color_validate(dataa, datal, filea, filel);
+}
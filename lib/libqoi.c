@@ -0,0 +1,280 @@
+/****************************************************************************/
+/* Libqoi.c: printing shared object for the FRASCR application.             */
+/*   Provides a FINISH function and VALIDATE function, and the streaming    */
+/*   FINISH_BEGIN, FINISH_BAND and FINISH_END (see libqoi.h).               */
+/*   The encoder follows the QOI specification (qoiformat.org): each RGBA   */
+/*   pixel becomes a run, an index into the last 64 colors seen, a small    */
+/*   difference from the previous pixel, or the full color. Runs carry over */
+/*   from row to row and band to band.                                      */
+/*   Last updated: 2024 June                                                */
+/****************************************************************************/
+/*  Author: Miguel Abele                                                    */
+/*  Copyrighted by Miguel Abele, 2024.                                      */
+/*                                                                          */
+/*  License information:                                                    */
+/*                                                                          */
+/*  This file is a part of the FRASCR application.                          */
+/*                                                                          */
+/*  FRASCR is free software; you can redistribute it and/or                 */
+/*  modify it under the terms of the GNU General Public License             */
+/*  as published by the Free Software Foundation; either version 3          */
+/*  of the License, or (at your option) any later version.                  */
+/*                                                                          */
+/*  FRASCR is distributed in the hope that it will be useful,               */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of          */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           */
+/*  GNU General Public License for more details.                            */
+/*                                                                          */
+/*  You should have received a copy of the GNU General Public License       */
+/*  along with this program; if not, write to the Free Software             */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor,                      */
+/*  Boston, MA  02110-1301, USA.                                            */
+/****************************************************************************/
+
+
+#include "libqoi.h"
+#include "color.h"
+#include "colorrow.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define QOI_OP_INDEX   0x00
+#define QOI_OP_DIFF    0x40
+#define QOI_OP_LUMA    0x80
+#define QOI_OP_RUN     0xc0
+#define QOI_OP_RGB     0xfe
+#define QOI_OP_RGBA    0xff
+
+#define QOI_HEADER     14
+#define QOI_RUN_MAX    62
+/* bytes one pixel can take */
+#define QOI_PIXEL_MAX  5
+
+
+/* one QOI file being written */
+struct qoi_stream {
+  FILE * output;
+  ColorRow cr;
+  uint8 * row;         /* one row of RGBA pixels */
+  uint8 * out;         /* the encoding of one row */
+  BaseC8 seen[64];     /* colors by hash */
+  BaseC8 prev;
+  int run;
+};
+typedef struct qoi_stream QoiStream;
+
+static ColorStreams streams;
+
+
+static inline void put32(uint8 * p, uint32 v)
+{
+  p[0] = (uint8)(v >> 24);
+  p[1] = (uint8)(v >> 16);
+  p[2] = (uint8)(v >> 8);
+  p[3] = (uint8)v;
+}
+
+
+static inline int qoi_hash(BaseC8 px)
+{
+  return (px.rgba.r*3 + px.rgba.g*5 + px.rgba.b*7 + px.rgba.alpha*11) % 64;
+}
+
+
+/* Prepare the QoiStream state and write the header. Colors run from 0 to intensitymax. */
+static int qoi_begin(void * state,
+		     CanvasOpts * opts,
+		     FILE * output,
+		     uint32 intensitymax)
+{
+  QoiStream * qs = state;
+  uint8 header[QOI_HEADER];
+  int ret;
+
+  qs->output = output;
+  qs->row = NULL;
+  qs->out = NULL;
+  ret = color_row_init(&(qs->cr), opts, 8);
+  if (ret)
+    return ret;
+  color_row_table(&(qs->cr), intensitymax, (uint64)opts->nwidth*opts->nheight);
+  qs->row = malloc(sizeof(uint8)*opts->nwidth*qs->cr.pixelsize);
+  qs->out = malloc(sizeof(uint8)*opts->nwidth*QOI_PIXEL_MAX + 1);
+  if ((qs->row == NULL) || (qs->out == NULL))
+    return PW_MALLOC;
+
+  memset(qs->seen, 0, sizeof(qs->seen));
+  qs->prev.word = 0;
+  qs->prev.rgba.alpha = 0xff;
+  qs->run = 0;
+
+  memcpy(header, "qoif", 4);
+  put32(header + 4, opts->nwidth);
+  put32(header + 8, opts->nheight);
+  header[12] = 4;      /* RGBA */
+  header[13] = 0;      /* sRGB with linear alpha */
+  if (fwrite(header, 1, QOI_HEADER, output) != QOI_HEADER)
+    return QOI_WRITE;
+  return 0;
+}
+
+
+/* encode and write the row of RGBA pixels in qs->row */
+static int qoi_row(QoiStream * qs, uint32 nx)
+{
+  uint32 i;
+  size_t o = 0;
+  int h;
+  signed char vr, vg, vb, vgr, vgb;
+  BaseC8 px;
+  uint8 * out = qs->out;
+
+  for (i=0; i<nx; i++) {
+    memcpy(&px, &(qs->row[sizeof(BaseC8)*i]), sizeof(BaseC8));
+    if (px.word == qs->prev.word) {
+      if (++(qs->run) == QOI_RUN_MAX) {
+	out[o++] = QOI_OP_RUN | (qs->run - 1);
+	qs->run = 0;
+      }
+      continue;
+    }
+    if (qs->run) {
+      out[o++] = QOI_OP_RUN | (qs->run - 1);
+      qs->run = 0;
+    }
+    h = qoi_hash(px);
+    if (qs->seen[h].word == px.word) {
+      out[o++] = QOI_OP_INDEX | h;
+    } else {
+      qs->seen[h] = px;
+      if (px.rgba.alpha == qs->prev.rgba.alpha) {
+	vr = px.rgba.r - qs->prev.rgba.r;
+	vg = px.rgba.g - qs->prev.rgba.g;
+	vb = px.rgba.b - qs->prev.rgba.b;
+	vgr = vr - vg;
+	vgb = vb - vg;
+	if ((vr > -3) && (vr < 2) && (vg > -3) && (vg < 2) && (vb > -3) && (vb < 2)) {
+	  out[o++] = QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2);
+	} else if ((vgr > -9) && (vgr < 8) && (vg > -33) && (vg < 32) && (vgb > -9) && (vgb < 8)) {
+	  out[o++] = QOI_OP_LUMA | (vg + 32);
+	  out[o++] = (vgr + 8) << 4 | (vgb + 8);
+	} else {
+	  out[o++] = QOI_OP_RGB;
+	  out[o++] = px.rgba.r;
+	  out[o++] = px.rgba.g;
+	  out[o++] = px.rgba.b;
+	}
+      } else {
+	out[o++] = QOI_OP_RGBA;
+	out[o++] = px.rgba.r;
+	out[o++] = px.rgba.g;
+	out[o++] = px.rgba.b;
+	out[o++] = px.rgba.alpha;
+      }
+    }
+    qs->prev = px;
+  }
+
+  if (o && (fwrite(out, 1, o, qs->output) != o))
+    return QOI_WRITE;
+  return 0;
+}
+
+
+/* rows [0, canvas->ny) of canvas, top down */
+static int qoi_canvas(void * state, const Canvas * canvas)
+{
+  QoiStream * qs = state;
+  uint32 j;
+  int ret;
+
+  for (j=canvas->ny; j>0; j--) {
+    color_row_fill(qs->row, canvas, j-1, &(qs->cr));
+    if ((ret = qoi_row(qs, canvas->nx)) != 0)
+      return ret;
+  }
+  return 0;
+}
+
+
+/* the last run and the end marker */
+static int qoi_end(void * state, CanvasOpts * opts)
+{
+  QoiStream * qs = state;
+  static const uint8 padding[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+  uint8 op;
+
+  if (qs->run) {
+    op = QOI_OP_RUN | (qs->run - 1);
+    qs->run = 0;
+    if (fwrite(&op, 1, 1, qs->output) != 1)
+      return QOI_WRITE;
+  }
+  if (fwrite(padding, 1, sizeof(padding), qs->output) != sizeof(padding))
+    return QOI_WRITE;
+  return 0;
+}
+
+
+static void qoi_free(void * state)
+{
+  QoiStream * qs = state;
+
+  free(qs->row);
+  free(qs->out);
+  qs->row = NULL;
+  qs->out = NULL;
+  color_row_free(&(qs->cr));
+}
+
+
+static const ColorFinisher qoi_finisher = {
+  sizeof(QoiStream), 0, 0, qoi_begin, qoi_canvas, qoi_end, qoi_free, NULL
+};
+
+
+
+void FINISH(CanvasOpts * opts,
+	    Canvas * dataa,
+	    int datal,
+	    FILE ** filea,
+	    int filel)
+{
+  color_finish(&qoi_finisher, opts, dataa, datal, filea, filel);
+}
+
+
+
+int FINISH_BEGIN(CanvasOpts * opts,
+		 int datal,
+		 FILE ** filea,
+		 int filel)
+{
+  return color_stream_begin(&streams, &qoi_finisher, opts, datal, filea, filel);
+}
+
+
+int FINISH_BAND(CanvasOpts * opts,
+		Canvas * banda,
+		int datal)
+{
+  return color_stream_band(&streams, banda, datal);
+}
+
+
+void FINISH_END(CanvasOpts * opts)
+{
+  color_stream_end(&streams, opts);
+}
+
+
+
+int VALIDATE(Canvas * dataa,
+	    int datal,
+	    FILE ** filea,
+	    int filel)
+{
+  return color_validate(dataa, datal, filea, filel);
+}
@@ -0,0 +1,76 @@
+/****************************************************************************/
+/* Libqoi.h: printing shared object for the FRASCR application.             */
+/*   Provides a FINISH function and VALIDATE function, and FINISH_BEGIN,    */
+/*   FINISH_BAND and FINISH_END to write the rows as the bands of a         */
+/*   streamed canvas arrive (see engine.h).                                 */
+/*   FINISH outputs QOI ("Quite OK Image") files, colored as libcolorpng    */
+/*   colors its pngs (colorrow.h) but always 8 bits per channel. QOI takes  */
+/*   one pass over the pixels and no deflate, so it is a quick output for   */
+/*   large images and frames that will be converted later.                  */
+/*   Last updated: 2024 June                                                */
+/****************************************************************************/
+/*  Author: Miguel Abele                                                    */
+/*  Copyrighted by Miguel Abele, 2024.                                      */
+/*                                                                          */
+/*  License information:                                                    */
+/*                                                                          */
+/*  This file is a part of the FRASCR application.                          */
+/*                                                                          */
+/*  FRASCR is free software; you can redistribute it and/or                 */
+/*  modify it under the terms of the GNU General Public License             */
+/*  as published by the Free Software Foundation; either version 3          */
+/*  of the License, or (at your option) any later version.                  */
+/*                                                                          */
+/*  FRASCR is distributed in the hope that it will be useful,               */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of          */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           */
+/*  GNU General Public License for more details.                            */
+/*                                                                          */
+/*  You should have received a copy of the GNU General Public License       */
+/*  along with this program; if not, write to the Free Software             */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor,                      */
+/*  Boston, MA  02110-1301, USA.                                            */
+/****************************************************************************/
+
+
+#ifndef LIBQOI_H
+#define LIBQOI_H
+
+
+#include "options.h"
+#include "utils.h"
+#include <stdio.h>
+
+
+#define QOI_WRITE      -80
+
+
+void FINISH(CanvasOpts * opts,
+	    Canvas * dataa,
+	    int datal,
+	    FILE ** filea,
+	    int filel);
+
+
+int FINISH_BEGIN(CanvasOpts * opts,
+		 int datal,
+		 FILE ** filea,
+		 int filel);
+
+
+int FINISH_BAND(CanvasOpts * opts,
+		Canvas * banda,
+		int datal);
+
+
+void FINISH_END(CanvasOpts * opts);
+
+
+int VALIDATE(Canvas * dataa,
+	    int datal,
+	    FILE ** filea,
+	    int filel);
+
+
+
+#endif /* LIBQOI_H */
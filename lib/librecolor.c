@@ -0,0 +1,137 @@
+/****************************************************************************/
+/* Librecolor.c: shared object for the FRASCR application                   */
+/*   EXECUTE maps the dump read-only and points compact canvases into the   */
+/*   mapping (frd_canvas), so the finisher reads the counts straight from   */
+/*   the page cache. See librecolor.h.                                      */
+/*   Last updated: 2024 June                                                */
+/****************************************************************************/
+/*  Author: Miguel Abele                                                    */
+/*  Copyrighted by Miguel Abele, 2024.                                      */
+/*                                                                          */
+/*  License information:                                                    */
+/*                                                                          */
+/*  This file is a part of the FRASCR application.                          */
+/*                                                                          */
+/*  FRASCR is free software; you can redistribute it and/or                 */
+/*  modify it under the terms of the GNU General Public License             */
+/*  as published by the Free Software Foundation; either version 3          */
+/*  of the License, or (at your option) any later version.                  */
+/*                                                                          */
+/*  FRASCR is distributed in the hope that it will be useful,               */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of          */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           */
+/*  GNU General Public License for more details.                            */
+/*                                                                          */
+/*  You should have received a copy of the GNU General Public License       */
+/*  along with this program; if not, write to the Free Software             */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor,                      */
+/*  Boston, MA  02110-1301, USA.                                            */
+/****************************************************************************/
+
+
+#include "librecolor.h"
+#include "frd.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+#define CLOSE_FILE_ARRAY(arr,l,m) { if ((arr)) { for (l=0; l<m; l++) { if ((arr)[l]) output_close((arr)[l]); } free((arr)); (arr)=NULL; } }
+
+
+int EXECUTE(CanvasOpts * canvopts,
+	    void (*finfunc)(),
+	    int (*validfunc)(),
+	    char ** outfn,
+	    uint32 outfl)
+{
+  Canvas * canva = NULL;
+  uint32 canvl;
+  FILE ** outfa = NULL;
+  int i, j, fd;
+  struct stat st;
+  void * base;
+  FrdHeader fh;
+  int ret = 0;
+
+  if ( (canvopts==NULL) || (finfunc==NULL) || (validfunc==NULL) || (outfn==NULL) )
+    return LIBBADCALL;
+  if ((canvopts->secondary == NULL) || (canvopts->secondaryl < 1))
+    return LIBBADAUXLEN;
+
+  /* map the dump */
+
+  fd = open(canvopts->secondary[0], O_RDONLY);
+  if (fd < 0)
+    return LIBFILE;
+  if (fstat(fd, &st) || (st.st_size < (off_t)sizeof(FrdHeader))) {
+    close(fd);
+    return LIBBADDUMP;
+  }
+  base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED)
+    return LIBFILE;
+  memcpy(&fh, base, sizeof(FrdHeader));
+  if (frd_check(&fh, st.st_size)) {
+    munmap(base, st.st_size);
+    return LIBBADDUMP;
+  }
+  madvise(base, st.st_size, MADV_SEQUENTIAL);
+  fh.algorithm[FRD_NAME-1] = '\0';
+  if (canvopts->debug)
+    DEBUG(canvopts->debug, D1, "librecolor: %u canvases %u x %u, escape %u, from %s\n",
+	  fh.canvl, fh.nx, fh.ny, fh.escape, fh.algorithm[0] ? fh.algorithm : "(unknown)");
+
+  /* the view of the dump */
+
+  canvopts->nwidth = fh.nx;
+  canvopts->nheight = fh.ny;
+  canvopts->left = fh.left;
+  canvopts->bottom = fh.bottom;
+  canvopts->width = fh.width;
+  canvopts->height = fh.height;
+  canvopts->coord_Re = fh.coord_Re;
+  canvopts->coord_Im = fh.coord_Im;
+  canvopts->escape = fh.escape;
+
+  canvl = fh.canvl;
+  canva = calloc(canvl, sizeof(Canvas));
+  if (canva == NULL) {
+    munmap(base, st.st_size);
+    return LIBMALLOC;
+  }
+  for (i=0; i<canvl; i++)
+    frd_canvas(&fh, base, i, &(canva[i]));
+
+  outfa = calloc(outfl, sizeof(FILE *));
+  if (outfa == NULL) {
+    free(canva);
+    munmap(base, st.st_size);
+    return LIBMALLOC;
+  }
+  for (i=0; i<outfl; i++) {
+    outfa[i] = output_open(outfn[i]);
+    if (!outfa[i]) {
+      CLOSE_FILE_ARRAY(outfa,j,i);
+      free(canva);
+      munmap(base, st.st_size);
+      return LIBFILE;
+    }
+  }
+
+  if (validfunc(canva, canvl, outfa, outfl) != 0) {
+    ret = LIBVALIDATE;
+  } else {
+    finfunc(canvopts, canva, canvl, outfa, outfl);
+  }
+
+  CLOSE_FILE_ARRAY(outfa,i,outfl);
+  free(canva);
+  munmap(base, st.st_size);
+
+  return ret;
+}
@@ -0,0 +1,61 @@
+/****************************************************************************/
+/* Librecolor.h: shared object for the FRASCR application                   */
+/*   Provides an EXECUTE function that computes nothing: it maps the .frd   */
+/*   dump (frd.h) named by the first secondary option and hands the         */
+/*   canvases in it, without copying them, to the finisher and validator    */
+/*   it is given. The shape, domain, escape limit and constants of the      */
+/*   canvas options are replaced by those of the dump, so that only the     */
+/*   visualization options and the outputs come from the configuration.     */
+/*   E.g. a long render dumped through libfrd.so can be colored again in    */
+/*   the time it takes to write the image.                                  */
+/*   Last updated: 2024 June                                                */
+/****************************************************************************/
+/*  Author: Miguel Abele                                                    */
+/*  Copyrighted by Miguel Abele, 2024.                                      */
+/*                                                                          */
+/*  License information:                                                    */
+/*                                                                          */
+/*  This file is a part of the FRASCR application.                          */
+/*                                                                          */
+/*  FRASCR is free software; you can redistribute it and/or                 */
+/*  modify it under the terms of the GNU General Public License             */
+/*  as published by the Free Software Foundation; either version 3          */
+/*  of the License, or (at your option) any later version.                  */
+/*                                                                          */
+/*  FRASCR is distributed in the hope that it will be useful,               */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of          */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           */
+/*  GNU General Public License for more details.                            */
+/*                                                                          */
+/*  You should have received a copy of the GNU General Public License       */
+/*  along with this program; if not, write to the Free Software             */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor,                      */
+/*  Boston, MA  02110-1301, USA.                                            */
+/****************************************************************************/
+
+
+#ifndef LIBRECOLOR_H
+#define LIBRECOLOR_H
+
+
+#include "utils.h"
+#include "options.h"
+
+
+#define LIBBADCALL    -1
+#define LIBMALLOC     -2
+#define LIBFILE       -3
+#define LIBVALIDATE   -4
+#define LIBBADAUXLEN  -5
+#define LIBBADDUMP    -6
+
+
+int EXECUTE(CanvasOpts * canvopts,
+	    void (*finfunc)(),
+	    int (*validfunc)(),
+	    char ** outfn,
+	    uint32 outfl);
+
+
+
+#endif /* LIBRECOLOR_H */
@@ -0,0 +1,250 @@
+/****************************************************************************/
+/* Liby4m.c: video shared object for the FRASCR application.                */
+/*   A frame is colored row by row into the three planes it needs in        */
+/*   memory, Y then Cb then Cr, since a YUV4MPEG2 frame holds them whole    */
+/*   one after the other; bands of a streamed canvas fill the planes as     */
+/*   they arrive, and the frame is written at FINISH_END.                   */
+/*   Last updated: 2024 June                                                */
+/****************************************************************************/
+/*  Author: Miguel Abele                                                    */
+/*  Copyrighted by Miguel Abele, 2024.                                      */
+/*                                                                          */
+/*  License information:                                                    */
+/*                                                                          */
+/*  This file is a part of the FRASCR application.                          */
+/*                                                                          */
+/*  FRASCR is free software; you can redistribute it and/or                 */
+/*  modify it under the terms of the GNU General Public License             */
+/*  as published by the Free Software Foundation; either version 3          */
+/*  of the License, or (at your option) any later version.                  */
+/*                                                                          */
+/*  FRASCR is distributed in the hope that it will be useful,               */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of          */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           */
+/*  GNU General Public License for more details.                            */
+/*                                                                          */
+/*  You should have received a copy of the GNU General Public License       */
+/*  along with this program; if not, write to the Free Software             */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor,                      */
+/*  Boston, MA  02110-1301, USA.                                            */
+/****************************************************************************/
+
+
+#include "liby4m.h"
+#include "color.h"
+#include "colorrow.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* one frame being made */
+struct y4m_frame {
+  FILE * output;
+  ColorRow cr;
+  uint8 * row;         /* one row of RGBA pixels */
+  uint8 * planes;      /* Y, Cb and Cr, each nx*ny samples, top row first */
+  uint32 nx, ny;
+  size_t sample;       /* bytes per sample, 1 or 2 */
+};
+typedef struct y4m_frame Y4mFrame;
+
+static ColorStreams streams;
+
+/* a pipe cannot say where in it we are, so the one given a header is kept */
+static FILE * piped = NULL;
+
+
+
+/* The stream header, if output is at its start. Returns 0 or Y4M_WRITE. */
+static int y4m_header(Y4mFrame * yf, CanvasOpts * opts)
+{
+  long at = ftell(yf->output);
+
+  if ((at > 0) || ((at < 0) && (yf->output == piped)))
+    return 0;
+  if (at < 0)
+    piped = yf->output;
+  if (fprintf(yf->output, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 %s XCOLORRANGE=LIMITED\n",
+	      yf->nx, yf->ny, opts->visuals.framerate,
+	      (yf->sample == 1 ? "C444" : "C444p16")) < 0)
+    return Y4M_WRITE;
+  return 0;
+}
+
+
+/* Colors run from 0 to intensitymax, the escape limit for every frame */
+static int y4m_begin(void * state, CanvasOpts * opts, FILE * output, uint32 intensitymax)
+{
+  Y4mFrame * yf = state;
+  int ret;
+
+  yf->output = output;
+  yf->row = NULL;
+  yf->planes = NULL;
+  yf->nx = opts->nwidth;
+  yf->ny = opts->nheight;
+  ret = color_row_init(&(yf->cr), opts, opts->visuals.depth);
+  if (ret)
+    return ret;
+  color_row_table(&(yf->cr), intensitymax, (uint64)yf->nx*yf->ny);
+  yf->sample = yf->cr.datasize / 4;
+  yf->row = malloc(sizeof(uint8)*yf->nx*yf->cr.pixelsize);
+  yf->planes = malloc(3*yf->sample*(size_t)yf->nx*yf->ny);
+  if ((yf->row == NULL) || (yf->planes == NULL))
+    return PW_MALLOC;
+  return 0;
+}
+
+
+/* BT.601 in studio range, in integers: the color is laid on black by its
+   alpha, then Y = 16 + (66R + 129G + 25B)/256 and likewise Cb and Cr about
+   128. The offsets go in before the shift, so that no sum is negative. */
+static void rgba8_to_ycbcr(const uint8 * rgba, uint8 * y, uint8 * cb, uint8 * cr, uint32 nx)
+{
+  uint32 i, a;
+  int r, g, b;
+
+  for (i=0; i<nx; i++, rgba+=4) {
+    a = rgba[3];
+    r = (rgba[0]*a + 127) / 255;
+    g = (rgba[1]*a + 127) / 255;
+    b = (rgba[2]*a + 127) / 255;
+    y[i] = (66*r + 129*g + 25*b + (16<<8) + 128) >> 8;
+    cb[i] = (-38*r - 74*g + 112*b + (128<<8) + 128) >> 8;
+    cr[i] = (112*r - 94*g - 18*b + (128<<8) + 128) >> 8;
+  }
+}
+
+
+/* likewise from 16 bit big-endian channels to 16 bit little-endian samples */
+static void rgba16_to_ycbcr(const uint8 * rgba, uint8 * y, uint8 * cb, uint8 * cr, uint32 nx)
+{
+  uint32 i, a;
+  int r, g, b, v;
+
+  for (i=0; i<nx; i++, rgba+=8) {
+    a = (rgba[6] << 8) | rgba[7];
+    r = (((rgba[0] << 8) | rgba[1])*a + 32767) / 65535;
+    g = (((rgba[2] << 8) | rgba[3])*a + 32767) / 65535;
+    b = (((rgba[4] << 8) | rgba[5])*a + 32767) / 65535;
+    v = (66*r + 129*g + 25*b + (16<<16) + 128) >> 8;
+    y[2*i] = v & 0xff;
+    y[2*i+1] = v >> 8;
+    v = (-38*r - 74*g + 112*b + (128<<16) + 128) >> 8;
+    cb[2*i] = v & 0xff;
+    cb[2*i+1] = v >> 8;
+    v = (112*r - 94*g - 18*b + (128<<16) + 128) >> 8;
+    cr[2*i] = v & 0xff;
+    cr[2*i+1] = v >> 8;
+  }
+}
+
+
+/* the rows of canvas, a band of the view or all of it, into the planes */
+static int y4m_canvas(void * state, const Canvas * canvas)
+{
+  Y4mFrame * yf = state;
+  size_t plane = yf->sample*(size_t)yf->nx*yf->ny;
+  size_t line = yf->sample*(size_t)yf->nx;
+  uint8 * y;
+  uint32 j;
+
+  for (j=0; j<canvas->ny; j++) {
+    color_row_fill(yf->row, canvas, j, &(yf->cr));
+    /* row j of the band is row vny-1-(j0+j) of the image, counted down */
+    y = yf->planes + (size_t)(canvas->vny - 1 - (canvas->j0 + j))*line;
+    if (yf->sample == 1)
+      rgba8_to_ycbcr(yf->row, y, y + plane, y + 2*plane, canvas->nx);
+    else
+      rgba16_to_ycbcr(yf->row, y, y + plane, y + 2*plane, canvas->nx);
+  }
+  return 0;
+}
+
+
+static int y4m_write(void * state, CanvasOpts * opts)
+{
+  Y4mFrame * yf = state;
+  size_t size = 3*yf->sample*(size_t)yf->nx*yf->ny;
+  int ret;
+
+  ret = y4m_header(yf, opts);
+  if (ret)
+    return ret;
+  if ((fputs("FRAME\n", yf->output) < 0)
+      || (fwrite(yf->planes, 1, size, yf->output) != size))
+    return Y4M_WRITE;
+  return 0;
+}
+
+
+static void y4m_free(void * state)
+{
+  Y4mFrame * yf = state;
+
+  free(yf->row);
+  free(yf->planes);
+  yf->row = NULL;
+  yf->planes = NULL;
+  color_row_free(&(yf->cr));
+}
+
+
+static void y4m_report(void * state, CanvasOpts * opts, int rno, int ret)
+{
+  if (opts->debug)
+    DEBUG(opts->debug, D0, "liby4m: could not write frame of canvas %d\n", rno);
+}
+
+
+static const ColorFinisher y4m_finisher = {
+  sizeof(Y4mFrame), 0, 1, y4m_begin, y4m_canvas, y4m_write, y4m_free, y4m_report
+};
+
+
+
+void FINISH(CanvasOpts * opts,
+	    Canvas * dataa,
+	    int datal,
+	    FILE ** filea,
+	    int filel)
+{
+  color_finish(&y4m_finisher, opts, dataa, datal, filea, filel);
+}
+
+
+
+/* the planes of a frame are filled band by band and written at the end */
+int FINISH_BEGIN(CanvasOpts * opts,
+		 int datal,
+		 FILE ** filea,
+		 int filel)
+{
+  return color_stream_begin(&streams, &y4m_finisher, opts, datal, filea, filel);
+}
+
+
+int FINISH_BAND(CanvasOpts * opts,
+		Canvas * banda,
+		int datal)
+{
+  return color_stream_band(&streams, banda, datal);
+}
+
+
+void FINISH_END(CanvasOpts * opts)
+{
+  color_stream_end(&streams, opts);
+}
+
+
+
+/* a pipe is a fine output: nothing here seeks */
+int VALIDATE(Canvas * dataa,
+	    int datal,
+	    FILE ** filea,
+	    int filel)
+{
+  return color_validate(dataa, datal, filea, filel);
+}
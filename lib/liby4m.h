@@ -0,0 +1,80 @@
+/****************************************************************************/
+/* Liby4m.h: video shared object for the FRASCR application.                */
+/*   Provides a FINISH function and VALIDATE function, and FINISH_BEGIN,    */
+/*   FINISH_BAND and FINISH_END for streamed canvases (see engine.h).       */
+/*   FINISH writes a canvas as one frame of a YUV4MPEG2 stream, colored as  */
+/*   libcolorpng colors its pngs (colorrow.h) and turned into 4:4:4 YCbCr   */
+/*   (BT.601, studio range), 8 bits per sample, or 16 with a channel        */
+/*   depth of 16. The stream header (visualization option "framerate")      */
+/*   goes at the start of a file, so with an output of "-" every frame of   */
+/*   an animation runs down one pipe, e.g.                                  */
+/*     frascr -f aconf.txt | ffmpeg -i - out.mp4                            */
+/*   Colors are scaled by the escape limit rather than each frame's         */
+/*   largest count, so that they do not flicker from frame to frame.        */
+/*   Last updated: 2024 June                                                */
+/****************************************************************************/
+/*  Author: Miguel Abele                                                    */
+/*  Copyrighted by Miguel Abele, 2024.                                      */
+/*                                                                          */
+/*  License information:                                                    */
+/*                                                                          */
+/*  This file is a part of the FRASCR application.                          */
+/*                                                                          */
+/*  FRASCR is free software; you can redistribute it and/or                 */
+/*  modify it under the terms of the GNU General Public License             */
+/*  as published by the Free Software Foundation; either version 3          */
+/*  of the License, or (at your option) any later version.                  */
+/*                                                                          */
+/*  FRASCR is distributed in the hope that it will be useful,               */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of          */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           */
+/*  GNU General Public License for more details.                            */
+/*                                                                          */
+/*  You should have received a copy of the GNU General Public License       */
+/*  along with this program; if not, write to the Free Software             */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor,                      */
+/*  Boston, MA  02110-1301, USA.                                            */
+/****************************************************************************/
+
+
+#ifndef LIBY4M_H
+#define LIBY4M_H
+
+
+#include "options.h"
+#include "utils.h"
+#include <stdio.h>
+
+
+#define Y4M_WRITE      -82
+
+
+void FINISH(CanvasOpts * opts,
+	    Canvas * dataa,
+	    int datal,
+	    FILE ** filea,
+	    int filel);
+
+
+int FINISH_BEGIN(CanvasOpts * opts,
+		 int datal,
+		 FILE ** filea,
+		 int filel);
+
+
+int FINISH_BAND(CanvasOpts * opts,
+		Canvas * banda,
+		int datal);
+
+
+void FINISH_END(CanvasOpts * opts);
+
+
+int VALIDATE(Canvas * dataa,
+	    int datal,
+	    FILE ** filea,
+	    int filel);
+
+
+
+#endif /* LIBY4M_H */
@@ -0,0 +1,101 @@
+/****************************************************************************/
+/* periodicity.h: orbit cycle detection for FRASCR libraries                */
+/*   Brent's method: the orbit is compared at every step against a saved    */
+/*   point, which is moved forward to the current point after 1, 2, 4, 8,   */
+/*   ... steps. An orbit drawn into an attracting cycle of period p comes   */
+/*   back within the tolerance of the saved point once the saving interval  */
+/*   reaches p, and the point can be marked as interior right away instead  */
+/*   of running to the escape limit. The tolerance is a fraction of the     */
+/*   pixel spacing, so detection stays below what the canvas can resolve.   */
+/*   Header only: the check sits in the innermost loop of every library.    */
+/*   Last updated: 2024 May                                                 */
+/****************************************************************************/
+/*  Author: Miguel Abele                                                    */
+/*  Copyrighted by Miguel Abele, 2024.                                      */
+/*                                                                          */
+/*  License information:                                                    */
+/*                                                                          */
+/*  This file is a part of the FRASCR application.                          */
+/*                                                                          */
+/*  FRASCR is free software; you can redistribute it and/or                 */
+/*  modify it under the terms of the GNU General Public License             */
+/*  as published by the Free Software Foundation; either version 3          */
+/*  of the License, or (at your option) any later version.                  */
+/*                                                                          */
+/*  FRASCR is distributed in the hope that it will be useful,               */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of          */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           */
+/*  GNU General Public License for more details.                            */
+/*                                                                          */
+/*  You should have received a copy of the GNU General Public License       */
+/*  along with this program; if not, write to the Free Software             */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor,                      */
+/*  Boston, MA  02110-1301, USA.                                            */
+/****************************************************************************/
+
+
+#ifndef PERIODICITY_H
+#define PERIODICITY_H
+
+
+#include "utils.h"
+
+
+/* tolerance, as a fraction of the pixel spacing */
+#define PERIOD_TOL    1.0e-3
+
+/* canvas option "periodicity" */
+#define PERIOD_OFF    0
+#define PERIOD_ON     1
+#define PERIOD_CANVAS 2
+
+
+struct period_check {
+  float64 sx, sy;      /* saved point */
+  float64 tolsq;
+  uint32 steps;        /* steps since the point was saved */
+  uint32 limit;        /* steps before the point is saved again */
+};
+typedef struct period_check PeriodCheck;
+
+
+/* squared tolerance for a canvas with the given pixel spacing, or 0 when
+   detection is off */
+static inline float64 period_tolerance(int periodicity, float64 spacing)
+{
+  float64 tol = PERIOD_TOL * spacing;
+  return (periodicity == PERIOD_OFF ? 0. : tol*tol);
+}
+
+
+static inline void period_start(PeriodCheck * pc, float64 x, float64 y, float64 tolsq)
+{
+  pc->sx = x;
+  pc->sy = y;
+  pc->tolsq = tolsq;
+  pc->steps = 0;
+  pc->limit = 1;
+}
+
+
+/* Call after every step with the new point; returns the period once the
+   orbit has closed on itself, else 0 */
+static inline uint32 period_step(PeriodCheck * pc, float64 x, float64 y)
+{
+  float64 dx = x - pc->sx;
+  float64 dy = y - pc->sy;
+
+  pc->steps += 1;
+  if (dx*dx + dy*dy <= pc->tolsq)
+    return pc->steps;
+  if (pc->steps == pc->limit) {
+    pc->sx = x;
+    pc->sy = y;
+    pc->steps = 0;
+    pc->limit += pc->limit;
+  }
+  return 0;
+}
+
+
+#endif /* PERIODICITY_H */
@@ -0,0 +1,283 @@
+/****************************************************************************/
+/* perturbation.c: perturbation iteration of z^2 + c, for FRASCR libraries  */
+/*   Rebasing follows Zhuoran's method: rather than detecting glitched      */
+/*   pixels afterwards and recomputing them from new references, a pixel    */
+/*   whose |z| drops below |dz| continues with dz = z against Z_0 = 0, so   */
+/*   a single reference serves the whole view.                              */
+/*   The series coefficients are kept scaled by powers of the view radius,  */
+/*   so that they stay near the size of dz itself instead of overflowing    */
+/*   float64 at deep zooms.                                                 */
+/*   Last updated: 2024 May                                                 */
+/****************************************************************************/
+/*  Author: Miguel Abele                                                    */
+/*  Copyrighted by Miguel Abele, 2024.                                      */
+/*                                                                          */
+/*  License information:                                                    */
+/*                                                                          */
+/*  This file is a part of the FRASCR application.                          */
+/*                                                                          */
+/*  FRASCR is free software; you can redistribute it and/or                 */
+/*  modify it under the terms of the GNU General Public License             */
+/*  as published by the Free Software Foundation; either version 3          */
+/*  of the License, or (at your option) any later version.                  */
+/*                                                                          */
+/*  FRASCR is distributed in the hope that it will be useful,               */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of          */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           */
+/*  GNU General Public License for more details.                            */
+/*                                                                          */
+/*  You should have received a copy of the GNU General Public License       */
+/*  along with this program; if not, write to the Free Software             */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor,                      */
+/*  Boston, MA  02110-1301, USA.                                            */
+/****************************************************************************/
+
+
+#include "perturbation.h"
+#include "fixedpoint.h"
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+
+
+
+int perturb_reference(RefOrbit * ref,
+		      const char * cre,
+		      const char * cim,
+		      float64 spacing,
+		      uint32 max)
+{
+  Fixed x, y, x0, y0, xsq, ysq, xy;
+  float64 dx, dy;
+  int limbs;
+  uint32 k;
+
+  if ((ref==NULL) || (cre==NULL) || (cim==NULL))
+    return PT_BAD_CALL;
+
+  ref->zre = NULL;
+  ref->zim = NULL;
+  ref->len = 0;
+  ref->skip = 0;
+
+  limbs = fp_limbs(spacing);
+  if ((fp_from_string(&x0, cre, limbs) != 0) || (fp_from_string(&y0, cim, limbs) != 0))
+    return PT_BADNUM;
+  ref->limbs = limbs;
+  ref->cre = fp_to_double(&x0, limbs);
+  ref->cim = fp_to_double(&y0, limbs);
+
+  ref->zre = malloc(sizeof(float64)*((size_t)max+1));
+  ref->zim = malloc(sizeof(float64)*((size_t)max+1));
+  if ((ref->zre==NULL) || (ref->zim==NULL)) {
+    perturb_free(ref);
+    return PT_MALLOC;
+  }
+
+  memset(&x, 0, sizeof(Fixed));
+  memset(&y, 0, sizeof(Fixed));
+
+  /* keep the escaping point too: pixels near it may still be bounded */
+  for (k=0; k<=max; k++) {
+    dx = fp_to_double(&x, limbs);
+    dy = fp_to_double(&y, limbs);
+    ref->zre[k] = dx;
+    ref->zim[k] = dy;
+    ref->len = k+1;
+    if (dx*dx + dy*dy > 4.)
+      break;
+    fp_mul(&xsq, &x, &x, limbs);
+    fp_mul(&ysq, &y, &y, limbs);
+    fp_mul(&xy, &x, &y, limbs);
+    fp_sub(&x, &xsq, &ysq, limbs);
+    fp_add(&x, &x, &x0, limbs);
+    fp_add(&y, &xy, &xy, limbs);
+    fp_add(&y, &y, &y0, limbs);
+  }
+
+  return 0;
+}
+
+
+
+uint32 perturb_series(RefOrbit * ref,
+		      float64 halfw,
+		      float64 halfh,
+		      uint32 max)
+{
+  /* probes: corners and edge midpoints of the view */
+  const float64 px[8] = { -1., 1., -1., 1., 0., 0., -1., 1. };
+  const float64 py[8] = { -1., -1., 1., 1., -1., 1., 0., 0. };
+  float64 are[PT_TERMS], aim[PT_TERMS], bre[PT_TERMS], bim[PT_TERMS];
+  float64 dxp[8], dyp[8], ure[8], uim[8];
+  float64 zx, zy, tx, ty, t, sre, sim, ere, eim;
+  float64 x, y, zsq, dsq;
+  uint32 n;
+  int k, i, p, ok;
+
+  if ((ref==NULL) || (ref->len < 2))
+    return 0;
+
+  ref->skip = 0;
+  ref->radius = sqrt(halfw*halfw + halfh*halfh);
+  if (!(ref->radius > 0.))
+    return 0;
+
+  for (k=0; k<PT_TERMS; k++) {
+    are[k] = 0.;
+    aim[k] = 0.;
+  }
+  for (p=0; p<8; p++) {
+    dxp[p] = 0.;
+    dyp[p] = 0.;
+    ure[p] = px[p]*halfw / ref->radius;
+    uim[p] = py[p]*halfh / ref->radius;
+  }
+
+  for (n=0; (n+1 < ref->len) && (n < max); n++) {
+
+    zx = ref->zre[n] + ref->zre[n];
+    zy = ref->zim[n] + ref->zim[n];
+
+    /* next coefficients: A_k -> 2Z A_k + sum A_i A_(k-i), plus dc in A_1 */
+    for (k=0; k<PT_TERMS; k++) {
+      bre[k] = zx*are[k] - zy*aim[k];
+      bim[k] = zx*aim[k] + zy*are[k];
+      for (i=0; i<k; i++) {
+	bre[k] += are[i]*are[k-1-i] - aim[i]*aim[k-1-i];
+	bim[k] += are[i]*aim[k-1-i] + aim[i]*are[k-1-i];
+      }
+    }
+    bre[0] += ref->radius;
+
+    /* iterate the probes in full and compare with the series */
+    ok = 1;
+    for (p=0; (p<8) && ok; p++) {
+      tx = zx + dxp[p];
+      ty = zy + dyp[p];
+      t = tx*dxp[p] - ty*dyp[p] + ure[p]*ref->radius;
+      dyp[p] = tx*dyp[p] + ty*dxp[p] + uim[p]*ref->radius;
+      dxp[p] = t;
+
+      x = ref->zre[n+1] + dxp[p];
+      y = ref->zim[n+1] + dyp[p];
+      zsq = x*x + y*y;
+      dsq = dxp[p]*dxp[p] + dyp[p]*dyp[p];
+      /* an escape or a rebase ends the part all pixels have in common */
+      if ((zsq > 4.) || (zsq < dsq)) {
+	ok = 0;
+	break;
+      }
+
+      sre = bre[PT_TERMS-1];
+      sim = bim[PT_TERMS-1];
+      for (k=PT_TERMS-2; k>=0; k--) {
+	t = sre*ure[p] - sim*uim[p] + bre[k];
+	sim = sre*uim[p] + sim*ure[p] + bim[k];
+	sre = t;
+      }
+      t = sre*ure[p] - sim*uim[p];
+      sim = sre*uim[p] + sim*ure[p];
+      sre = t;
+
+      ere = sre - dxp[p];
+      eim = sim - dyp[p];
+      if (!(ere*ere + eim*eim <= PT_SERIES_TOL*PT_SERIES_TOL*dsq))
+	ok = 0;
+    }
+    if (!ok)
+      break;
+
+    for (k=0; k<PT_TERMS; k++) {
+      are[k] = bre[k];
+      aim[k] = bim[k];
+    }
+  }
+
+  ref->skip = n;
+  for (k=0; k<PT_TERMS; k++) {
+    ref->are[k] = are[k];
+    ref->aim[k] = aim[k];
+  }
+  return n;
+}
+
+
+
+void perturb_free(RefOrbit * ref)
+{
+  if (ref==NULL)
+    return;
+  free(ref->zre);
+  free(ref->zim);
+  ref->zre = NULL;
+  ref->zim = NULL;
+  ref->len = 0;
+}
+
+
+
+uint32 perturb_point(const RefOrbit * ref,
+		     float64 dcre,
+		     float64 dcim,
+		     uint32 max,
+		     float64 * zre,
+		     float64 * zim)
+{
+  float64 x, y, zsq, dx, dy, tx, ty, t;
+  uint32 n, m, last;
+
+  dx = 0.;
+  dy = 0.;
+  m = 0;
+  n = 0;
+  last = ref->len - 1;
+
+  /* start from the series: dz = sum A_k u^k, u = dc / radius */
+  if (ref->skip > 0) {
+    float64 ure = dcre / ref->radius;
+    float64 uim = dcim / ref->radius;
+    int k;
+    dx = ref->are[PT_TERMS-1];
+    dy = ref->aim[PT_TERMS-1];
+    for (k=PT_TERMS-2; k>=0; k--) {
+      t = dx*ure - dy*uim + ref->are[k];
+      dy = dx*uim + dy*ure + ref->aim[k];
+      dx = t;
+    }
+    t = dx*ure - dy*uim;
+    dy = dx*uim + dy*ure;
+    dx = t;
+    m = ref->skip;
+    n = ref->skip;
+  }
+
+  while ( n < max ) {
+
+    x = ref->zre[m] + dx;
+    y = ref->zim[m] + dy;
+    zsq = x*x + y*y;
+    if (zsq > 4.)
+      break;
+
+    /* rebase when z is nearer 0 than the reference, or at its end */
+    if ((zsq < dx*dx + dy*dy) || (m == last)) {
+      dx = x;
+      dy = y;
+      m = 0;
+    }
+
+    tx = ref->zre[m] + ref->zre[m] + dx;
+    ty = ref->zim[m] + ref->zim[m] + dy;
+    t = tx*dx - ty*dy + dcre;
+    dy = tx*dy + ty*dx + dcim;
+    dx = t;
+    m += 1;
+    n += 1;
+
+  }
+
+  *zre = ref->zre[m] + dx;
+  *zim = ref->zim[m] + dy;
+  return n;
+}
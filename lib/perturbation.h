@@ -0,0 +1,102 @@
+/****************************************************************************/
+/* perturbation.h: perturbation iteration of z^2 + c, for FRASCR libraries  */
+/*   One reference orbit Z is computed in fixed point (fixedpoint.h) at the */
+/*   center of the view and rounded to float64. Each pixel c = C + dc then  */
+/*   only iterates its difference from the reference, dz, in float64:       */
+/*     dz -> (2Z + dz) dz + dc                                              */
+/*   which stays accurate however deep the view, as long as dc and dz are   */
+/*   normal doubles (pixel spacing above roughly 1e-290).                   */
+/*   Where the pixel's orbit passes closer to 0 than to the reference, dz   */
+/*   loses its precision (a "glitch"); the pixel is then rebased onto the   */
+/*   start of the reference, as it is when it outlives the reference.       */
+/*   Series approximation: for the first iterations, dz is very nearly a    */
+/*   polynomial in dc, dz = A1 dc + A2 dc^2 + ..., whose coefficients are   */
+/*   iterated once for the whole view. Every pixel then starts at the last  */
+/*   iteration where the polynomial still matches probe points on the edge  */
+/*   of the view iterated in full, and so skips that many iterations.       */
+/*   Last updated: 2024 May                                                 */
+/****************************************************************************/
+/*  Author: Miguel Abele                                                    */
+/*  Copyrighted by Miguel Abele, 2024.                                      */
+/*                                                                          */
+/*  License information:                                                    */
+/*                                                                          */
+/*  This file is a part of the FRASCR application.                          */
+/*                                                                          */
+/*  FRASCR is free software; you can redistribute it and/or                 */
+/*  modify it under the terms of the GNU General Public License             */
+/*  as published by the Free Software Foundation; either version 3          */
+/*  of the License, or (at your option) any later version.                  */
+/*                                                                          */
+/*  FRASCR is distributed in the hope that it will be useful,               */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of          */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           */
+/*  GNU General Public License for more details.                            */
+/*                                                                          */
+/*  You should have received a copy of the GNU General Public License       */
+/*  along with this program; if not, write to the Free Software             */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor,                      */
+/*  Boston, MA  02110-1301, USA.                                            */
+/****************************************************************************/
+
+
+#ifndef PERTURBATION_H
+#define PERTURBATION_H
+
+
+#include "utils.h"
+
+
+#define PT_BAD_CALL   -1
+#define PT_MALLOC     -2
+#define PT_BADNUM     -3
+
+#define PT_TERMS      8        /* terms in the series approximation */
+#define PT_SERIES_TOL 1.0e-10  /* relative error allowed at the probe points */
+
+
+struct reference_orbit {
+  float64 * zre;
+  float64 * zim;
+  uint32 len;          /* Z_0 .. Z_(len-1) are held */
+  float64 cre;         /* center, rounded to float64 */
+  float64 cim;
+  int limbs;           /* fixed-point precision used for the orbit */
+  uint32 skip;         /* iterations covered by the series, 0 if none */
+  float64 radius;      /* series is in powers of dc / radius */
+  float64 are[PT_TERMS];
+  float64 aim[PT_TERMS];
+};
+typedef struct reference_orbit RefOrbit;
+
+
+/* Compute the reference orbit at center (cre, cim), given as decimal
+   strings, for up to max iterations, at a precision able to resolve
+   steps of size spacing. Returns 0 or a negative error. */
+int perturb_reference(RefOrbit * ref,
+		      const char * cre,
+		      const char * cim,
+		      float64 spacing,
+		      uint32 max);
+
+/* Fit the series approximation to a view of half-width halfw and
+   half-height halfh about the center; returns the number of iterations
+   every pixel may skip, at most max */
+uint32 perturb_series(RefOrbit * ref,
+		      float64 halfw,
+		      float64 halfh,
+		      uint32 max);
+
+void perturb_free(RefOrbit * ref);
+
+/* Iterate the point C + (dcre, dcim) while |z| <= 2, up to max times;
+   returns the count, and the final z in zre, zim */
+uint32 perturb_point(const RefOrbit * ref,
+		     float64 dcre,
+		     float64 dcim,
+		     uint32 max,
+		     float64 * zre,
+		     float64 * zim);
+
+
+#endif /* PERTURBATION_H */
@@ -0,0 +1,571 @@
+/****************************************************************************/
+/* pngpar.c: parallel png image data for FRASCR finishers                   */
+/*   Each call filters its rows in groups on a pool of threads, choosing    */
+/*   the filter of each row by the minimum sum of absolute differences, as  */
+/*   libpng does, then deflates the blocks on the pool. The zlib header     */
+/*   goes before the first block; after the last, an empty final block and  */
+/*   the adler32 of all the rows close the stream. See pngpar.h.            */
+/*   The "auto" setting is chosen from the filtered rows of the first call. */
+/*   Last updated: 2024 June                                                */
+/****************************************************************************/
+/*  Author: Miguel Abele                                                    */
+/*  Copyrighted by Miguel Abele, 2024.                                      */
+/*                                                                          */
+/*  License information:                                                    */
+/*                                                                          */
+/*  This file is a part of the FRASCR application.                          */
+/*                                                                          */
+/*  FRASCR is free software; you can redistribute it and/or                 */
+/*  modify it under the terms of the GNU General Public License             */
+/*  as published by the Free Software Foundation; either version 3          */
+/*  of the License, or (at your option) any later version.                  */
+/*                                                                          */
+/*  FRASCR is distributed in the hope that it will be useful,               */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of          */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           */
+/*  GNU General Public License for more details.                            */
+/*                                                                          */
+/*  You should have received a copy of the GNU General Public License       */
+/*  along with this program; if not, write to the Free Software             */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor,                      */
+/*  Boston, MA  02110-1301, USA.                                            */
+/****************************************************************************/
+
+
+#include "pngpar.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+
+/* rows filtered per job */
+#define PP_ROWS_PER_JOB    16
+
+/* settings tried by "auto", level and strategy, cheapest first; the last
+   is the reference for the target */
+#define PP_AUTO_SETTINGS   5
+static const int auto_settings[PP_AUTO_SETTINGS][2] = {
+  { 1, Z_HUFFMAN_ONLY },
+  { 1, Z_RLE },
+  { 1, Z_DEFAULT_STRATEGY },
+  { 6, Z_DEFAULT_STRATEGY },
+  { 9, Z_DEFAULT_STRATEGY }
+};
+
+
+/* A pool of threads taking jobs 0..njobs-1 in turn */
+typedef void (*ParJob)(void * context, uint32 job, png_byte * scratch);
+
+struct par_pool {
+  ParJob job;
+  void * context;
+  uint32 njobs;
+  uint32 next;
+  size_t scratchl;
+  int error;
+};
+typedef struct par_pool ParPool;
+
+
+struct filter_context {
+  PngPar * pp;
+  png_byte ** rows;
+  uint32 n;
+  png_byte * out;      /* n rows of rowbytes+1 */
+};
+typedef struct filter_context FilterContext;
+
+
+struct deflate_context {
+  PngPar * pp;
+  png_byte * in;       /* the filtered rows of this call */
+  size_t inl;
+  png_byte ** outa;    /* compressed block k */
+  size_t * outl;
+  uLong * adlers;      /* adler32 of block k */
+  int * error;
+};
+typedef struct deflate_context DeflateContext;
+
+
+struct auto_context {
+  const png_byte * in;
+  size_t inl;
+  uint32 nsamples;
+  size_t * sizes;      /* setting s, sample k at s*nsamples+k */
+  int * error;
+};
+typedef struct auto_context AutoContext;
+
+
+
+static void * pool_main(void * arg)
+{
+  ParPool * pool = (ParPool *)arg;
+  png_byte * scratch = NULL;
+  uint32 job;
+
+  if (pool->scratchl) {
+    scratch = malloc(pool->scratchl);
+    if (scratch == NULL) {
+      __atomic_store_n(&(pool->error), PP_MALLOC, __ATOMIC_RELAXED);
+      return NULL;
+    }
+  }
+  while ((job = __atomic_fetch_add(&(pool->next), 1, __ATOMIC_RELAXED)) < pool->njobs)
+    pool->job(pool->context, job, scratch);
+  free(scratch);
+  return NULL;
+}
+
+
+
+static int run_pool(int threads,
+		    uint32 njobs,
+		    size_t scratchl,
+		    ParJob job,
+		    void * context)
+{
+  ParPool pool;
+  pthread_t * tids;
+  int i, started;
+
+  pool.job = job;
+  pool.context = context;
+  pool.njobs = njobs;
+  pool.next = 0;
+  pool.scratchl = scratchl;
+  pool.error = 0;
+
+  if (threads > njobs)
+    threads = njobs;
+  tids = (threads > 1 ? malloc(sizeof(pthread_t)*threads) : NULL);
+
+  /* the calling thread works too; a thread that fails to start is not
+     missed, since the others take its jobs */
+  started = 1;
+  if (tids) {
+    for (i=1; i<threads; i++) {
+      if (pthread_create(&(tids[i]), NULL, pool_main, &pool) != 0)
+	break;
+      started++;
+    }
+  }
+  pool_main(&pool);
+  for (i=1; i<started; i++)
+    pthread_join(tids[i], NULL);
+  free(tids);
+
+  return pool.error;
+}
+
+
+
+static inline png_byte paeth(int a, int b, int c)
+{
+  int p, pa, pb, pc;
+
+  p = a + b - c;
+  pa = abs(p - a);
+  pb = abs(p - b);
+  pc = abs(p - c);
+  if ((pa <= pb) && (pa <= pc))
+    return (png_byte)a;
+  if (pb <= pc)
+    return (png_byte)b;
+  return (png_byte)c;
+}
+
+
+
+/* Filter row into out (filter byte first) with the filter of least sum
+   of absolute values, taken as signed bytes, among those in the filters
+   mask. Prev is NULL on the first row of the image. Scratch holds 4 rows. */
+static void filter_row(const png_byte * row,
+		       const png_byte * prev,
+		       png_byte * out,
+		       uint32 rowbytes,
+		       int bpp,
+		       int level,
+		       int filters,
+		       png_byte * scratch)
+{
+  png_byte * cand[5];
+  uint32 i, sum, best;
+  int f, bestf, a, b, c;
+
+  out[0] = 0;
+  memcpy(out+1, row, rowbytes);
+  /* nothing to gain from filtering stored data */
+  if ((level == Z_NO_COMPRESSION) || (filters == VIS_FILTER_NONE))
+    return;
+
+  cand[0] = out+1;
+  for (f=1; f<5; f++)
+    cand[f] = scratch + (f-1)*rowbytes;
+
+  for (i=0; i<rowbytes; i++) {
+    a = (i >= bpp ? row[i-bpp] : 0);
+    b = (prev ? prev[i] : 0);
+    c = ((prev && (i >= bpp)) ? prev[i-bpp] : 0);
+    cand[1][i] = row[i] - a;
+    cand[2][i] = row[i] - b;
+    cand[3][i] = row[i] - ((a + b) >> 1);
+    cand[4][i] = row[i] - paeth(a, b, c);
+  }
+
+  bestf = 0;
+  best = ~(uint32)0;
+  for (f=0; f<5; f++) {
+    if ((filters & (1 << f)) == 0)
+      continue;
+    /* a lone filter needs no sum */
+    if (filters == (1 << f)) {
+      bestf = f;
+      break;
+    }
+    sum = 0;
+    for (i=0; i<rowbytes; i++)
+      sum += (cand[f][i] < 128 ? cand[f][i] : 256 - cand[f][i]);
+    if (sum < best) {
+      best = sum;
+      bestf = f;
+    }
+  }
+  out[0] = (png_byte)bestf;
+  if (bestf)
+    memcpy(out+1, cand[bestf], rowbytes);
+}
+
+
+
+static void filter_job(void * context, uint32 job, png_byte * scratch)
+{
+  FilterContext * fc = (FilterContext *)context;
+  PngPar * pp = fc->pp;
+  uint32 r, end;
+  const png_byte * prev;
+
+  end = (job+1)*PP_ROWS_PER_JOB;
+  if (end > fc->n)
+    end = fc->n;
+  for (r=job*PP_ROWS_PER_JOB; r<end; r++) {
+    if (r > 0)
+      prev = fc->rows[r-1];
+    else
+      prev = (pp->haveprev ? pp->prev : NULL);
+    filter_row(fc->rows[r], prev, &(fc->out[(size_t)r*(pp->rowbytes+1)]),
+	       pp->rowbytes, pp->bpp, pp->level, pp->filters, scratch);
+  }
+}
+
+
+
+static void deflate_job(void * context, uint32 job, png_byte * scratch)
+{
+  DeflateContext * dc = (DeflateContext *)context;
+  PngPar * pp = dc->pp;
+  z_stream z;
+  size_t start, len, bound;
+  png_byte * out;
+
+  start = (size_t)job*PP_BLOCK;
+  len = (dc->inl - start < PP_BLOCK ? dc->inl - start : PP_BLOCK);
+
+  memset(&z, 0, sizeof(z_stream));
+  if (deflateInit2(&z, pp->level, Z_DEFLATED, -15, 8, pp->strategy) != Z_OK) {
+    __atomic_store_n(dc->error, PP_ZLIB, __ATOMIC_RELAXED);
+    return;
+  }
+  /* the 32K before the block, from this call or the one before */
+  if (start >= PP_WINDOW)
+    deflateSetDictionary(&z, dc->in + start - PP_WINDOW, PP_WINDOW);
+  else if (start > 0)
+    deflateSetDictionary(&z, dc->in, start);
+  else if (pp->windowl)
+    deflateSetDictionary(&z, pp->window, pp->windowl);
+
+  /* a sync flush adds an empty stored block to what deflateBound allows */
+  bound = deflateBound(&z, len) + 16;
+  out = malloc(bound);
+  if (out == NULL) {
+    deflateEnd(&z);
+    __atomic_store_n(dc->error, PP_MALLOC, __ATOMIC_RELAXED);
+    return;
+  }
+  z.next_in = dc->in + start;
+  z.avail_in = len;
+  z.next_out = out;
+  z.avail_out = bound;
+  if ((deflate(&z, Z_SYNC_FLUSH) != Z_OK) || (z.avail_in != 0)) {
+    free(out);
+    deflateEnd(&z);
+    __atomic_store_n(dc->error, PP_ZLIB, __ATOMIC_RELAXED);
+    return;
+  }
+  dc->outa[job] = out;
+  dc->outl[job] = bound - z.avail_out;
+  dc->adlers[job] = adler32(adler32(0L, Z_NULL, 0), dc->in + start, len);
+  deflateEnd(&z);
+}
+
+
+
+/* deflated size of one sample block with one of auto_settings */
+static void auto_job(void * context, uint32 job, png_byte * scratch)
+{
+  AutoContext * ac = (AutoContext *)context;
+  z_stream z;
+  uint32 s, k;
+  size_t start, len, bound;
+  png_byte * out;
+
+  s = job / ac->nsamples;
+  k = job % ac->nsamples;
+  /* samples spread evenly over the rows */
+  len = (ac->inl < PP_BLOCK ? ac->inl : PP_BLOCK);
+  start = (ac->nsamples > 1 ? (ac->inl - len) / (ac->nsamples - 1) * k : 0);
+
+  memset(&z, 0, sizeof(z_stream));
+  if (deflateInit2(&z, auto_settings[s][0], Z_DEFLATED, -15, 8, auto_settings[s][1]) != Z_OK) {
+    __atomic_store_n(ac->error, PP_ZLIB, __ATOMIC_RELAXED);
+    return;
+  }
+  bound = deflateBound(&z, len);
+  out = malloc(bound);
+  if (out == NULL) {
+    deflateEnd(&z);
+    __atomic_store_n(ac->error, PP_MALLOC, __ATOMIC_RELAXED);
+    return;
+  }
+  z.next_in = (png_byte *)ac->in + start;
+  z.avail_in = len;
+  z.next_out = out;
+  z.avail_out = bound;
+  if (deflate(&z, Z_FINISH) != Z_STREAM_END)
+    __atomic_store_n(ac->error, PP_ZLIB, __ATOMIC_RELAXED);
+  ac->sizes[job] = bound - z.avail_out;
+  free(out);
+  deflateEnd(&z);
+}
+
+
+
+/* settle an "auto" level on the first filtered rows */
+static int choose_setting(PngPar * pp, const png_byte * in, size_t inl)
+{
+  AutoContext ac;
+  size_t total[PP_AUTO_SETTINGS];
+  uint32 s, k;
+  int error = 0;
+
+  ac.in = in;
+  ac.inl = inl;
+  ac.nsamples = (inl / PP_BLOCK < PP_SAMPLES ? inl / PP_BLOCK : PP_SAMPLES);
+  if (ac.nsamples == 0)
+    ac.nsamples = 1;
+  ac.error = &error;
+  ac.sizes = malloc(sizeof(size_t)*PP_AUTO_SETTINGS*ac.nsamples);
+  if (ac.sizes == NULL)
+    return PP_MALLOC;
+  run_pool(pp->threads, PP_AUTO_SETTINGS*ac.nsamples, 0, auto_job, &ac);
+  if (error) {
+    free(ac.sizes);
+    return error;
+  }
+
+  for (s=0; s<PP_AUTO_SETTINGS; s++) {
+    total[s] = 0;
+    for (k=0; k<ac.nsamples; k++)
+      total[s] += ac.sizes[s*ac.nsamples+k];
+  }
+  free(ac.sizes);
+
+  for (s=0; s<PP_AUTO_SETTINGS-1; s++) {
+    if ((float64)total[s] <= pp->target * (float64)total[PP_AUTO_SETTINGS-1])
+      break;
+  }
+  pp->level = auto_settings[s][0];
+  pp->strategy = auto_settings[s][1];
+  return 0;
+}
+
+
+
+int pngpar_begin(PngPar * pp,
+		 png_structp pngptr,
+		 uint32 rowbytes,
+		 int bpp,
+		 const VisualizationOpts * visuals,
+		 int threads)
+{
+  long online;
+
+  if ((pp==NULL) || (pngptr==NULL) || (visuals==NULL) || (rowbytes==0) || (bpp < 1))
+    return PP_BAD_CALL;
+
+  pp->pngptr = pngptr;
+  pp->rowbytes = rowbytes;
+  pp->bpp = bpp;
+  pp->level = visuals->level;
+  pp->strategy = visuals->strategy;
+  pp->filters = (visuals->filters & VIS_FILTER_ALL ? visuals->filters & VIS_FILTER_ALL : VIS_FILTER_ALL);
+  pp->target = visuals->target;
+  if (threads < 1) {
+    online = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = (online > 0 ? (int)online : 1);
+  }
+  pp->threads = threads;
+  pp->haveprev = 0;
+  pp->windowl = 0;
+  pp->adler = adler32(0L, Z_NULL, 0);
+  pp->started = 0;
+  pp->prev = malloc(rowbytes);
+  pp->window = malloc(PP_WINDOW);
+  if ((pp->prev == NULL) || (pp->window == NULL)) {
+    pngpar_free(pp);
+    return PP_MALLOC;
+  }
+  return 0;
+}
+
+
+
+int pngpar_rows(PngPar * pp, png_byte ** rows, uint32 n)
+{
+  FilterContext fc;
+  DeflateContext dc;
+  uint32 k, nblocks;
+  size_t total, keep;
+  png_byte * idat;
+  int error = 0;
+
+  if ((pp==NULL) || (rows==NULL))
+    return PP_BAD_CALL;
+  if (n == 0)
+    return 0;
+
+  fc.pp = pp;
+  fc.rows = rows;
+  fc.n = n;
+  fc.out = malloc((size_t)n*(pp->rowbytes+1));
+  if (fc.out == NULL)
+    return PP_MALLOC;
+  error = run_pool(pp->threads, (n + PP_ROWS_PER_JOB - 1) / PP_ROWS_PER_JOB,
+		   4*(size_t)pp->rowbytes, filter_job, &fc);
+  if (!error && (pp->level == VIS_LEVEL_AUTO))
+    error = choose_setting(pp, fc.out, (size_t)n*(pp->rowbytes+1));
+  if (error) {
+    free(fc.out);
+    return error;
+  }
+
+  dc.pp = pp;
+  dc.in = fc.out;
+  dc.inl = (size_t)n*(pp->rowbytes+1);
+  dc.error = &error;
+  nblocks = (dc.inl + PP_BLOCK - 1) / PP_BLOCK;
+  dc.outa = calloc(nblocks, sizeof(png_byte *));
+  dc.outl = malloc(sizeof(size_t)*nblocks);
+  dc.adlers = malloc(sizeof(uLong)*nblocks);
+  if ((dc.outa == NULL) || (dc.outl == NULL) || (dc.adlers == NULL))
+    error = PP_MALLOC;
+  else
+    run_pool(pp->threads, nblocks, 0, deflate_job, &dc);
+
+  /* one IDAT for the call, after the zlib header the first time */
+  if (!error) {
+    total = (pp->started ? 0 : 2);
+    for (k=0; k<nblocks; k++)
+      total += dc.outl[k];
+    idat = malloc(total);
+    if (idat == NULL) {
+      error = PP_MALLOC;
+    } else {
+      total = 0;
+      if (!pp->started) {
+	/* deflate, 32K window, compression level hint, no dictionary */
+	idat[0] = 0x78;
+	idat[1] = (pp->level < 2 ? 0 : (pp->level < 6 ? 1 : (pp->level == 6 ? 2 : 3))) << 6;
+	idat[1] += 31 - ((idat[0]*256 + idat[1]) % 31);
+	total = 2;
+	pp->started = 1;
+      }
+      for (k=0; k<nblocks; k++) {
+	memcpy(idat + total, dc.outa[k], dc.outl[k]);
+	total += dc.outl[k];
+	pp->adler = adler32_combine(pp->adler, dc.adlers[k],
+				    (k+1 < nblocks ? PP_BLOCK : dc.inl - (size_t)k*PP_BLOCK));
+      }
+      png_write_chunk(pp->pngptr, (png_const_bytep)"IDAT", idat, total);
+      free(idat);
+    }
+  }
+
+  if (dc.outa) {
+    for (k=0; k<nblocks; k++)
+      free(dc.outa[k]);
+  }
+  free(dc.outa);
+  free(dc.outl);
+  free(dc.adlers);
+
+  /* what the next call needs: the last row and the last 32K */
+  if (!error) {
+    memcpy(pp->prev, rows[n-1], pp->rowbytes);
+    pp->haveprev = 1;
+    if (dc.inl >= PP_WINDOW) {
+      memcpy(pp->window, dc.in + dc.inl - PP_WINDOW, PP_WINDOW);
+      pp->windowl = PP_WINDOW;
+    } else {
+      keep = (pp->windowl + dc.inl > PP_WINDOW ? PP_WINDOW - dc.inl : pp->windowl);
+      memmove(pp->window, pp->window + pp->windowl - keep, keep);
+      memcpy(pp->window + keep, dc.in, dc.inl);
+      pp->windowl = keep + dc.inl;
+    }
+  }
+  free(fc.out);
+
+  return error;
+}
+
+
+
+int pngpar_end(PngPar * pp)
+{
+  /* header (if no rows came), an empty final fixed block, the adler32 */
+  png_byte tail[8];
+  int l = 0;
+
+  if (pp==NULL)
+    return PP_BAD_CALL;
+
+  if (!pp->started) {
+    tail[l++] = 0x78;
+    tail[l++] = 0x01;
+    pp->started = 1;
+  }
+  tail[l++] = 0x03;
+  tail[l++] = 0x00;
+  tail[l++] = (pp->adler >> 24) & 0xff;
+  tail[l++] = (pp->adler >> 16) & 0xff;
+  tail[l++] = (pp->adler >> 8) & 0xff;
+  tail[l++] = pp->adler & 0xff;
+  png_write_chunk(pp->pngptr, (png_const_bytep)"IDAT", tail, l);
+  png_write_chunk(pp->pngptr, (png_const_bytep)"IEND", NULL, 0);
+  pngpar_free(pp);
+  return 0;
+}
+
+
+
+void pngpar_free(PngPar * pp)
+{
+  if (pp==NULL)
+    return;
+  free(pp->prev);
+  free(pp->window);
+  pp->prev = NULL;
+  pp->window = NULL;
+}
@@ -0,0 +1,102 @@
+/****************************************************************************/
+/* pngpar.h: parallel png image data for FRASCR finishers                   */
+/*   Filters and deflates the rows of a png on several threads and writes   */
+/*   them as IDAT chunks, leaving the signature, header and text chunks to  */
+/*   libpng (png_write_info) as before. The filtered rows are cut into      */
+/*   blocks of PP_BLOCK bytes, each deflated on its own as a raw stream     */
+/*   primed with the 32K before it and ended by a sync flush, so that the   */
+/*   blocks concatenate into one zlib stream (as pigz does). The blocks do  */
+/*   not depend on the number of threads, nor does the output.              */
+/*   Rows can be passed in several calls, e.g. one per streamed band.       */
+/*   Level, strategy and filters come from the visualization options. With  */
+/*   level "auto", a few blocks of the first rows are deflated with each of */
+/*   a list of settings, cheapest first, and the first whose output is      */
+/*   within "target" times the size at level 9 is kept for the whole image. */
+/*   Last updated: 2024 June                                                */
+/****************************************************************************/
+/*  Author: Miguel Abele                                                    */
+/*  Copyrighted by Miguel Abele, 2024.                                      */
+/*                                                                          */
+/*  License information:                                                    */
+/*                                                                          */
+/*  This file is a part of the FRASCR application.                          */
+/*                                                                          */
+/*  FRASCR is free software; you can redistribute it and/or                 */
+/*  modify it under the terms of the GNU General Public License             */
+/*  as published by the Free Software Foundation; either version 3          */
+/*  of the License, or (at your option) any later version.                  */
+/*                                                                          */
+/*  FRASCR is distributed in the hope that it will be useful,               */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of          */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           */
+/*  GNU General Public License for more details.                            */
+/*                                                                          */
+/*  You should have received a copy of the GNU General Public License       */
+/*  along with this program; if not, write to the Free Software             */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor,                      */
+/*  Boston, MA  02110-1301, USA.                                            */
+/****************************************************************************/
+
+
+#ifndef PNGPAR_H
+#define PNGPAR_H
+
+
+#include "options.h"
+#include "utils.h"
+#include <png.h>
+#include <zlib.h>
+
+
+#define PP_BAD_CALL    -70
+#define PP_MALLOC      -71
+#define PP_ZLIB        -72
+
+/* uncompressed bytes per deflate block */
+#define PP_BLOCK       (128*1024)
+/* deflate window, and the dictionary handed from block to block */
+#define PP_WINDOW      32768
+/* blocks of the first rows deflated to choose the "auto" setting */
+#define PP_SAMPLES     4
+
+
+struct png_par {
+  png_structp pngptr;
+  uint32 rowbytes;     /* bytes per row, without the filter byte */
+  int bpp;             /* bytes per pixel, for the Sub and Paeth filters */
+  int level;           /* zlib compression level, or VIS_LEVEL_AUTO */
+  int strategy;
+  int filters;         /* VIS_FILTER mask */
+  float64 target;
+  int threads;
+  png_byte * prev;     /* last row so far, unfiltered */
+  int haveprev;
+  png_byte * window;   /* last PP_WINDOW bytes of the filtered rows */
+  uint32 windowl;
+  uLong adler;         /* of the filtered rows so far */
+  int started;         /* zlib header written */
+};
+typedef struct png_par PngPar;
+
+
+/* Prepare to write rows of rowbytes bytes with bpp bytes per pixel, after
+   png_write_info, compressed as visuals says. Threads 0 means one per
+   online processor. */
+int pngpar_begin(PngPar * pp,
+		 png_structp pngptr,
+		 uint32 rowbytes,
+		 int bpp,
+		 const VisualizationOpts * visuals,
+		 int threads);
+
+/* Write the next n rows, top down */
+int pngpar_rows(PngPar * pp, png_byte ** rows, uint32 n);
+
+/* Close the zlib stream and write IEND; the png is then complete */
+int pngpar_end(PngPar * pp);
+
+/* Release pp, written or not */
+void pngpar_free(PngPar * pp);
+
+
+#endif /* PNGPAR_H */
@@ -0,0 +1,402 @@
+/****************************************************************************/
+/* quadkernel.c: escape-time kernels for z^2 + c, for FRASCR libraries      */
+/*   The vector kernels iterate 4 or 8 points at once, one per lane, and    */
+/*   find the lanes that are done with a mask. Whenever a lane finishes,    */
+/*   its result is written out and the lane is refilled with the next       */
+/*   pending point, so slow points inside the set do not leave the other    */
+/*   lanes idle. The operations are those of the scalar loop, in the same   */
+/*   order, and this file is built without floating-point contraction (no   */
+/*   FMA), so every version produces the same bits.                         */
+/*   The vector kernels are compiled for their instruction set with the     */
+/*   target attribute and only called after a CPUID check, so the library   */
+/*   itself still runs on any x86-64.                                       */
+/*   Last updated: 2024 May                                                 */
+/****************************************************************************/
+/*  Author: Miguel Abele                                                    */
+/*  Copyrighted by Miguel Abele, 2024.                                      */
+/*                                                                          */
+/*  License information:                                                    */
+/*                                                                          */
+/*  This file is a part of the FRASCR application.                          */
+/*                                                                          */
+/*  FRASCR is free software; you can redistribute it and/or                 */
+/*  modify it under the terms of the GNU General Public License             */
+/*  as published by the Free Software Foundation; either version 3          */
+/*  of the License, or (at your option) any later version.                  */
+/*                                                                          */
+/*  FRASCR is distributed in the hope that it will be useful,               */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of          */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           */
+/*  GNU General Public License for more details.                            */
+/*                                                                          */
+/*  You should have received a copy of the GNU General Public License       */
+/*  along with this program; if not, write to the Free Software             */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor,                      */
+/*  Boston, MA  02110-1301, USA.                                            */
+/****************************************************************************/
+
+
+#include "quadkernel.h"
+#include "periodicity.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define QK_X86
+#include <immintrin.h>
+#endif
+
+
+
+void quadkernel_scalar(float64 * zre,
+		       float64 * zim,
+		       const float64 * cre,
+		       const float64 * cim,
+		       uint32 * n,
+		       uint32 * period,
+		       uint32 count,
+		       uint32 max,
+		       float64 tolsq)
+{
+  float64 x, y, xsq, ysq, x0, y0;
+  PeriodCheck pc;
+  uint32 p, k, per;
+
+  for (p=0; p<count; p++) {
+
+    x = zre[p];
+    y = zim[p];
+    x0 = cre[p];
+    y0 = cim[p];
+    k = 0;
+    per = 0;
+    period_start(&pc, x, y, tolsq);
+
+    while ( k < max ) {
+      xsq = x*x;
+      ysq = y*y;
+      if (xsq+ysq <= 4.) {
+	y = (x+x)*y + y0;
+	x = xsq - ysq + x0;
+	k += 1;
+	if ((tolsq > 0.) && (per = period_step(&pc, x, y))) {
+	  k = max;
+	  break;
+	}
+      }
+      else
+	break;
+    }
+
+    zre[p] = x;
+    zim[p] = y;
+    n[p] = k;
+    if (period)
+      period[p] = per;
+
+  }
+}
+
+
+
+#ifdef QK_X86
+
+/* Lane bookkeeping shared by the vector kernels: the lane state is spilled
+   to these arrays whenever a lane finishes, so the finished point can be
+   written out and the next one loaded. */
+struct lane_state {
+  float64 x[8], y[8], x0[8], y0[8], cnt[8];
+  float64 sx[8], sy[8], steps[8], limit[8], per[8];
+  int point[8];      /* point held by each lane, or -1 */
+};
+typedef struct lane_state LaneState;
+
+
+/* write out the lanes in done and refill them; returns the lanes still busy */
+static inline int lanes_refill(LaneState * ls,
+			       int busy,
+			       int done,
+			       int lanes,
+			       float64 * zre,
+			       float64 * zim,
+			       const float64 * cre,
+			       const float64 * cim,
+			       uint32 * n,
+			       uint32 * period,
+			       uint32 count,
+			       uint32 * next)
+{
+  int l, p;
+
+  for (l=0; l<lanes; l++) {
+    if (!(done & (1 << l)))
+      continue;
+    p = ls->point[l];
+    zre[p] = ls->x[l];
+    zim[p] = ls->y[l];
+    n[p] = (uint32)ls->cnt[l];
+    if (period)
+      period[p] = (uint32)ls->per[l];
+    if (*next < count) {
+      p = (*next)++;
+      ls->point[l] = p;
+      ls->x[l] = zre[p];
+      ls->y[l] = zim[p];
+      ls->x0[l] = cre[p];
+      ls->y0[l] = cim[p];
+      ls->cnt[l] = 0.;
+      ls->sx[l] = zre[p];
+      ls->sy[l] = zim[p];
+      ls->steps[l] = 0.;
+      ls->limit[l] = 1.;
+      ls->per[l] = 0.;
+    } else {
+      ls->point[l] = -1;
+      busy &= ~(1 << l);
+    }
+  }
+  return busy;
+}
+
+
+
+/* Between refills every busy lane is live, so a step needs no masking:
+   lanes left over at the end iterate on harmlessly and are never stored. */
+
+__attribute__((target("avx2")))
+static void quadkernel_avx2(float64 * zre,
+			    float64 * zim,
+			    const float64 * cre,
+			    const float64 * cim,
+			    uint32 * n,
+			    uint32 * period,
+			    uint32 count,
+			    uint32 max,
+			    float64 tolsq)
+{
+  __m256d x, y, xsq, ysq, x0, y0, cnt, live;
+  __m256d sx, sy, steps, limit, per, dx, dy, close, reset;
+  const __m256d four = _mm256_set1_pd(4.0);
+  const __m256d one = _mm256_set1_pd(1.0);
+  /* counts are kept as doubles: exact far beyond any uint32 */
+  const __m256d top = _mm256_set1_pd((float64)max);
+  const __m256d tol = _mm256_set1_pd(tolsq);
+  const int check = (tolsq > 0.);
+  LaneState ls;
+  int busy, done, l;
+  uint32 next;
+
+  if (count < 4) {
+    quadkernel_scalar(zre, zim, cre, cim, n, period, count, max, tolsq);
+    return;
+  }
+
+  for (l=0; l<4; l++) {
+    ls.point[l] = l;
+    ls.x[l] = ls.sx[l] = zre[l];
+    ls.y[l] = ls.sy[l] = zim[l];
+    ls.x0[l] = cre[l];
+    ls.y0[l] = cim[l];
+    ls.cnt[l] = ls.steps[l] = ls.per[l] = 0.;
+    ls.limit[l] = 1.;
+  }
+  next = 4;
+  busy = 0xf;
+
+  x = _mm256_loadu_pd(ls.x);
+  y = _mm256_loadu_pd(ls.y);
+  x0 = _mm256_loadu_pd(ls.x0);
+  y0 = _mm256_loadu_pd(ls.y0);
+  cnt = _mm256_loadu_pd(ls.cnt);
+  sx = _mm256_loadu_pd(ls.sx);
+  sy = _mm256_loadu_pd(ls.sy);
+  steps = _mm256_loadu_pd(ls.steps);
+  limit = _mm256_loadu_pd(ls.limit);
+  per = _mm256_loadu_pd(ls.per);
+
+  while (busy) {
+
+    xsq = _mm256_mul_pd(x, x);
+    ysq = _mm256_mul_pd(y, y);
+    live = _mm256_and_pd(_mm256_cmp_pd(_mm256_add_pd(xsq, ysq), four, _CMP_LE_OQ),
+			 _mm256_cmp_pd(cnt, top, _CMP_LT_OQ));
+    done = busy & ~_mm256_movemask_pd(live);
+
+    /* hand finished lanes their result, then the next pending point */
+    if (done) {
+      _mm256_storeu_pd(ls.x, x);
+      _mm256_storeu_pd(ls.y, y);
+      _mm256_storeu_pd(ls.x0, x0);
+      _mm256_storeu_pd(ls.y0, y0);
+      _mm256_storeu_pd(ls.cnt, cnt);
+      _mm256_storeu_pd(ls.sx, sx);
+      _mm256_storeu_pd(ls.sy, sy);
+      _mm256_storeu_pd(ls.steps, steps);
+      _mm256_storeu_pd(ls.limit, limit);
+      _mm256_storeu_pd(ls.per, per);
+      busy = lanes_refill(&ls, busy, done, 4, zre, zim, cre, cim, n, period, count, &next);
+      x = _mm256_loadu_pd(ls.x);
+      y = _mm256_loadu_pd(ls.y);
+      x0 = _mm256_loadu_pd(ls.x0);
+      y0 = _mm256_loadu_pd(ls.y0);
+      cnt = _mm256_loadu_pd(ls.cnt);
+      sx = _mm256_loadu_pd(ls.sx);
+      sy = _mm256_loadu_pd(ls.sy);
+      steps = _mm256_loadu_pd(ls.steps);
+      limit = _mm256_loadu_pd(ls.limit);
+      per = _mm256_loadu_pd(ls.per);
+      continue;
+    }
+
+    y = _mm256_add_pd(_mm256_mul_pd(_mm256_add_pd(x, x), y), y0);
+    x = _mm256_add_pd(_mm256_sub_pd(xsq, ysq), x0);
+    cnt = _mm256_add_pd(cnt, one);
+
+    if (check) {
+      steps = _mm256_add_pd(steps, one);
+      dx = _mm256_sub_pd(x, sx);
+      dy = _mm256_sub_pd(y, sy);
+      close = _mm256_cmp_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)),
+			    tol, _CMP_LE_OQ);
+      if (_mm256_movemask_pd(close)) {
+	per = _mm256_blendv_pd(per, steps, close);
+	cnt = _mm256_blendv_pd(cnt, top, close);
+      }
+      reset = _mm256_andnot_pd(close, _mm256_cmp_pd(steps, limit, _CMP_EQ_OQ));
+      if (_mm256_movemask_pd(reset)) {
+	sx = _mm256_blendv_pd(sx, x, reset);
+	sy = _mm256_blendv_pd(sy, y, reset);
+	steps = _mm256_andnot_pd(reset, steps);
+	limit = _mm256_add_pd(limit, _mm256_and_pd(reset, limit));
+      }
+    }
+
+  }
+}
+
+
+
+__attribute__((target("avx512f")))
+static void quadkernel_avx512(float64 * zre,
+			      float64 * zim,
+			      const float64 * cre,
+			      const float64 * cim,
+			      uint32 * n,
+			      uint32 * period,
+			      uint32 count,
+			      uint32 max,
+			      float64 tolsq)
+{
+  __m512d x, y, xsq, ysq, x0, y0, cnt;
+  __m512d sx, sy, steps, limit, per, dx, dy;
+  __mmask8 live, close, reset;
+  const __m512d four = _mm512_set1_pd(4.0);
+  const __m512d one = _mm512_set1_pd(1.0);
+  const __m512d top = _mm512_set1_pd((float64)max);
+  const __m512d tol = _mm512_set1_pd(tolsq);
+  const int check = (tolsq > 0.);
+  LaneState ls;
+  int busy, done, l;
+  uint32 next;
+
+  /* too few points to fill the lanes */
+  if (count < 8) {
+    quadkernel_avx2(zre, zim, cre, cim, n, period, count, max, tolsq);
+    return;
+  }
+
+  for (l=0; l<8; l++) {
+    ls.point[l] = l;
+    ls.x[l] = ls.sx[l] = zre[l];
+    ls.y[l] = ls.sy[l] = zim[l];
+    ls.x0[l] = cre[l];
+    ls.y0[l] = cim[l];
+    ls.cnt[l] = ls.steps[l] = ls.per[l] = 0.;
+    ls.limit[l] = 1.;
+  }
+  next = 8;
+  busy = 0xff;
+
+  x = _mm512_loadu_pd(ls.x);
+  y = _mm512_loadu_pd(ls.y);
+  x0 = _mm512_loadu_pd(ls.x0);
+  y0 = _mm512_loadu_pd(ls.y0);
+  cnt = _mm512_loadu_pd(ls.cnt);
+  sx = _mm512_loadu_pd(ls.sx);
+  sy = _mm512_loadu_pd(ls.sy);
+  steps = _mm512_loadu_pd(ls.steps);
+  limit = _mm512_loadu_pd(ls.limit);
+  per = _mm512_loadu_pd(ls.per);
+
+  while (busy) {
+
+    xsq = _mm512_mul_pd(x, x);
+    ysq = _mm512_mul_pd(y, y);
+    live = _mm512_cmp_pd_mask(_mm512_add_pd(xsq, ysq), four, _CMP_LE_OQ)
+      & _mm512_cmp_pd_mask(cnt, top, _CMP_LT_OQ);
+    done = busy & ~live;
+
+    if (done) {
+      _mm512_storeu_pd(ls.x, x);
+      _mm512_storeu_pd(ls.y, y);
+      _mm512_storeu_pd(ls.x0, x0);
+      _mm512_storeu_pd(ls.y0, y0);
+      _mm512_storeu_pd(ls.cnt, cnt);
+      _mm512_storeu_pd(ls.sx, sx);
+      _mm512_storeu_pd(ls.sy, sy);
+      _mm512_storeu_pd(ls.steps, steps);
+      _mm512_storeu_pd(ls.limit, limit);
+      _mm512_storeu_pd(ls.per, per);
+      busy = lanes_refill(&ls, busy, done, 8, zre, zim, cre, cim, n, period, count, &next);
+      x = _mm512_loadu_pd(ls.x);
+      y = _mm512_loadu_pd(ls.y);
+      x0 = _mm512_loadu_pd(ls.x0);
+      y0 = _mm512_loadu_pd(ls.y0);
+      cnt = _mm512_loadu_pd(ls.cnt);
+      sx = _mm512_loadu_pd(ls.sx);
+      sy = _mm512_loadu_pd(ls.sy);
+      steps = _mm512_loadu_pd(ls.steps);
+      limit = _mm512_loadu_pd(ls.limit);
+      per = _mm512_loadu_pd(ls.per);
+      continue;
+    }
+
+    y = _mm512_add_pd(_mm512_mul_pd(_mm512_add_pd(x, x), y), y0);
+    x = _mm512_add_pd(_mm512_sub_pd(xsq, ysq), x0);
+    cnt = _mm512_add_pd(cnt, one);
+
+    if (check) {
+      steps = _mm512_add_pd(steps, one);
+      dx = _mm512_sub_pd(x, sx);
+      dy = _mm512_sub_pd(y, sy);
+      close = _mm512_cmp_pd_mask(_mm512_add_pd(_mm512_mul_pd(dx, dx), _mm512_mul_pd(dy, dy)),
+				 tol, _CMP_LE_OQ);
+      if (close) {
+	per = _mm512_mask_mov_pd(per, close, steps);
+	cnt = _mm512_mask_mov_pd(cnt, close, top);
+      }
+      reset = _mm512_cmp_pd_mask(steps, limit, _CMP_EQ_OQ) & ~close;
+      if (reset) {
+	sx = _mm512_mask_mov_pd(sx, reset, x);
+	sy = _mm512_mask_mov_pd(sy, reset, y);
+	steps = _mm512_mask_mov_pd(steps, reset, _mm512_setzero_pd());
+	limit = _mm512_mask_add_pd(limit, reset, limit, limit);
+      }
+    }
+
+  }
+}
+
+#endif /* QK_X86 */
+
+
+
+QuadKernel quadkernel_select(void)
+{
+#ifdef QK_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+    return quadkernel_avx512;
+  if (__builtin_cpu_supports("avx2"))
+    return quadkernel_avx2;
+#endif
+  return quadkernel_scalar;
+}
@@ -0,0 +1,76 @@
+/****************************************************************************/
+/* quadkernel.h: escape-time kernels for z^2 + c, for FRASCR libraries      */
+/*   A kernel iterates count points at once, each from its own z and c,     */
+/*   until |z| > 2 or max iterations, leaving the final z and the count in  */
+/*   the arrays. Scalar, AVX2 (4 lanes) and AVX-512 (8 lanes) versions are  */
+/*   provided; quadkernel_select picks the widest one the CPU supports.     */
+/*   Optionally, orbits are checked for cycles as they go (periodicity.h).  */
+/*   All versions give bit-identical results to the scalar loop.            */
+/*   Last updated: 2024 May                                                 */
+/****************************************************************************/
+/*  Author: Miguel Abele                                                    */
+/*  Copyrighted by Miguel Abele, 2024.                                      */
+/*                                                                          */
+/*  License information:                                                    */
+/*                                                                          */
+/*  This file is a part of the FRASCR application.                          */
+/*                                                                          */
+/*  FRASCR is free software; you can redistribute it and/or                 */
+/*  modify it under the terms of the GNU General Public License             */
+/*  as published by the Free Software Foundation; either version 3          */
+/*  of the License, or (at your option) any later version.                  */
+/*                                                                          */
+/*  FRASCR is distributed in the hope that it will be useful,               */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of          */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           */
+/*  GNU General Public License for more details.                            */
+/*                                                                          */
+/*  You should have received a copy of the GNU General Public License       */
+/*  along with this program; if not, write to the Free Software             */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor,                      */
+/*  Boston, MA  02110-1301, USA.                                            */
+/****************************************************************************/
+
+
+#ifndef QUADKERNEL_H
+#define QUADKERNEL_H
+
+
+#include "utils.h"
+
+
+/* number of points handed to a kernel at once by the libraries */
+#define QK_BATCH      64
+
+
+/* For each point p < count, starting from n[p] = 0:
+     while ( n[p] < max && zre[p]^2 + zim[p]^2 <= 4 ) { z = z^2 + c; n[p]++; }
+   With tolsq above 0, the orbit is also checked for cycles (periodicity.h);
+   a point found periodic stops with n[p] = max and its period in period[p],
+   which is 0 for all other points. period may be NULL if tolsq is 0. */
+typedef void (*QuadKernel)(float64 * zre,
+			   float64 * zim,
+			   const float64 * cre,
+			   const float64 * cim,
+			   uint32 * n,
+			   uint32 * period,
+			   uint32 count,
+			   uint32 max,
+			   float64 tolsq);
+
+
+void quadkernel_scalar(float64 * zre,
+		       float64 * zim,
+		       const float64 * cre,
+		       const float64 * cim,
+		       uint32 * n,
+		       uint32 * period,
+		       uint32 count,
+		       uint32 max,
+		       float64 tolsq);
+
+/* Widest kernel supported by the running CPU */
+QuadKernel quadkernel_select(void);
+
+
+#endif /* QUADKERNEL_H */
@@ -0,0 +1,190 @@
+/****************************************************************************/
+/* resume.c: orbits kept from one render to the next, FRASCR libraries      */
+/*   The file is a header naming the library and the view, then a           */
+/*   ResumePoint per pixel, column by column. It is written beside its      */
+/*   final name and renamed into place, so an interrupted render leaves the */
+/*   last good file behind.                                                 */
+/*   Last updated: 2024 June                                                */
+/****************************************************************************/
+/*  Author: Miguel Abele                                                    */
+/*  Copyrighted by Miguel Abele, 2024.                                      */
+/*                                                                          */
+/*  License information:                                                    */
+/*                                                                          */
+/*  This file is a part of the FRASCR application.                          */
+/*                                                                          */
+/*  FRASCR is free software; you can redistribute it and/or                 */
+/*  modify it under the terms of the GNU General Public License             */
+/*  as published by the Free Software Foundation; either version 3          */
+/*  of the License, or (at your option) any later version.                  */
+/*                                                                          */
+/*  FRASCR is distributed in the hope that it will be useful,               */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of          */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           */
+/*  GNU General Public License for more details.                            */
+/*                                                                          */
+/*  You should have received a copy of the GNU General Public License       */
+/*  along with this program; if not, write to the Free Software             */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor,                      */
+/*  Boston, MA  02110-1301, USA.                                            */
+/****************************************************************************/
+
+
+#include "resume.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+struct resume_header {
+  char magic[4];
+  uint32 byteorder;
+  char tag[RS_TAG];
+  uint32 nx, ny;
+  uint32 escape;
+  uint32 reserved;
+  float64 left, bottom, width, height;
+  float64 coord_Re, coord_Im;
+};
+typedef struct resume_header ResumeHeader;
+
+
+static void header_for(ResumeHeader * rh, ResumeState * rs, CanvasOpts * canvopts)
+{
+  memset(rh, 0, sizeof(ResumeHeader));
+  memcpy(rh->magic, RS_MAGIC, 4);
+  rh->byteorder = RS_BYTEORDER;
+  memcpy(rh->tag, rs->tag, RS_TAG);
+  rh->nx = canvopts->nwidth;
+  rh->ny = canvopts->nheight;
+  rh->escape = canvopts->escape;
+  rh->left = canvopts->left;
+  rh->bottom = canvopts->bottom;
+  rh->width = canvopts->width;
+  rh->height = canvopts->height;
+  rh->coord_Re = canvopts->coord_Re;
+  rh->coord_Im = canvopts->coord_Im;
+}
+
+
+/* the orbits of the file, if it was written for this view by this
+   library at a limit no higher than canvopts' */
+static void load(ResumeState * rs, CanvasOpts * canvopts)
+{
+  ResumeHeader want, have;
+  uint64 count = (uint64)rs->nx * rs->ny;
+  FILE * in;
+
+  in = fopen(canvopts->resume, "rb");
+  if (in == NULL)
+    return;
+  header_for(&want, rs, canvopts);
+  if ((fread(&have, sizeof(ResumeHeader), 1, in) == 1)
+      && (have.escape > 0) && (have.escape <= want.escape)) {
+    /* everything but the limit must be the same, bit for bit */
+    want.escape = have.escape;
+    if ((memcmp(&want, &have, sizeof(ResumeHeader)) == 0)
+	&& (fread(rs->points, sizeof(ResumePoint), count, in) == count))
+      rs->start = have.escape;
+  }
+  fclose(in);
+}
+
+
+int resume_begin(ResumeState * rs, CanvasOpts * canvopts, const char * tag)
+{
+  memset(rs->tag, 0, RS_TAG);
+  strncpy(rs->tag, tag, RS_TAG-1);
+  rs->nx = canvopts->nwidth;
+  rs->ny = canvopts->nheight;
+  resume_none(rs);
+  if (canvopts->resume == NULL)
+    return 0;
+
+  rs->points = malloc(sizeof(ResumePoint) * (uint64)rs->nx * rs->ny);
+  rs->stored = calloc((uint64)rs->nx * rs->ny, 1);
+  if ((rs->points == NULL) || (rs->stored == NULL)) {
+    free(rs->points);
+    free(rs->stored);
+    resume_none(rs);
+    return RS_MALLOC;
+  }
+  load(rs, canvopts);
+  if (canvopts->debug) {
+    if (rs->start) {
+      DEBUG(canvopts->debug, D1, "%s: resuming the orbits of %s from escape %u\n",
+	    rs->tag, canvopts->resume, rs->start);
+    } else {
+      DEBUG(canvopts->debug, D1, "%s: no orbits to resume in %s, starting over\n",
+	    rs->tag, canvopts->resume);
+    }
+  }
+  return 0;
+}
+
+
+void resume_mirror(ResumeState * rs, Mirror * m, int conjugate)
+{
+  ResumePoint * d, * s;
+  uint32 i, j, fi;
+
+  if (rs->points == NULL)
+    return;
+  for (i=m->i0; i<m->i1; i++) {
+    fi = (m->si < 0 ? i : m->si - i);
+    for (j=m->j0; j<m->j1; j++) {
+      s = resume_at(rs, fi, m->sj - j);
+      d = resume_at(rs, i, j);
+      *d = *s;
+      if (conjugate)
+	d->zim = 0. - s->zim;
+      rs->stored[(uint64)i * rs->ny + j] = 1;
+    }
+  }
+}
+
+
+void resume_end(ResumeState * rs, CanvasOpts * canvopts)
+{
+  ResumeHeader rh;
+  uint64 count = (uint64)rs->nx * rs->ny;
+  uint64 k;
+  char * temp;
+  FILE * out;
+  int ret;
+
+  if (rs->points == NULL)
+    return;
+
+  /* a render cut short leaves the last file as it was */
+  for (k=0; (k<count) && rs->stored[k]; k++)
+    ;
+  if (k == count) {
+    ret = 1;
+    temp = malloc(strlen(canvopts->resume) + 5);
+    if (temp) {
+      sprintf(temp, "%s.tmp", canvopts->resume);
+      out = fopen(temp, "wb");
+      if (out) {
+	header_for(&rh, rs, canvopts);
+	if ((fwrite(&rh, sizeof(ResumeHeader), 1, out) == 1)
+	    && (fwrite(rs->points, sizeof(ResumePoint), count, out) == count)) {
+	  if ((fclose(out) == 0) && (rename(temp, canvopts->resume) == 0))
+	    ret = 0;
+	} else {
+	  fclose(out);
+	}
+	if (ret)
+	  remove(temp);
+      }
+      free(temp);
+    }
+    if (ret && canvopts->debug)
+      DEBUG(canvopts->debug, D0, "%s: could not write the orbits to %s\n",
+	    rs->tag, canvopts->resume);
+  }
+
+  free(rs->points);
+  free(rs->stored);
+  resume_none(rs);
+}
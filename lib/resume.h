@@ -0,0 +1,143 @@
+/****************************************************************************/
+/* resume.h: orbits kept from one render to the next, FRASCR libraries      */
+/*   With canvas option "resume" naming a file, a library stores where the  */
+/*   orbit of every pixel stopped: its z, its count and the cycle found, if */
+/*   any. A later render of exactly the same view (and library, and         */
+/*   constant) with an escape limit at least as high loads them: escaped    */
+/*   and periodic pixels are taken as they are, and the rest are iterated   */
+/*   on from their z for only the iterations the old limit did not reach.   */
+/*   The file is then rewritten for the new limit. When the file is missing */
+/*   or does not match, the render starts from nothing and writes it        */
+/*   afresh. Cycle detection starts over on a resumed orbit, so it can find */
+/*   a cycle at a different count than a render from scratch would, but not */
+/*   a different answer for a pixel inside or outside.                      */
+/*   Last updated: 2024 June                                                */
+/****************************************************************************/
+/*  Author: Miguel Abele                                                    */
+/*  Copyrighted by Miguel Abele, 2024.                                      */
+/*                                                                          */
+/*  License information:                                                    */
+/*                                                                          */
+/*  This file is a part of the FRASCR application.                          */
+/*                                                                          */
+/*  FRASCR is free software; you can redistribute it and/or                 */
+/*  modify it under the terms of the GNU General Public License             */
+/*  as published by the Free Software Foundation; either version 3          */
+/*  of the License, or (at your option) any later version.                  */
+/*                                                                          */
+/*  FRASCR is distributed in the hope that it will be useful,               */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of          */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           */
+/*  GNU General Public License for more details.                            */
+/*                                                                          */
+/*  You should have received a copy of the GNU General Public License       */
+/*  along with this program; if not, write to the Free Software             */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor,                      */
+/*  Boston, MA  02110-1301, USA.                                            */
+/****************************************************************************/
+
+
+#ifndef RESUME_H
+#define RESUME_H
+
+
+#include "options.h"
+#include "utils.h"
+#include "symmetry.h"
+
+
+#define RS_MALLOC      -110
+
+#define RS_MAGIC       "FRS1"
+#define RS_BYTEORDER   0x01020304
+#define RS_TAG         16
+
+
+/* where one pixel's orbit stopped */
+struct resume_point {
+  float64 zre, zim;
+  uint32 n;            /* count reached */
+  uint32 period;       /* cycle found, or the main bulb's period; 0 if none */
+};
+typedef struct resume_point ResumePoint;
+
+
+struct resume_state {
+  char tag[RS_TAG];    /* the library computing the orbits */
+  uint32 nx, ny;
+  uint32 start;        /* escape limit of the loaded orbits, 0 if none */
+  ResumePoint * points; /* pixel (i,j) at i*ny + j, or NULL if resume is off */
+  uint8 * stored;      /* likewise, set once the pixel's orbit is kept */
+};
+typedef struct resume_state ResumeState;
+
+
+/* Prepare rs for canvopts, loading the orbits of the last render by the
+   library tag if they match. rs->points stays NULL if canvopts asks for no
+   resume file. Returns 0 or RS_MALLOC. */
+int resume_begin(ResumeState * rs, CanvasOpts * canvopts, const char * tag);
+
+/* Copy the stored orbits of the pixels a canvas mirror copies: conjugate
+   for the real axis (z -> conj(z)), unchanged when the map is even in z
+   and the pixels mirror through the origin (a Julia set) */
+void resume_mirror(ResumeState * rs, Mirror * m, int conjugate);
+
+/* Write the file for canvopts if every pixel was stored, then free rs. A
+   file that cannot be written is reported in the debug output only: the
+   render itself is complete. */
+void resume_end(ResumeState * rs, CanvasOpts * canvopts);
+
+
+/* resume off, for renders that cannot take it up */
+static inline void resume_none(ResumeState * rs)
+{
+  rs->start = 0;
+  rs->points = NULL;
+  rs->stored = NULL;
+}
+
+
+static inline int resume_loaded(const ResumeState * rs)
+{
+  return (rs->points != NULL) && (rs->start > 0);
+}
+
+
+static inline ResumePoint * resume_at(ResumeState * rs, uint32 i, uint32 j)
+{
+  return &(rs->points[(uint64)i * rs->ny + j]);
+}
+
+
+/* a loaded orbit that has escaped or is known to be periodic is final */
+static inline int resume_final(const ResumeState * rs, const ResumePoint * rp)
+{
+  return (rp->n < rs->start) || (rp->period != 0);
+}
+
+
+/* store the orbits of pixels (i, j) to (i, j+m-1) */
+static inline void resume_store(ResumeState * rs,
+				uint32 i,
+				uint32 j,
+				uint32 m,
+				const float64 * zre,
+				const float64 * zim,
+				const uint32 * n,
+				const uint32 * period)
+{
+  ResumePoint * rp = resume_at(rs, i, j);
+  uint8 * st = &(rs->stored[(uint64)i * rs->ny + j]);
+  uint32 b;
+
+  for (b=0; b<m; b++) {
+    rp[b].zre = zre[b];
+    rp[b].zim = zim[b];
+    rp[b].n = n[b];
+    rp[b].period = period[b];
+    st[b] = 1;
+  }
+}
+
+
+#endif /* RESUME_H */
@@ -0,0 +1,183 @@
+/****************************************************************************/
+/* subdivide.c: Mariani-Silver subdivision for FRASCR libraries             */
+/*   The border of the region is computed first. Each rectangle is then     */
+/*   handed down with its border already known, so that splitting it costs  */
+/*   one column and one row, shared by the four parts. See subdivide.h.     */
+/*   Last updated: 2024 May                                                 */
+/****************************************************************************/
+/*  Author: Miguel Abele                                                    */
+/*  Copyrighted by Miguel Abele, 2024.                                      */
+/*                                                                          */
+/*  License information:                                                    */
+/*                                                                          */
+/*  This file is a part of the FRASCR application.                          */
+/*                                                                          */
+/*  FRASCR is free software; you can redistribute it and/or                 */
+/*  modify it under the terms of the GNU General Public License             */
+/*  as published by the Free Software Foundation; either version 3          */
+/*  of the License, or (at your option) any later version.                  */
+/*                                                                          */
+/*  FRASCR is distributed in the hope that it will be useful,               */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of          */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           */
+/*  GNU General Public License for more details.                            */
+/*                                                                          */
+/*  You should have received a copy of the GNU General Public License       */
+/*  along with this program; if not, write to the Free Software             */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor,                      */
+/*  Boston, MA  02110-1301, USA.                                            */
+/****************************************************************************/
+
+
+#include "subdivide.h"
+
+
+static inline Datum * sub_at(SubRegion * sr, int k, uint32 i, uint32 j)
+{
+  return &(sr->canv[k][(i - sr->i0)*sr->stride + (j - sr->j0)]);
+}
+
+
+
+static inline void sub_compute(SubRegion * sr, uint32 i0, uint32 j0, uint32 w, uint32 h)
+{
+  if ((w > 0) && (h > 0))
+    sr->compute(sr->context, i0, j0, w, h);
+}
+
+
+
+/* does pixel (i,j) hold the values in ref, in every canvas? */
+static inline int sub_same(SubRegion * sr, const uint32 * ref, uint32 i, uint32 j)
+{
+  int k;
+  for (k=0; k<sr->canvl; k++)
+    if (sub_at(sr, k, i, j)->n != ref[k])
+      return 0;
+  return 1;
+}
+
+
+
+static int sub_border_uniform(SubRegion * sr, const uint32 * ref,
+			      uint32 x, uint32 y, uint32 w, uint32 h)
+{
+  uint32 i, j;
+  for (j=y; j<y+h; j++)
+    if (!sub_same(sr, ref, x, j) || !sub_same(sr, ref, x+w-1, j))
+      return 0;
+  for (i=x+1; i<x+w-1; i++)
+    if (!sub_same(sr, ref, i, y) || !sub_same(sr, ref, i, y+h-1))
+      return 0;
+  return 1;
+}
+
+
+
+static void sub_fill(SubRegion * sr, const uint32 * ref,
+		     uint32 x, uint32 y, uint32 w, uint32 h)
+{
+  Datum * d;
+  uint32 i, j;
+  int k;
+  for (k=0; k<sr->canvl; k++) {
+    for (i=x+1; i<x+w-1; i++) {
+      for (j=y+1; j<y+h-1; j++) {
+	d = sub_at(sr, k, i, j);
+	d->re = sub_at(sr, k, i, y)->re;
+	d->im = sub_at(sr, k, x, j)->im;
+	d->n = ref[k];
+      }
+    }
+  }
+}
+
+
+
+/* compute a few pixels of the interior, the center first, and compare */
+static int sub_verify(SubRegion * sr, const uint32 * ref,
+		      uint32 x, uint32 y, uint32 w, uint32 h)
+{
+  uint32 s, i, j, seed;
+
+  seed = x*2654435761u ^ y*40503u;
+  for (s=0; s<SUB_SAMPLES; s++) {
+    if (s == 0) {
+      i = x + w/2;
+      j = y + h/2;
+    } else {
+      seed = seed*1664525u + 1013904223u;
+      i = x + 1 + (seed >> 8) % (w-2);
+      seed = seed*1664525u + 1013904223u;
+      j = y + 1 + (seed >> 8) % (h-2);
+    }
+    sr->compute(sr->context, i, j, 1, 1);
+    if (!sub_same(sr, ref, i, j))
+      return 0;
+  }
+  return 1;
+}
+
+
+
+/* the rectangle's border is known; fill or compute its interior */
+static uint64 sub_rect(SubRegion * sr, uint32 x, uint32 y, uint32 w, uint32 h)
+{
+  uint32 ref[SUB_MAXCANV];
+  uint32 xm, ym;
+  uint64 filled, interior;
+  int k;
+
+  if ((w <= 2) || (h <= 2))
+    return 0;
+
+  /* an interior no larger than the samples is as cheap to compute as to
+     verify, and the samples would cover it, or land on it twice */
+  interior = (uint64)(w-2)*(h-2);
+  for (k=0; k<sr->canvl; k++)
+    ref[k] = sub_at(sr, k, x, y)->n;
+  if (((sr->verify != SUB_VERIFY) || (interior > SUB_SAMPLES))
+      && sub_border_uniform(sr, ref, x, y, w, h)) {
+    sub_fill(sr, ref, x, y, w, h);
+    if (sr->verify != SUB_VERIFY)
+      return interior;
+    if (sub_verify(sr, ref, x, y, w, h))
+      return interior - SUB_SAMPLES;
+  }
+
+  if ((w < SUB_MIN) || (h < SUB_MIN)) {
+    sub_compute(sr, x+1, y+1, w-2, h-2);
+    return 0;
+  }
+
+  xm = x + w/2;
+  ym = y + h/2;
+  sub_compute(sr, xm, y+1, 1, h-2);
+  sub_compute(sr, x+1, ym, xm-x-1, 1);
+  sub_compute(sr, xm+1, ym, x+w-2-xm, 1);
+
+  filled = sub_rect(sr, x, y, xm-x+1, ym-y+1);
+  filled += sub_rect(sr, xm, y, x+w-xm, ym-y+1);
+  filled += sub_rect(sr, x, ym, xm-x+1, y+h-ym);
+  filled += sub_rect(sr, xm, ym, x+w-xm, y+h-ym);
+  return filled;
+}
+
+
+
+uint64 subdivide(SubRegion * sr)
+{
+  uint32 x = sr->i0, y = sr->j0, w = sr->w, h = sr->h;
+
+  if ((w <= 2) || (h <= 2)) {
+    sub_compute(sr, x, y, w, h);
+    return 0;
+  }
+
+  sub_compute(sr, x, y, 1, h);
+  sub_compute(sr, x+w-1, y, 1, h);
+  sub_compute(sr, x+1, y, w-2, 1);
+  sub_compute(sr, x+1, y+h-1, w-2, 1);
+
+  return sub_rect(sr, x, y, w, h);
+}
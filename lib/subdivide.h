@@ -0,0 +1,90 @@
+/****************************************************************************/
+/* subdivide.h: Mariani-Silver subdivision for FRASCR libraries             */
+/*   Fills a rectangle of escape-time results by computing only borders.    */
+/*   A rectangle whose border pixels all have the same count (and the same  */
+/*   value in every other canvas) is filled with that value; any other is   */
+/*   split in four by a middle column and row, and so on down to small      */
+/*   rectangles, which are computed outright. This is sound where bands     */
+/*   of equal count have no holes, as for the quadratic Mandelbrot set,     */
+/*   short of features thinner than a pixel. With verification, a few       */
+/*   pixels of each filled rectangle are computed as well, and a mismatch   */
+/*   splits it after all.                                                   */
+/*   Last updated: 2024 May                                                 */
+/****************************************************************************/
+/*  Author: Miguel Abele                                                    */
+/*  Copyrighted by Miguel Abele, 2024.                                      */
+/*                                                                          */
+/*  License information:                                                    */
+/*                                                                          */
+/*  This file is a part of the FRASCR application.                          */
+/*                                                                          */
+/*  FRASCR is free software; you can redistribute it and/or                 */
+/*  modify it under the terms of the GNU General Public License             */
+/*  as published by the Free Software Foundation; either version 3          */
+/*  of the License, or (at your option) any later version.                  */
+/*                                                                          */
+/*  FRASCR is distributed in the hope that it will be useful,               */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of          */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           */
+/*  GNU General Public License for more details.                            */
+/*                                                                          */
+/*  You should have received a copy of the GNU General Public License       */
+/*  along with this program; if not, write to the Free Software             */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor,                      */
+/*  Boston, MA  02110-1301, USA.                                            */
+/****************************************************************************/
+
+
+#ifndef SUBDIVIDE_H
+#define SUBDIVIDE_H
+
+
+#include "utils.h"
+
+
+/* canvas option "subdivide" */
+#define SUB_OFF       0
+#define SUB_ON        1
+#define SUB_VERIFY    2
+
+/* rectangles narrower than this are computed rather than split */
+#define SUB_MIN       8
+
+/* pixels of each filled rectangle that are computed to check the fill */
+#define SUB_SAMPLES   4
+
+/* canvases one subdivision can fill at once */
+#define SUB_MAXCANV   4
+
+
+/* Computes the pixels [i0,i0+w) x [j0,j0+h) into all canvases */
+typedef void (*SubCompute)(void * context,
+			   uint32 i0,
+			   uint32 j0,
+			   uint32 w,
+			   uint32 h);
+
+
+/* The region [i0,i0+w) x [j0,j0+h): pixel (i,j) of canvas k is at
+   canv[k][(i-i0)*stride + (j-j0)]. Filled pixels get re from the top of
+   their column and im from the left of their row, the way the libraries
+   place them. */
+struct sub_region {
+  SubCompute compute;
+  void * context;
+  Datum * canv[SUB_MAXCANV];
+  int canvl;
+  uint32 i0, j0;
+  uint32 w, h;
+  uint32 stride;
+  int verify;           /* SUB_VERIFY to check filled rectangles */
+};
+typedef struct sub_region SubRegion;
+
+
+/* Fill the whole region; returns the number of pixels filled rather than
+   computed */
+uint64 subdivide(SubRegion * sr);
+
+
+#endif /* SUBDIVIDE_H */
@@ -0,0 +1,199 @@
+/****************************************************************************/
+/* symmetry.h: mirror symmetry of canvases for FRASCR libraries             */
+/*   The quadratic Mandelbrot set is symmetric about the real axis, and     */
+/*   every quadratic Julia set is symmetric through the origin. When the    */
+/*   pixel grid is symmetric about zero as well, the pixels on one side     */
+/*   that have a mirror image on the other are copied from it instead of    */
+/*   computed: the copies are the rows past the middle of the axis, so that */
+/*   libraries can leave out whole rows of their tiles.                     */
+/*   Last updated: 2024 May                                                 */
+/****************************************************************************/
+/*  Author: Miguel Abele                                                    */
+/*  Copyrighted by Miguel Abele, 2024.                                      */
+/*                                                                          */
+/*  License information:                                                    */
+/*                                                                          */
+/*  This file is a part of the FRASCR application.                          */
+/*                                                                          */
+/*  FRASCR is free software; you can redistribute it and/or                 */
+/*  modify it under the terms of the GNU General Public License             */
+/*  as published by the Free Software Foundation; either version 3          */
+/*  of the License, or (at your option) any later version.                  */
+/*                                                                          */
+/*  FRASCR is distributed in the hope that it will be useful,               */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of          */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           */
+/*  GNU General Public License for more details.                            */
+/*                                                                          */
+/*  You should have received a copy of the GNU General Public License       */
+/*  along with this program; if not, write to the Free Software             */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor,                      */
+/*  Boston, MA  02110-1301, USA.                                            */
+/****************************************************************************/
+
+
+#ifndef SYMMETRY_H
+#define SYMMETRY_H
+
+
+#include "options.h"
+#include <string.h>
+
+
+/* how far, in pixels, a grid may be from symmetric and still be mirrored */
+#define MIRROR_TOL    1.0e-6
+
+
+struct mirror {
+  uint32 i0, i1;       /* copies: pixels [i0,i1) x [j0,j1), none if j0 == j1 */
+  uint32 j0, j1;
+  int si, sj;          /* pixel (i,j) is a copy of (si-i, sj-j), or of
+			  (i, sj-j) when si < 0 */
+};
+typedef struct mirror Mirror;
+
+
+/* For the grid origin + k*span/n, the index sum s such that pixel s-k lies
+   at minus pixel k, or -1 if there is none with pixels on both sides */
+static inline int mirror_sum(float64 origin, float64 span, uint32 n)
+{
+  float64 s, r, d;
+  if ((n < 2) || (span <= 0.))
+    return -1;
+  s = -2.*origin*(float64)n/span;
+  if ((s < 0.5) || (s > (float64)(2*n) - 2.5))
+    return -1;
+  r = (float64)(uint32)(s + 0.5);
+  d = s - r;
+  if ((d > MIRROR_TOL) || (d < -MIRROR_TOL))
+    return -1;
+  return (int)r;
+}
+
+
+static inline void mirror_none(Mirror * m)
+{
+  m->i0 = m->i1 = 0;
+  m->j0 = m->j1 = 0;
+  m->si = m->sj = -1;
+}
+
+
+/* the rows past the middle that have a mirror row */
+static inline void mirror_band(Mirror * m, uint32 ny)
+{
+  m->j0 = m->sj/2 + 1;
+  m->j1 = (m->sj < ny ? m->sj + 1 : ny);
+}
+
+
+/* z -> conj(z): rows mirror about the real axis */
+static inline void mirror_conjugate(Mirror * m, CanvasOpts * canvopts)
+{
+  mirror_none(m);
+  m->sj = mirror_sum(canvopts->bottom, canvopts->height, canvopts->nheight);
+  if (m->sj < 0)
+    return;
+  m->i0 = 0;
+  m->i1 = canvopts->nwidth;
+  mirror_band(m, canvopts->nheight);
+}
+
+
+/* z -> -z: pixels mirror through the origin */
+static inline void mirror_point(Mirror * m, CanvasOpts * canvopts)
+{
+  uint32 nx = canvopts->nwidth;
+  mirror_none(m);
+  m->si = mirror_sum(canvopts->left, canvopts->width, nx);
+  m->sj = mirror_sum(canvopts->bottom, canvopts->height, canvopts->nheight);
+  if ((m->si < 0) || (m->sj < 0)) {
+    mirror_none(m);
+    return;
+  }
+  m->i0 = (m->si > nx-1 ? m->si - (nx-1) : 0);
+  m->i1 = (m->si < nx ? m->si + 1 : nx);
+  mirror_band(m, canvopts->nheight);
+}
+
+
+static inline uint64 mirror_count(Mirror * m)
+{
+  return (uint64)(m->i1 - m->i0) * (m->j1 - m->j0);
+}
+
+
+/* Rows [*a0,*a1) of the tile [x0,x0+w) x [y0,y0+h) are copies, and need
+   not be computed; both are y0+h if there are none */
+static inline void mirror_rows(Mirror * m,
+			       uint32 x0,
+			       uint32 y0,
+			       uint32 w,
+			       uint32 h,
+			       uint32 * a0,
+			       uint32 * a1)
+{
+  *a0 = *a1 = y0 + h;
+  if ((m->j0 == m->j1) || (x0 < m->i0) || (x0 + w > m->i1))
+    return;
+  if ((m->j0 >= y0 + h) || (m->j1 <= y0))
+    return;
+  *a0 = (m->j0 > y0 ? m->j0 : y0);
+  *a1 = (m->j1 < y0 + h ? m->j1 : y0 + h);
+}
+
+
+/* Clear rows [a0,a1) of the canvl canvases of a tile w x h from row y0,
+   laid out as for EXECUTE_TILE, which the library leaves out: the engine
+   still copies them to the canvases before TILE_COMPLETE mirrors them */
+static inline void mirror_clear(Datum * tile,
+				uint32 w,
+				uint32 h,
+				uint32 y0,
+				uint32 a0,
+				uint32 a1,
+				uint32 canvl)
+{
+  uint32 i, k;
+
+  if (a0 >= a1)
+    return;
+  for (k=0; k<canvl; k++)
+    for (i=0; i<w; i++)
+      memset(&(tile[k*w*h + i*h + (a0 - y0)]), 0, sizeof(Datum)*(a1 - a0));
+}
+
+
+/* Copy all canvases into the mirrored pixels. A copy takes the mirror
+   image of its source's coordinates, which the iteration honors exactly,
+   rather than its own place on the grid, which can be an ulp away.
+   Compact canvases keep no coordinates, so only the count is copied. */
+static inline void mirror_fill(Mirror * m, Canvas * canva, uint32 canvl)
+{
+  Datum * d, * s;
+  uint32 i, j, k, fi;
+
+  for (k=0; k<canvl; k++) {
+    if (canva[k].format != CANVAS_FULL) {
+      for (i=m->i0; i<m->i1; i++) {
+	fi = (m->si < 0 ? i : m->si - i);
+	for (j=m->j0; j<m->j1; j++)
+	  canvas_set_n(&(canva[k]), i, j, canvas_n(&(canva[k]), fi, m->sj - j));
+      }
+      continue;
+    }
+    for (i=m->i0; i<m->i1; i++) {
+      fi = (m->si < 0 ? i : m->si - i);
+      for (j=m->j0; j<m->j1; j++) {
+	s = canvas_at(&(canva[k]), fi, m->sj - j);
+	d = canvas_at(&(canva[k]), i, j);
+	d->re = (m->si < 0 ? s->re : 0. - s->re);
+	d->im = 0. - s->im;
+	d->n = s->n;
+      }
+    }
+  }
+}
+
+
+#endif /* SYMMETRY_H */
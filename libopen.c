@@ -77,12 +77,28 @@ int load_libraries(CoreOpts * opts, DParam * debug)
   if ( opts->lib_exec == NULL )
     return LOOPENFILEE;
   
+  /* the tile entry points are optional: when present, the core drives the
+     library tile by tile instead of calling its EXECUTE (see engine.h) */
+  opts->execute_tile = dlsym(opts->lib_exec, LO_EXEC_TILE);
+  dlerror();
+  if ( opts->execute_tile ) {
+    opts->tile_setup = dlsym(opts->lib_exec, LO_TILE_SET);
+    dlerror();
+    opts->tile_complete = dlsym(opts->lib_exec, LO_TILE_CMP);
+    dlerror();
+    opts->tile_cleanup = dlsym(opts->lib_exec, LO_TILE_CLN);
+    dlerror();
+  }
+
   opts->execute = dlsym(opts->lib_exec, LO_EXECUTE);
   strerror = dlerror();
   if ( strerror ) {
-    DEBUG(debug, D0, "libopen::open_shared_ob: exec function import error: %s.\n", strerror );
-    opts->lib_exec = NULL;
-    return LOLOADEXEC;
+    opts->execute = NULL;
+    if ( opts->execute_tile == NULL ) {
+      DEBUG(debug, D0, "libopen::open_shared_ob: exec function import error: %s.\n", strerror );
+      close_shared_ob(&(opts->lib_exec), debug);
+      return LOLOADEXEC;
+    }
   }
   
   if ( opts->fins != NULL ) {
@@ -112,6 +128,19 @@ int load_libraries(CoreOpts * opts, DParam * debug)
     close_shared_ob(&(opts->lib_fin), debug);
     return LOLOADFINS;
   }
+
+  /* the band entry points are optional, and only used all together */
+  opts->finish_begin = dlsym(altlib, LO_FIN_BEGIN);
+  dlerror();
+  opts->finish_band = dlsym(altlib, LO_FIN_BAND);
+  dlerror();
+  opts->finish_end = dlsym(altlib, LO_FIN_END);
+  dlerror();
+  if ( (opts->finish_begin==NULL) || (opts->finish_band==NULL) || (opts->finish_end==NULL) ) {
+    opts->finish_begin = NULL;
+    opts->finish_band = NULL;
+    opts->finish_end = NULL;
+  }
   
   return 0;
 }
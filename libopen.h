@@ -35,8 +35,15 @@
 #include "options.h"
 
 #define LO_EXECUTE   "EXECUTE"
+#define LO_EXEC_TILE "EXECUTE_TILE"
+#define LO_TILE_SET  "TILE_SETUP"
+#define LO_TILE_CMP  "TILE_COMPLETE"
+#define LO_TILE_CLN  "TILE_CLEANUP"
 #define LO_FINISH    "FINISH"
 #define LO_VALIDATE  "VALIDATE"
+#define LO_FIN_BEGIN "FINISH_BEGIN"
+#define LO_FIN_BAND  "FINISH_BAND"
+#define LO_FIN_END   "FINISH_END"
 #define LONULLARG    -10
 #define LOOPENFILEE  -20
 #define LOOPENFILEF  -30
@@ -42,6 +42,8 @@
 #include "utils.h"
 #include "options.h"
 #include "libopen.h"
+#include "engine.h"
+#include "animation.h"
 
 
 void error_switcher(int e, DParam * debug)
@@ -77,6 +79,12 @@ void error_switcher(int e, DParam * debug)
       case OPT_CONF_CLR_REF:
 	DEBUG(debug, D0, "frascr::main: option processing encountered error: configuration file, missing / error in color reference (illuminant) options\n", e);
 	break;
+      case OPT_CONF_ANIM:
+	DEBUG(debug, D0, "frascr::main: option processing encountered error: configuration file, missing / error in animation options or keyframes\n");
+	break;
+      case OPT_CONF_VIS:
+	DEBUG(debug, D0, "frascr::main: option processing encountered error: configuration file, unknown compression level\n");
+	break;
       default:
 	DEBUG(debug, D0, "frascr::main: option processing encountered error %d: unknown\n", e);
 	break;
@@ -99,6 +107,7 @@ int main(int argc, char ** argv)
   debug.outs = NULL;
   options_core_initialize(&general);
   options_canvas_initialize(&palette);
+  palette.debug = &debug;
 
   /* cmdline arg processing */
   if (argc > 1) {
@@ -116,14 +125,18 @@ int main(int argc, char ** argv)
                          \nfrascr::main: nwidth %d\nfrascr::main: left %f\
                          \nfrascr::main: width %f\nfrascr::main: bottom %f\
                          \nfrascr::main: coord_Re %f\nfrascr::main: coord_Im %f\
-                         \nfrascr::main: escape %d\n",
+                         \nfrascr::main: escape %d\nfrascr::main: threads %d\
+			 \nfrascr::main: periodicity %d\nfrascr::main: subdivide %d\
+			 \nfrascr::main: compact %d\nfrascr::main: stream %d\n",
 	    debug.mask, debug.outs,
 	    general.execs,
 	    general.fins, palette.nheight,
 	    palette.nwidth, palette.left,
 	    palette.width, palette.bottom,
 	    palette.coord_Re, palette.coord_Im,
-	    palette.escape);
+	    palette.escape, palette.threads,
+	    palette.periodicity, palette.subdivide,
+	    palette.compact, palette.stream);
     }
     DEBUGFLUSH(&debug);
   }
@@ -152,21 +165,30 @@ int main(int argc, char ** argv)
     return EXIT_SUCCESS;
   }
 
-  /* Call EXECUTE */
+  /* Call EXECUTE, or drive the library by tiles if it can be */
   
-  DEBUG(&debug, D1, "frascr::main: executing library algorithm\n");
-  retbuf = (*(general.execute))(&palette,
-				general.finish,
-				general.validate,
-				general.outs,
-				general.outl);
+  palette.algorithm = general.execs;
+  if (general.animation) {
+    DEBUG(&debug, D1, "frascr::main: executing library algorithm frame by frame\n");
+    retbuf = animate(&general, &palette, &debug);
+  } else if (general.execute_tile) {
+    DEBUG(&debug, D1, "frascr::main: executing library algorithm by tiles\n");
+    retbuf = execute_tiles(&general, &palette, &debug);
+  } else {
+    DEBUG(&debug, D1, "frascr::main: executing library algorithm\n");
+    retbuf = (*(general.execute))(&palette,
+				  general.finish,
+				  general.validate,
+				  general.outs,
+				  general.outl);
+  }
   if (retbuf != 0) 
     DEBUG(&debug, D0, "frascr::main: error in library executing algorithm: %d\n", retbuf);
 
   /* clean up & exit */
 
   DEBUG(&debug, D1, "frascr::main: Closing libraries.\n");
-  if (general.execute) {
+  if (general.lib_exec) {
     close_libraries(&general, &debug);
   }
   /* (the rest is currently unnecessary) */
@@ -132,6 +132,38 @@ static inline void read_chrs16(json_object * obj, int n, void * swatch) {
 }
 
 
+static inline int strategy_to_strategy(const char * name) {
+  if (name == NULL)
+    return VIS_STRATEGY_DEFAULT;
+  if (strcmp("filtered", name) == 0)
+    return VIS_STRATEGY_FILTERED;
+  if (strcmp("huffman", name) == 0)
+    return VIS_STRATEGY_HUFFMAN;
+  if (strcmp("rle", name) == 0)
+    return VIS_STRATEGY_RLE;
+  return VIS_STRATEGY_DEFAULT;
+}
+
+
+/* png filter names to a VIS_FILTER mask; unknown names are skipped */
+static inline int read_filters(json_object * obj) {
+  static const char * names[5] = { "none", "sub", "up", "average", "paeth" };
+  const char * name;
+  int i, k, n, mask = 0;
+  n = json_object_array_length(obj);
+  for (i=0; i<n; i++) {
+    name = json_object_get_string(json_object_array_get_idx(obj, i));
+    if (name == NULL)
+      continue;
+    for (k=0; k<5; k++) {
+      if (strcmp(names[k], name) == 0)
+	mask |= (1 << k);
+    }
+  }
+  return (mask ? mask : VIS_FILTER_ALL);
+}
+
+
 static inline int extend_the_str_list(char *** target, int * len) {
   int i, newlen;
   newlen = 2*(*len);
@@ -214,6 +246,135 @@ static inline int parse_secondary_args_from_cmdline(CanvasOpts * canv, char * in
 }
 
 
+static inline void read_optional_dbl(json_object * obj, const char * name, float64 * target) {
+  json_object * minor = json_object_object_get(obj, name);
+  if (json_object_get_type(minor) != json_type_null)
+    *target = json_object_get_double(minor);
+}
+
+
+/* a keyframe starts as the one before it, then takes the values given */
+static inline int read_keyframe(json_object * obj, Keyframe * key, const Keyframe * prev) {
+  json_object * minor, * sub;
+  uint32 i;
+
+  *key = *prev;
+  key->secondary = NULL;
+  minor = json_object_object_get(obj, "frame");
+  if (json_object_get_type(minor) == json_type_null)
+    return -1;
+  key->frame = json_object_get_int(minor);
+  read_optional_dbl(obj, "left", &(key->left));
+  read_optional_dbl(obj, "bottom", &(key->bottom));
+  read_optional_dbl(obj, "realwidth", &(key->width));
+  read_optional_dbl(obj, "realheight", &(key->height));
+  read_optional_dbl(obj, "offset_Re", &(key->coord_Re));
+  read_optional_dbl(obj, "offset_Im", &(key->coord_Im));
+  minor = json_object_object_get(obj, "escape");
+  if (json_object_get_type(minor) != json_type_null)
+    key->escape = (uint32)json_object_get_int(minor);
+
+  minor = json_object_object_get(obj, "secondary");
+  if (json_object_get_type(minor) != json_type_null)
+    key->secondaryl = json_object_array_length(minor);
+  else if (prev->secondary == NULL)
+    key->secondaryl = 0;
+  if (key->secondaryl == 0)
+    return 0;
+  key->secondary = calloc(key->secondaryl, sizeof(char *));
+  if (key->secondary == NULL)
+    return -1;
+  for (i=0; i<key->secondaryl; i++) {
+    if (json_object_get_type(minor) != json_type_null) {
+      sub = json_object_array_get_idx(minor, i);
+      key->secondary[i] = strndup(json_object_get_string(sub), 255);
+    } else {
+      key->secondary[i] = strndup(prev->secondary[i], 255);
+    }
+    if (key->secondary[i] == NULL)
+      return -1;
+  }
+  return 0;
+}
+
+
+static inline void options_animation_cleanup(AnimationOpts * anim) {
+  uint32 k, i;
+  if (anim == NULL)
+    return;
+  if (anim->keys) {
+    for (k=0; k<anim->keyl; k++) {
+      if (anim->keys[k].secondary) {
+	for (i=0; i<anim->keys[k].secondaryl; i++)
+	  free(anim->keys[k].secondary[i]);
+	free(anim->keys[k].secondary);
+      }
+    }
+    free(anim->keys);
+  }
+  free(anim);
+}
+
+
+/* the "animation" section: keyframes in increasing frame order, each
+   filled in from the one before it and the first from the canvas */
+static int read_animation(json_object * major, CanvasOpts * canv, AnimationOpts ** target) {
+  AnimationOpts * anim;
+  Keyframe first;
+  json_object * minor;
+  const char * name;
+  uint32 k;
+
+  anim = calloc(1, sizeof(AnimationOpts));
+  if (anim == NULL)
+    return OPT_CONF_MALLOC;
+  *target = anim;
+
+  minor = json_object_object_get(major, "frames");
+  anim->frames = (uint32)json_object_get_int(minor);
+  minor = json_object_object_get(major, "interpolation");
+  name = (json_object_get_type(minor) == json_type_null ? "zoom" : json_object_get_string(minor));
+  if (strcmp("linear", name) == 0)
+    anim->interpolation = ANIM_LINEAR;
+  else if (strcmp("zoom", name) == 0)
+    anim->interpolation = ANIM_ZOOM;
+  else
+    return OPT_CONF_ANIM;
+
+  minor = json_object_object_get(major, "keyframes");
+  if ((anim->frames == 0) || (json_object_get_type(minor) != json_type_array))
+    return OPT_CONF_ANIM;
+  anim->keyl = json_object_array_length(minor);
+  if (anim->keyl == 0)
+    return OPT_CONF_ANIM;
+  anim->keys = calloc(anim->keyl, sizeof(Keyframe));
+  if (anim->keys == NULL)
+    return OPT_CONF_MALLOC;
+
+  first.frame = 0;
+  first.left = canv->left;
+  first.width = canv->width;
+  first.bottom = canv->bottom;
+  first.height = canv->height;
+  first.coord_Re = canv->coord_Re;
+  first.coord_Im = canv->coord_Im;
+  first.escape = canv->escape;
+  /* secondaryl is -1 when the canvas has no secondary options */
+  first.secondaryl = (canv->secondary ? canv->secondaryl : 0);
+  first.secondary = canv->secondary;
+  for (k=0; k<anim->keyl; k++) {
+    if (read_keyframe(json_object_array_get_idx(minor, k), &(anim->keys[k]),
+		      (k == 0 ? &first : &(anim->keys[k-1]))))
+      return OPT_CONF_ANIM;
+    if ((anim->keys[k].frame >= anim->frames)
+	|| ((k > 0) && (anim->keys[k].frame <= anim->keys[k-1].frame))
+	|| (anim->keys[k].width <= 0.) || (anim->keys[k].height <= 0.))
+      return OPT_CONF_ANIM;
+  }
+  return 0;
+}
+
+
 int file_reader(CoreOpts * core,
 		CanvasOpts * canv,
 		DParam * debug,
@@ -301,6 +462,48 @@ int file_reader(CoreOpts * core,
   minor = json_object_object_get(major, "escape");
   canv->escape = (uint32)json_object_get_int(minor);
 
+  /* worker threads are optional: only some algorithms make use of them */
+
+  minor = json_object_object_get(major, "threads");
+  if (json_object_get_type(minor) != json_type_null)
+    canv->threads = json_object_get_int(minor);
+
+  /* cycle detection is on unless turned off */
+
+  minor = json_object_object_get(major, "periodicity");
+  if (json_object_get_type(minor) != json_type_null)
+    canv->periodicity = json_object_get_int(minor);
+
+  /* subdivision is off unless turned on */
+
+  minor = json_object_object_get(major, "subdivide");
+  if (json_object_get_type(minor) != json_type_null)
+    canv->subdivide = json_object_get_int(minor);
+
+  /* canvases hold the full Datum unless compact ones are asked for */
+
+  minor = json_object_object_get(major, "compact");
+  if (json_object_get_type(minor) != json_type_null)
+    canv->compact = json_object_get_int(minor);
+
+  /* the whole canvas goes to the finisher at once unless bands are asked for */
+
+  minor = json_object_object_get(major, "stream");
+  if (json_object_get_type(minor) != json_type_null)
+    canv->stream = json_object_get_int(minor);
+
+  /* orbits are not kept for a later render unless a file is given for them */
+
+  minor = json_object_object_get(major, "resume");
+  if (json_object_get_type(minor) != json_type_null)
+    canv->resume = strndup(json_object_get_string(minor), 255);
+
+  /* nor are renders kept to reuse their pixels unless a directory is given */
+
+  minor = json_object_object_get(major, "cache");
+  if (json_object_get_type(minor) != json_type_null)
+    canv->cache = strndup(json_object_get_string(minor), 255);
+
   /* secondary canvas information: will be passed to execute fctn, which must know how to use it */
   /* secondary is optional and might not be present */
   
@@ -340,6 +543,60 @@ int file_reader(CoreOpts * core,
   }
   minor = json_object_object_get(major, "compression");
   canv->visuals.compression = json_object_get_int(minor);
+  /* graded compression -- optional, "compression" is on/off otherwise */
+  minor = json_object_object_get(major, "level");
+  if (json_object_get_type(minor) == json_type_string) {
+    if (strcmp("auto", json_object_get_string(minor)) != 0) {
+      free(core->outs);
+      free(core->execs);
+      free(core->fins);
+      if (canv->secondary) {
+	while (canv->secondaryl > 0) {
+	  free(canv->secondary[--(canv->secondaryl)]);
+	}
+	free(canv->secondary);
+      }
+      json_object_put(root);
+      return OPT_CONF_VIS;
+    }
+    canv->visuals.level = VIS_LEVEL_AUTO;
+  } else {
+    canv->visuals.level = (json_object_get_type(minor) != json_type_null ?
+			   json_object_get_int(minor) : -1);
+    /* absent or out of range: as "compression" says */
+    if ((canv->visuals.level < 0) || (canv->visuals.level > 9))
+      canv->visuals.level = (canv->visuals.compression == 0 ? 0 : 9);
+  }
+  minor = json_object_object_get(major, "strategy");
+  if (json_object_get_type(minor) != json_type_null)
+    canv->visuals.strategy = strategy_to_strategy(json_object_get_string(minor));
+  minor = json_object_object_get(major, "filters");
+  if (json_object_get_type(minor) == json_type_array)
+    canv->visuals.filters = read_filters(minor);
+  minor = json_object_object_get(major, "target");
+  if (json_object_get_type(minor) != json_type_null)
+    canv->visuals.target = json_object_get_double(minor);
+  minor = json_object_object_get(major, "indexed");
+  if (json_object_get_type(minor) != json_type_null)
+    canv->visuals.indexed = json_object_get_int(minor);
+  minor = json_object_object_get(major, "framerate");
+  if (json_object_get_type(minor) != json_type_null)
+    canv->visuals.framerate = (uint32)json_object_get_int(minor);
+  if (canv->visuals.framerate == 0)
+    canv->visuals.framerate = 25;
+  /* tile pyramid -- optional, for libdzi.so */
+  minor = json_object_object_get(major, "pyramid");
+  if (json_object_get_type(minor) != json_type_null) {
+    sub = json_object_object_get(minor, "tiles");
+    if (json_object_get_type(sub) != json_type_null)
+      canv->visuals.tiles = strndup(json_object_get_string(sub), 255);
+    sub = json_object_object_get(minor, "tilesize");
+    if (json_object_get_type(sub) != json_type_null)
+      canv->visuals.tilesize = (uint32)json_object_get_int(sub);
+    sub = json_object_object_get(minor, "overlap");
+    if (json_object_get_type(sub) != json_type_null)
+      canv->visuals.overlap = (uint32)json_object_get_int(sub);
+  }
   minor = json_object_object_get(major, "channeldepth");
   canv->visuals.depth = json_object_get_int(minor);
 
@@ -363,6 +620,11 @@ int file_reader(CoreOpts * core,
     }
     sub = json_object_object_get(minor, "space");
     canv->visuals.colors->space = space_to_space(json_object_get_string(sub));
+    sub = json_object_object_get(minor, "gamma");
+    if (json_object_get_type(sub) == json_type_null)
+      canv->visuals.colors->gamma = GAMMA_EXACT;
+    else
+      canv->visuals.colors->gamma = gamma_to_gamma(json_object_get_string(sub));
     if (canv->visuals.colors->space != MONO) {
       sub = json_object_object_get(minor, "illuminant");
       canv->visuals.colors->reference = illum_to_illum(json_object_get_string(sub));
@@ -440,6 +702,28 @@ int file_reader(CoreOpts * core,
     }
   }
 
+  /* animation -- optional: frames of a fly-through rather than one image */
+
+  major = json_object_object_get(root, "animation");
+  if (json_object_get_type(major) != json_type_null) {
+    i = read_animation(major, canv, &(core->animation));
+    if (i != 0) {
+      options_animation_cleanup(core->animation);
+      core->animation = NULL;
+      json_object_put(root);
+      free(core->outs);
+      free(core->execs);
+      free(core->fins);
+      if (canv->secondary) {
+	while (canv->secondaryl > 0) {
+	  free(canv->secondary[--(canv->secondaryl)]);
+	}
+	free(canv->secondary);
+      }
+      return i;
+    }
+  }
+
   /* done */
 
   json_object_put(root);
@@ -484,6 +768,13 @@ int process_options(CoreOpts * core,
       {"offsetre", required_argument, 0, 'x'},
       {"offsetim", required_argument, 0, 'y'},
       {"secondary", required_argument, 0, 's'},
+      {"threads", required_argument, 0, 't'},
+      {"periodicity", required_argument, 0, 'p'},
+      {"subdivide", required_argument, 0, 'd'},
+      {"compact", required_argument, 0, 'c'},
+      {"stream", required_argument, 0, 'r'},
+      {"resume", required_argument, 0, 'u'},
+      {"cache", required_argument, 0, 'k'},
       {0, 0, 0, 0}
     };
 
@@ -491,7 +782,7 @@ int process_options(CoreOpts * core,
 
     ret = getopt_long(num,
 		      args,
-		      "b:e:f:hi:j:l:m:n:s:vx:y:E:F:",
+		      "b:c:d:e:f:hi:j:k:l:m:n:p:r:s:t:u:vx:y:E:F:",
 		      long_options,
 		      &option_index);
 
@@ -550,6 +841,38 @@ int process_options(CoreOpts * core,
 	  if (parse_secondary_args_from_cmdline(canv, optarg))
 	    return OPT_BAD_OPTION;
 	break;
+      case 't':
+	if (optarg)
+	  canv->threads = atoi(optarg);
+	break;
+      case 'p':
+	if (optarg)
+	  canv->periodicity = atoi(optarg);
+	break;
+      case 'd':
+	if (optarg)
+	  canv->subdivide = atoi(optarg);
+	break;
+      case 'c':
+	if (optarg)
+	  canv->compact = atoi(optarg);
+	break;
+      case 'r':
+	if (optarg)
+	  canv->stream = atoi(optarg);
+	break;
+      case 'u':
+	if (optarg) {
+	  free(canv->resume);
+	  canv->resume = strndup(optarg, 255);
+	}
+	break;
+      case 'k':
+	if (optarg) {
+	  free(canv->cache);
+	  canv->cache = strndup(optarg, 255);
+	}
+	break;
       case 'v':
 	verbose++;
 	break;
@@ -604,7 +927,16 @@ int process_options(CoreOpts * core,
 static inline void options_visuals_initialize(VisualizationOpts * v) {
   v->colors = NULL;
   v->compression = 1;
+  v->level = 9;
+  v->strategy = VIS_STRATEGY_DEFAULT;
+  v->filters = VIS_FILTER_ALL;
+  v->target = 1.1;
+  v->indexed = 1;
   v->depth = 8;
+  v->framerate = 25;
+  v->tiles = NULL;
+  v->tilesize = 254;
+  v->overlap = 1;
 }
 
 
@@ -619,6 +951,15 @@ void options_canvas_initialize(CanvasOpts * canv) {
   canv->left = 0.0;
   canv->coord_Re = 0.0;
   canv->coord_Im = 0.0;
+  canv->threads = 1;
+  canv->periodicity = 0;
+  canv->subdivide = 0;
+  canv->compact = 0;
+  canv->stream = 0;
+  canv->resume = NULL;
+  canv->cache = NULL;
+  canv->debug = NULL;
+  canv->algorithm = NULL;
   canv->secondary = NULL;
   canv->secondaryl = -1;
   options_visuals_initialize(&(canv->visuals));
@@ -628,12 +969,20 @@ void options_canvas_initialize(CanvasOpts * canv) {
 void options_core_initialize(CoreOpts * core) {
   core->execs = NULL;
   core->execute = NULL;
+  core->execute_tile = NULL;
+  core->tile_setup = NULL;
+  core->tile_complete = NULL;
+  core->tile_cleanup = NULL;
   core->lib_exec = NULL;
   core->finish = NULL;
+  core->finish_begin = NULL;
+  core->finish_band = NULL;
+  core->finish_end = NULL;
   core->lib_fin = NULL;
   core->fins = NULL;
   core->validate = NULL;
   core->outs = NULL;
+  core->animation = NULL;
 }
 
 
@@ -651,6 +1000,8 @@ void options_core_cleanup(CoreOpts * core)
       if (core->outs[i])
 	free(core->outs[i]);
   }
+  options_animation_cleanup(core->animation);
+  core->animation = NULL;
 }
 
 
@@ -686,6 +1037,8 @@ static inline void options_visuals_cleanup(VisualizationOpts * v) {
     free(v->colors);
     v->colors = NULL;
   }
+  free(v->tiles);
+  v->tiles = NULL;
 }
 
 
@@ -694,6 +1047,10 @@ void options_canvas_cleanup(CanvasOpts * canv)
 {
   int i;
   options_visuals_cleanup(&(canv->visuals));
+  free(canv->resume);
+  canv->resume = NULL;
+  free(canv->cache);
+  canv->cache = NULL;
   if (canv->secondary) {
     while (canv->secondaryl > 0) {
       free(canv->secondary[--(canv->secondaryl)]);
@@ -32,16 +32,49 @@
 #include "color.h"
 #include "options.h"
 
+/* animation: canvas values at some frames, interpolated in between */
+#define ANIM_LINEAR     0
+#define ANIM_ZOOM       1
+
+struct keyframe {
+  uint32 frame;
+  float64 left, width;
+  float64 bottom, height;
+  float64 coord_Re, coord_Im;
+  uint32 escape;
+  uint32 secondaryl;
+  char ** secondary;
+};
+typedef struct keyframe Keyframe;
+
+struct animationopts {
+  uint32 frames;
+  int interpolation;    /* ANIM_LINEAR, or ANIM_ZOOM: sizes change by a
+			   constant factor per frame, the center with them */
+  uint32 keyl;
+  Keyframe * keys;      /* every value filled in, in frame order */
+};
+typedef struct animationopts AnimationOpts;
+
+
 struct coreopts {
   void * lib_exec;
   int (*execute)();
+  int (*execute_tile)();
+  int (*tile_setup)();
+  int (*tile_complete)();
+  void (*tile_cleanup)();
   char * execs;
   void * lib_fin;
   int (*finish)();
+  int (*finish_begin)();
+  int (*finish_band)();
+  void (*finish_end)();
   char * fins;
   int (*validate)();
   char ** outs;
   int outl;
+  AnimationOpts * animation;    /* NULL for a single image */
 };
 typedef struct coreopts CoreOpts;
 
@@ -50,15 +83,39 @@ struct coloropts {
   SwatchGenMode mode;
   ColorSpace space;
   RefType reference;
+  GammaMode gamma;
   int swatch_n;
   void * swatch;
 };
 typedef struct coloropts ColorOpts;
 
 
+/* png compression, for the "level", "strategy" and "filters" keys; the
+   strategies are zlib's values, the filters one bit per png filter type */
+#define VIS_LEVEL_AUTO          -1
+#define VIS_STRATEGY_DEFAULT    0
+#define VIS_STRATEGY_FILTERED   1
+#define VIS_STRATEGY_HUFFMAN    2
+#define VIS_STRATEGY_RLE        3
+#define VIS_FILTER_NONE         0x01
+#define VIS_FILTER_SUB          0x02
+#define VIS_FILTER_UP           0x04
+#define VIS_FILTER_AVERAGE      0x08
+#define VIS_FILTER_PAETH        0x10
+#define VIS_FILTER_ALL          0x1f
+
 struct visualizationopts {
   int compression;
+  int level;          /* zlib level 0-9, or VIS_LEVEL_AUTO */
+  int strategy;
+  int filters;
+  float64 target;     /* auto: size allowed, relative to level 9 */
+  int indexed;        /* palette output when the colors fit */
   int depth;
+  uint32 framerate;   /* frames per second of a video output */
+  char * tiles;       /* directory of a tile pyramid, or NULL */
+  uint32 tilesize;    /* edge of a pyramid tile, not counting overlap */
+  uint32 overlap;     /* pixels a pyramid tile shares with each neighbour */
   ColorOpts * colors;
 };
 typedef struct visualizationopts VisualizationOpts;
@@ -70,6 +127,15 @@ struct canvasopts {
   float64 bottom, height;
   float64 coord_Re, coord_Im;
   uint32 escape;
+  int threads;
+  int periodicity;      /* 0 off, 1 cycle detection, 2 also a period canvas */
+  int subdivide;        /* 0 off, 1 border subdivision, 2 also verify fills */
+  int compact;          /* 0 full Datum canvases, 1 counts only (core-driven) */
+  uint32 stream;        /* rows per band streamed to the finisher, 0 off */
+  char * resume;        /* orbit state file for raising escape later, or NULL */
+  char * cache;         /* directory of past renders to reuse pixels from, or NULL */
+  DParam * debug;       /* for libraries' debug output, may be NULL */
+  char * algorithm;     /* the EXECUTE library, for finishers that record it */
   uint32 secondaryl;
   char ** secondary;
   VisualizationOpts visuals;
@@ -0,0 +1,273 @@
+/****************************************************************************/
+/* schedule.c: tile scheduling and worker threads for FRASCR application    */
+/*   Tiles are numbered column by column (matching the Datum column arrays) */
+/*   and dealt out to the workers in contiguous runs. A worker takes tiles  */
+/*   from the front of its own run; a worker with nothing left steals the   */
+/*   back half of the largest run still pending.                            */
+/*   Last updated: 2024 June                                                */
+/****************************************************************************/
+/*  Author: Miguel Abele                                                    */
+/*  Copyrighted by Miguel Abele, 2024.                                      */
+/*                                                                          */
+/*  License information:                                                    */
+/*                                                                          */
+/*  This file is a part of the FRASCR application.                          */
+/*                                                                          */
+/*  FRASCR is free software; you can redistribute it and/or                 */
+/*  modify it under the terms of the GNU General Public License             */
+/*  as published by the Free Software Foundation; either version 3          */
+/*  of the License, or (at your option) any later version.                  */
+/*                                                                          */
+/*  FRASCR is distributed in the hope that it will be useful,               */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of          */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           */
+/*  GNU General Public License for more details.                            */
+/*                                                                          */
+/*  You should have received a copy of the GNU General Public License       */
+/*  along with this program; if not, write to the Free Software             */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor,                      */
+/*  Boston, MA  02110-1301, USA.                                            */
+/****************************************************************************/
+
+
+#include "schedule.h"
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+
+struct tile_run {
+  pthread_mutex_t lock;
+  uint32 head;   /* next tile to be taken by the owner */
+  uint32 tail;   /* one past the last tile of the run */
+};
+typedef struct tile_run TileRun;
+
+
+struct tile_pool {
+  TileRun * runs;
+  int nworkers;
+  uint32 nx, ny;
+  uint32 tilew, tileh;
+  uint32 tilesy;
+  TileWork work;
+  void * context;
+  int error;
+};
+typedef struct tile_pool TilePool;
+
+
+struct tile_worker {
+  TilePool * pool;
+  int id;
+};
+typedef struct tile_worker TileWorker;
+
+
+
+static inline int run_tile(TilePool * pool, int worker, uint32 t)
+{
+  uint32 x0, y0, w, h;
+  x0 = (t / pool->tilesy) * pool->tilew;
+  y0 = (t % pool->tilesy) * pool->tileh;
+  w = (x0 + pool->tilew > pool->nx ? pool->nx - x0 : pool->tilew);
+  h = (y0 + pool->tileh > pool->ny ? pool->ny - y0 : pool->tileh);
+  return pool->work(pool->context, worker, x0, y0, w, h);
+}
+
+
+
+/* take the next tile of this worker's own run */
+static inline int take_own(TileRun * run, uint32 * t)
+{
+  int found = 0;
+  pthread_mutex_lock(&(run->lock));
+  if (run->head < run->tail) {
+    *t = run->head;
+    __atomic_store_n(&(run->head), *t + 1, __ATOMIC_RELAXED);
+    found = 1;
+  }
+  pthread_mutex_unlock(&(run->lock));
+  return found;
+}
+
+
+
+/* move the back half of the largest pending run into this worker's run */
+static inline int steal(TilePool * pool, int id)
+{
+  int i, victim;
+  uint32 head, tail, left, most, take;
+  TileRun * run;
+
+  for (;;) {
+    victim = -1;
+    most = 0;
+    for (i=0; i<pool->nworkers; i++) {
+      if (i == id)
+	continue;
+      run = &(pool->runs[i]);
+      /* unlocked read is only a hint; it is checked again under the lock.
+	 head and tail are stored atomically under it for these reads */
+      head = __atomic_load_n(&(run->head), __ATOMIC_RELAXED);
+      tail = __atomic_load_n(&(run->tail), __ATOMIC_RELAXED);
+      left = tail - head;
+      if ((head < tail) && (left > most)) {
+	most = left;
+	victim = i;
+      }
+    }
+    if (victim < 0)
+      return 0;
+
+    run = &(pool->runs[victim]);
+    pthread_mutex_lock(&(run->lock));
+    if (run->head >= run->tail) {
+      pthread_mutex_unlock(&(run->lock));
+      continue;
+    }
+    left = run->tail - run->head;
+    take = (left + 1) / 2;
+    tail = run->tail - take;
+    __atomic_store_n(&(run->tail), tail, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&(run->lock));
+
+    /* tail is the local copy: once unlocked, run->tail may move again */
+    run = &(pool->runs[id]);
+    pthread_mutex_lock(&(run->lock));
+    __atomic_store_n(&(run->head), tail, __ATOMIC_RELAXED);
+    __atomic_store_n(&(run->tail), tail + take, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&(run->lock));
+    return 1;
+  }
+}
+
+
+
+static void * worker_main(void * arg)
+{
+  TileWorker * me = (TileWorker *)arg;
+  TilePool * pool = me->pool;
+  uint32 t;
+  int ret, none;
+
+  do {
+    while (take_own(&(pool->runs[me->id]), &t)) {
+      if (__atomic_load_n(&(pool->error), __ATOMIC_RELAXED))
+	return NULL;
+      ret = run_tile(pool, me->id, t);
+      if (ret) {
+	none = 0;
+	__atomic_compare_exchange_n(&(pool->error), &none, ret, 0,
+				    __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+	return NULL;
+      }
+    }
+  } while (steal(pool, me->id));
+
+  return NULL;
+}
+
+
+
+int schedule_threads(int requested)
+{
+  long online;
+  if (requested > 0)
+    return requested;
+  online = sysconf(_SC_NPROCESSORS_ONLN);
+  return (online > 0 ? (int)online : 1);
+}
+
+
+
+int schedule_tiles(uint32 nx,
+		   uint32 ny,
+		   uint32 tilew,
+		   uint32 tileh,
+		   int nthreads,
+		   TileWork work,
+		   void * context)
+{
+  TilePool pool;
+  TileWorker * workers = NULL;
+  pthread_t * threads = NULL;
+  uint32 ntiles, t, share, extra, start;
+  int i, started, ret;
+
+  if ((work==NULL) || (tilew==0) || (tileh==0))
+    return SCHED_BAD_CALL;
+  if ((nx==0) || (ny==0))
+    return 0;
+
+  pool.nx = nx;
+  pool.ny = ny;
+  pool.tilew = tilew;
+  pool.tileh = tileh;
+  pool.tilesy = (ny + tileh - 1) / tileh;
+  pool.work = work;
+  pool.context = context;
+  pool.error = 0;
+  ntiles = ((nx + tilew - 1) / tilew) * pool.tilesy;
+
+  if (nthreads < 1)
+    nthreads = 1;
+  if (nthreads > ntiles)
+    nthreads = ntiles;
+
+  /* single worker: walk the tiles in order on the calling thread */
+  if (nthreads == 1) {
+    for (t=0; t<ntiles; t++) {
+      ret = run_tile(&pool, 0, t);
+      if (ret)
+	return ret;
+    }
+    return 0;
+  }
+
+  pool.nworkers = nthreads;
+  pool.runs = malloc(sizeof(TileRun)*nthreads);
+  workers = malloc(sizeof(TileWorker)*nthreads);
+  threads = malloc(sizeof(pthread_t)*nthreads);
+  if ((pool.runs==NULL) || (workers==NULL) || (threads==NULL)) {
+    free(pool.runs);
+    free(workers);
+    free(threads);
+    return SCHED_MALLOC;
+  }
+
+  share = ntiles / nthreads;
+  extra = ntiles % nthreads;
+  start = 0;
+  for (i=0; i<nthreads; i++) {
+    pthread_mutex_init(&(pool.runs[i].lock), NULL);
+    pool.runs[i].head = start;
+    start += share + (i < extra ? 1 : 0);
+    pool.runs[i].tail = start;
+    workers[i].pool = &pool;
+    workers[i].id = i;
+  }
+
+  /* worker 0 is the calling thread */
+  started = 1;
+  for (i=1; i<nthreads; i++) {
+    if (pthread_create(&(threads[i]), NULL, worker_main, &(workers[i])) != 0)
+      break;
+    started++;
+  }
+  worker_main(&(workers[0]));
+  for (i=1; i<started; i++)
+    pthread_join(threads[i], NULL);
+
+  /* a thread that failed to start leaves its run to be stolen by the
+     others, so the canvas is still complete */
+  ret = pool.error;
+
+  for (i=0; i<nthreads; i++)
+    pthread_mutex_destroy(&(pool.runs[i].lock));
+  free(pool.runs);
+  free(workers);
+  free(threads);
+
+  return ret;
+}
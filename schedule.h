@@ -0,0 +1,70 @@
+/****************************************************************************/
+/* schedule.h: tile scheduling and worker threads for FRASCR application    */
+/*   Splits a canvas into rectangular tiles and hands them to a pool of     */
+/*   worker threads. Each worker owns a run of tiles and, once it runs dry, */
+/*   steals half of the remaining tiles of the busiest other worker, so     */
+/*   that expensive regions (set boundaries) do not leave cores idle.       */
+/*   Last updated: 2024 June                                                */
+/****************************************************************************/
+/*  Author: Miguel Abele                                                    */
+/*  Copyrighted by Miguel Abele, 2024.                                      */
+/*                                                                          */
+/*  License information:                                                    */
+/*                                                                          */
+/*  This file is a part of the FRASCR application.                          */
+/*                                                                          */
+/*  FRASCR is free software; you can redistribute it and/or                 */
+/*  modify it under the terms of the GNU General Public License             */
+/*  as published by the Free Software Foundation; either version 3          */
+/*  of the License, or (at your option) any later version.                  */
+/*                                                                          */
+/*  FRASCR is distributed in the hope that it will be useful,               */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of          */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           */
+/*  GNU General Public License for more details.                            */
+/*                                                                          */
+/*  You should have received a copy of the GNU General Public License       */
+/*  along with this program; if not, write to the Free Software             */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor,                      */
+/*  Boston, MA  02110-1301, USA.                                            */
+/****************************************************************************/
+
+
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+
+#include "utils.h"
+
+
+#define SCHED_BAD_CALL    -50
+#define SCHED_MALLOC      -51
+
+#define SCHED_TILE_SIZE   64
+
+
+/* Work function called once per tile. Worker is the index of the calling
+   thread, in [0, nthreads), for use with per-thread scratch data. A nonzero
+   return stops the schedule and is passed back by schedule_tiles. */
+typedef int (*TileWork)(void * context,
+			int worker,
+			uint32 x0,
+			uint32 y0,
+			uint32 w,
+			uint32 h);
+
+
+/* Resolve a requested thread count: 0 means one per online processor */
+int schedule_threads(int requested);
+
+/* Run work over every tile of an nx by ny canvas using nthreads workers */
+int schedule_tiles(uint32 nx,
+		   uint32 ny,
+		   uint32 tilew,
+		   uint32 tileh,
+		   int nthreads,
+		   TileWork work,
+		   void * context);
+
+
+#endif /* SCHEDULE_H */
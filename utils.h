@@ -1,7 +1,8 @@
 /****************************************************************************/
 /* utils.h: utility definitions for FRASCR application                      */
 /*   Defines structs for Datum as well as Palette, though this is right     */
-/*   now unused.                                                            */
+/*   now unused. Defines Canvas, the aligned block of Datum that EXECUTE    */
+/*   fills and hands to FINISH and VALIDATE, with its allocator.            */
 /*   Gives typedefs for integer types. These will need to be altered so     */
 /*   that the whole of the application, including the libraries, can        */
 /*   switch between 8, 16, and 32 bit storage, and 8 & 16 bit output.       */
@@ -36,6 +37,11 @@
 #define UTILS_H
 
 
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+
 typedef unsigned char uint8;
 typedef unsigned short uint16;
 typedef unsigned int uint32;
@@ -43,6 +49,25 @@ typedef unsigned long uint64;
 typedef double float64;
 
 
+/* An output named "-" is the standard output, e.g. to pipe frames to an
+   encoder; it is flushed rather than closed. Every finisher but libfrd.so,
+   which seeks, can write there. */
+static inline FILE * output_open(const char * name)
+{
+  if (strcmp(name, "-") == 0)
+    return stdout;
+  return fopen(name, "wb");
+}
+
+
+static inline int output_close(FILE * f)
+{
+  if (f == stdout)
+    return fflush(f);
+  return fclose(f);
+}
+
+
 struct datum {
   float64 re;
   float64 im;
@@ -53,6 +78,272 @@ typedef struct datum Datum;
 
 
 
+/* A canvas is one block of pixels, aligned to CANVAS_ALIGN bytes. Pixel
+   (i,j) is entry i*stride + j for CANVAS_COLUMNS and j*stride + i for
+   CANVAS_ROWS; the stride is padded so that every column (or row) starts on
+   an aligned boundary.
+   A CANVAS_FULL canvas holds a Datum per pixel in data. For column-major
+   canvases, cols holds a pointer to each column so that code written for
+   Datum ** can index cols[i][j]. A compact canvas (CANVAS_N32, CANVAS_N16)
+   holds only the count n per pixel in counts, and gives the coordinates of
+   pixel (i,j) from the grid set by canvas_grid, as the libraries place
+   their points: left + i*width/nx, bottom + j*height/ny.
+   A canvas may also be a band of a larger view (canvas_band), in which
+   case its pixel (i,j) is pixel (i0+i, j0+j) of a view vnx by vny. */
+
+#define CANVAS_COLUMNS    0
+#define CANVAS_ROWS       1
+
+#define CANVAS_FULL       0
+#define CANVAS_N32        1
+#define CANVAS_N16        2
+
+#define CANVAS_ALIGN      64
+#define CANVAS_PAD        8     /* 8 Datum = 192 bytes = 3 * CANVAS_ALIGN */
+#define CANVAS_N16_MAX    65535
+
+struct canvas {
+  Datum * data;
+  void * counts;
+  Datum ** cols;
+  uint32 nx;
+  uint32 ny;
+  uint32 stride;
+  int order;
+  int format;
+  uint32 i0, j0;
+  uint32 vnx, vny;
+  float64 left;
+  float64 bottom;
+  float64 width;
+  float64 height;
+};
+
+typedef struct canvas Canvas;
+
+
+/* the smallest compact format holding counts up to max */
+static inline int canvas_compact_format(uint32 max)
+{
+  return (max <= CANVAS_N16_MAX ? CANVAS_N16 : CANVAS_N32);
+}
+
+
+static inline int canvas_alloc(Canvas * c, uint32 nx, uint32 ny, int order, int format)
+{
+  void * block = NULL;
+  uint32 len, pad, i;
+  size_t size;
+
+  c->data = NULL;
+  c->counts = NULL;
+  c->cols = NULL;
+  c->nx = nx;
+  c->ny = ny;
+  c->order = order;
+  c->format = format;
+  c->i0 = c->j0 = 0;
+  c->vnx = nx;
+  c->vny = ny;
+  c->left = c->bottom = 0.0;
+  c->width = c->height = 0.0;
+
+  switch (format) {
+  case CANVAS_N32:
+    size = sizeof(uint32);
+    pad = CANVAS_ALIGN / sizeof(uint32);
+    break;
+  case CANVAS_N16:
+    size = sizeof(uint16);
+    pad = CANVAS_ALIGN / sizeof(uint16);
+    break;
+  default:
+    size = sizeof(Datum);
+    pad = CANVAS_PAD;
+    break;
+  }
+  len = (order == CANVAS_ROWS ? nx : ny);
+  c->stride = (len + pad - 1) / pad * pad;
+
+  if (posix_memalign(&block, CANVAS_ALIGN,
+		     size * (uint64)c->stride * (order == CANVAS_ROWS ? ny : nx)) != 0)
+    return 1;
+  if (format != CANVAS_FULL) {
+    c->counts = block;
+    return 0;
+  }
+  c->data = block;
+  if (order == CANVAS_COLUMNS) {
+    c->cols = malloc(sizeof(Datum *) * nx);
+    if (c->cols == NULL) {
+      free(c->data);
+      c->data = NULL;
+      return 1;
+    }
+    for (i=0; i<nx; i++)
+      c->cols[i] = c->data + (uint64)i * c->stride;
+  }
+  return 0;
+}
+
+
+static inline void canvas_free(Canvas * c)
+{
+  free(c->cols);
+  free(c->data);
+  free(c->counts);
+  c->cols = NULL;
+  c->data = NULL;
+  c->counts = NULL;
+}
+
+
+static inline void canvas_grid(Canvas * c,
+			       float64 left,
+			       float64 bottom,
+			       float64 width,
+			       float64 height)
+{
+  c->left = left;
+  c->bottom = bottom;
+  c->width = width;
+  c->height = height;
+}
+
+
+/* make c, allocated with at least h rows, the rows [j0,j0+h) of a view
+   vny rows high */
+static inline void canvas_band(Canvas * c, uint32 j0, uint32 h, uint32 vny)
+{
+  c->j0 = j0;
+  c->ny = h;
+  c->vny = vny;
+}
+
+
+static inline uint64 canvas_index(const Canvas * c, uint32 i, uint32 j)
+{
+  if (c->order == CANVAS_ROWS)
+    return (uint64)j * c->stride + i;
+  return (uint64)i * c->stride + j;
+}
+
+
+/* the Datum of pixel (i,j), for CANVAS_FULL only */
+static inline Datum * canvas_at(const Canvas * c, uint32 i, uint32 j)
+{
+  return c->data + canvas_index(c, i, j);
+}
+
+
+static inline uint32 canvas_n(const Canvas * c, uint32 i, uint32 j)
+{
+  switch (c->format) {
+  case CANVAS_N32:
+    return ((uint32 *)c->counts)[canvas_index(c, i, j)];
+  case CANVAS_N16:
+    return ((uint16 *)c->counts)[canvas_index(c, i, j)];
+  default:
+    return c->data[canvas_index(c, i, j)].n;
+  }
+}
+
+
+/* store a count; CANVAS_N16 saturates, and returns 1 if it had to */
+static inline int canvas_set_n(Canvas * c, uint32 i, uint32 j, uint32 n)
+{
+  switch (c->format) {
+  case CANVAS_N32:
+    ((uint32 *)c->counts)[canvas_index(c, i, j)] = n;
+    return 0;
+  case CANVAS_N16:
+    ((uint16 *)c->counts)[canvas_index(c, i, j)] = (n > CANVAS_N16_MAX ? CANVAS_N16_MAX : n);
+    return (n > CANVAS_N16_MAX);
+  default:
+    c->data[canvas_index(c, i, j)].n = n;
+    return 0;
+  }
+}
+
+
+/* pixel (i,j) as a Datum, whatever the format */
+static inline void canvas_get(const Canvas * c, uint32 i, uint32 j, Datum * d)
+{
+  if (c->format == CANVAS_FULL) {
+    *d = c->data[canvas_index(c, i, j)];
+    return;
+  }
+  d->re = c->left + ((float64)(c->i0 + i)) * c->width / ((float64)c->vnx);
+  d->im = c->bottom + ((float64)(c->j0 + j)) * c->height / ((float64)c->vny);
+  d->n = canvas_n(c, i, j);
+}
+
+
+/* the largest count, scanned in storage order */
+static inline uint32 canvas_max_n(const Canvas * c)
+{
+  uint32 i, j, lines, len, n;
+  uint64 at;
+  uint32 max = 0;
+
+  lines = (c->order == CANVAS_ROWS ? c->ny : c->nx);
+  len = (c->order == CANVAS_ROWS ? c->nx : c->ny);
+  for (i=0; i<lines; i++) {
+    at = (uint64)i * c->stride;
+    for (j=0; j<len; j++) {
+      switch (c->format) {
+      case CANVAS_N32:
+	n = ((uint32 *)c->counts)[at + j];
+	break;
+      case CANVAS_N16:
+	n = ((uint16 *)c->counts)[at + j];
+	break;
+      default:
+	n = c->data[at + j].n;
+	break;
+      }
+      if (n > max)
+	max = n;
+    }
+  }
+
+  return max;
+}
+
+
+/* allocate canvl canvases of one shape; NULL if any of them fails */
+static inline Canvas * canvas_alloc_set(uint32 canvl, uint32 nx, uint32 ny, int order, int format)
+{
+  Canvas * canva;
+  uint32 k, m;
+
+  canva = calloc(canvl, sizeof(Canvas));
+  if (canva == NULL)
+    return NULL;
+  for (k=0; k<canvl; k++) {
+    if (canvas_alloc(&(canva[k]), nx, ny, order, format)) {
+      for (m=0; m<k; m++)
+	canvas_free(&(canva[m]));
+      free(canva);
+      return NULL;
+    }
+  }
+  return canva;
+}
+
+
+static inline void canvas_free_set(Canvas * canva, uint32 canvl)
+{
+  uint32 k;
+  if (canva == NULL)
+    return;
+  for (k=0; k<canvl; k++)
+    canvas_free(&(canva[k]));
+  free(canva);
+}
+
+
+
 struct canvas_f {
   uint32 w;
   uint32 h;
@@ -0,0 +1,305 @@
+/****************************************************************************/
+/* viewcache.c: canvases kept between renders for FRASCR application        */
+/*   A file holds a header and the counts of every canvas, column by        */
+/*   column. Its name is a hash of the view key, so that each zoom level    */
+/*   keeps its own last render; the header repeats the key and the grid, so */
+/*   a file is only used for the view it was written for.                   */
+/*   Last updated: 2024 June                                                */
+/****************************************************************************/
+/*  Author: Miguel Abele                                                    */
+/*  Copyrighted by Miguel Abele, 2024.                                      */
+/*                                                                          */
+/*  License information:                                                    */
+/*                                                                          */
+/*  This file is a part of the FRASCR application.                          */
+/*                                                                          */
+/*  FRASCR is free software; you can redistribute it and/or                 */
+/*  modify it under the terms of the GNU General Public License             */
+/*  as published by the Free Software Foundation; either version 3          */
+/*  of the License, or (at your option) any later version.                  */
+/*                                                                          */
+/*  FRASCR is distributed in the hope that it will be useful,               */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of          */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           */
+/*  GNU General Public License for more details.                            */
+/*                                                                          */
+/*  You should have received a copy of the GNU General Public License       */
+/*  along with this program; if not, write to the Free Software             */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor,                      */
+/*  Boston, MA  02110-1301, USA.                                            */
+/****************************************************************************/
+
+
+#include "viewcache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/stat.h>
+
+
+struct view_cache_header {
+  char magic[4];
+  uint32 byteorder;
+  uint64 key;
+  uint32 canvl;
+  uint32 nx, ny;
+  uint32 reserved;
+  float64 left, bottom;
+  float64 dx, dy;       /* pixel spacing */
+};
+typedef struct view_cache_header ViewCacheHeader;
+
+
+/* FNV-1a, 64 bits */
+static inline uint64 hash_bytes(uint64 h, const void * p, size_t len)
+{
+  const unsigned char * b = (const unsigned char *)p;
+  while (len--) {
+    h ^= *b++;
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+
+/* everything a count depends on, save where the pixel is */
+static uint64 view_key(CoreOpts * core, CanvasOpts * canv, uint32 canvl)
+{
+  uint64 h = 0xcbf29ce484222325ULL;
+  float64 dx = canv->width / (float64)canv->nwidth;
+  float64 dy = canv->height / (float64)canv->nheight;
+  uint32 i;
+
+  if (core->execs)
+    h = hash_bytes(h, core->execs, strlen(core->execs) + 1);
+  for (i=0; i<canv->secondaryl; i++)
+    h = hash_bytes(h, canv->secondary[i], strlen(canv->secondary[i]) + 1);
+  h = hash_bytes(h, &(canv->escape), sizeof(uint32));
+  h = hash_bytes(h, &(canv->periodicity), sizeof(int));
+  h = hash_bytes(h, &(canv->subdivide), sizeof(int));
+  h = hash_bytes(h, &canvl, sizeof(uint32));
+  h = hash_bytes(h, &(canv->coord_Re), sizeof(float64));
+  h = hash_bytes(h, &(canv->coord_Im), sizeof(float64));
+  h = hash_bytes(h, &dx, sizeof(float64));
+  h = hash_bytes(h, &dy, sizeof(float64));
+  return h;
+}
+
+
+/* the whole number of pixels s is, if it is one */
+static inline int whole_shift(float64 s, int * d)
+{
+  float64 r = floor(s + 0.5);
+  if ((r > 2147483647.) || (r < -2147483647.) || (fabs(s - r) > VC_TOL))
+    return 0;
+  *d = (int)r;
+  return 1;
+}
+
+
+static inline void describe(ViewCacheHeader * vh, ViewCache * vc, CanvasOpts * canv)
+{
+  memset(vh, 0, sizeof(ViewCacheHeader));
+  memcpy(vh->magic, VC_MAGIC, 4);
+  vh->byteorder = VC_BYTEORDER;
+  vh->key = vc->key;
+  vh->canvl = vc->canvl;
+  vh->nx = vc->nx;
+  vh->ny = vc->ny;
+  vh->left = canv->left;
+  vh->bottom = canv->bottom;
+  vh->dx = canv->width / (float64)canv->nwidth;
+  vh->dy = canv->height / (float64)canv->nheight;
+}
+
+
+/* the last render of the key, if its grid lines up with this one */
+static void load(ViewCache * vc, CanvasOpts * canv, DParam * debug)
+{
+  ViewCacheHeader want, have;
+  long i0, i1, j0, j1;
+  uint64 size;
+  FILE * in;
+
+  in = fopen(vc->path, "rb");
+  if (in == NULL) {
+    DEBUG(debug, D1, "engine::view_cache: no render of this view in %s yet\n", canv->cache);
+    return;
+  }
+  describe(&want, vc, canv);
+  if ((fread(&have, sizeof(ViewCacheHeader), 1, in) != 1)
+      || memcmp(have.magic, want.magic, 4) || (have.byteorder != want.byteorder)
+      || (have.key != want.key) || (have.canvl != want.canvl)
+      || (have.dx != want.dx) || (have.dy != want.dy)
+      || (have.nx == 0) || (have.ny == 0)) {
+    DEBUG(debug, D1, "engine::view_cache: %s is not a render of this view\n", vc->path);
+    fclose(in);
+    return;
+  }
+  if (!whole_shift((want.left - have.left) / want.dx, &(vc->di))
+      || !whole_shift((want.bottom - have.bottom) / want.dy, &(vc->dj))) {
+    DEBUG(debug, D1, "engine::view_cache: view is not a whole number of pixels from the cached one\n");
+    fclose(in);
+    return;
+  }
+
+  /* pixels i with 0 <= i + di < onx, likewise j */
+  i0 = (vc->di < 0 ? -(long)vc->di : 0);
+  i1 = (long)have.nx - vc->di;
+  if (i1 > vc->nx)
+    i1 = vc->nx;
+  j0 = (vc->dj < 0 ? -(long)vc->dj : 0);
+  j1 = (long)have.ny - vc->dj;
+  if (j1 > vc->ny)
+    j1 = vc->ny;
+  if ((i0 >= i1) || (j0 >= j1)) {
+    DEBUG(debug, D1, "engine::view_cache: view shares no pixels with the cached one\n");
+    fclose(in);
+    return;
+  }
+
+  size = (uint64)vc->canvl * have.nx * have.ny;
+  vc->old = malloc(sizeof(uint32) * size);
+  if (vc->old && (fread(vc->old, sizeof(uint32), size, in) == size)) {
+    vc->onx = have.nx;
+    vc->ony = have.ny;
+    vc->ci0 = i0;
+    vc->ci1 = i1;
+    vc->cj0 = j0;
+    vc->cj1 = j1;
+    DEBUG(debug, D1, "engine::view_cache: reusing pixels [%u,%u) x [%u,%u) of the last render\n",
+	  vc->ci0, vc->ci1, vc->cj0, vc->cj1);
+  } else {
+    free(vc->old);
+    vc->old = NULL;
+  }
+  fclose(in);
+}
+
+
+int view_cache_open(ViewCache * vc, CoreOpts * core, CanvasOpts * canv,
+		    uint32 canvl, DParam * debug)
+{
+  vc->path = NULL;
+  vc->counts = NULL;
+  vc->old = NULL;
+  vc->canvl = canvl;
+  vc->nx = canv->nwidth;
+  vc->ny = canv->nheight;
+  vc->onx = vc->ony = 0;
+  vc->di = vc->dj = 0;
+  vc->ci0 = vc->ci1 = 0;
+  vc->cj0 = vc->cj1 = 0;
+  vc->reused = 0;
+  if (canv->cache == NULL)
+    return 0;
+
+  vc->key = view_key(core, canv, canvl);
+  vc->path = malloc(strlen(canv->cache) + 22);
+  vc->counts = malloc(sizeof(uint32) * canvl * (uint64)vc->nx * vc->ny);
+  if ((vc->path == NULL) || (vc->counts == NULL)) {
+    free(vc->path);
+    free(vc->counts);
+    vc->path = NULL;
+    vc->counts = NULL;
+    return VC_MALLOC;
+  }
+  sprintf(vc->path, "%s/%016lx.frc", canv->cache, vc->key);
+  /* the directory is made on first use, and may well be there already */
+  mkdir(canv->cache, 0755);
+  load(vc, canv, debug);
+  return 0;
+}
+
+
+int view_cache_copy(ViewCache * vc, Canvas * canva, uint32 jb,
+		    uint32 x0, uint32 y0, uint32 w, uint32 h)
+{
+  const uint32 * src;
+  Canvas * c;
+  Datum * d;
+  uint32 i, j, k;
+  int over = 0;
+
+  for (k=0; k<vc->canvl; k++) {
+    c = &(canva[k]);
+    for (i=x0; i<x0+w; i++) {
+      src = vc->old + ((uint64)k*vc->onx + (i + vc->di))*vc->ony + (y0 + vc->dj);
+      if (c->format != CANVAS_FULL) {
+	for (j=0; j<h; j++)
+	  over |= canvas_set_n(c, i, y0 + j - jb, src[j]);
+	continue;
+      }
+      /* a copy sits at its own place on the new grid */
+      d = canvas_at(c, i, y0 - jb);
+      for (j=0; j<h; j++) {
+	d[j].re = c->left + ((float64)i) * c->width / ((float64)c->vnx);
+	d[j].im = c->bottom + ((float64)(y0 + j)) * c->height / ((float64)c->vny);
+	d[j].n = src[j];
+      }
+    }
+  }
+  __atomic_fetch_add(&(vc->reused), (uint64)w * h, __ATOMIC_RELAXED);
+  return over;
+}
+
+
+void view_cache_take(ViewCache * vc, Canvas * canva, uint32 jb, uint32 rows)
+{
+  uint32 * dst;
+  uint32 i, j, k;
+
+  if (vc->counts == NULL)
+    return;
+  for (k=0; k<vc->canvl; k++) {
+    for (i=0; i<vc->nx; i++) {
+      dst = vc->counts + ((uint64)k*vc->nx + i)*vc->ny + jb;
+      for (j=0; j<rows; j++)
+	dst[j] = canvas_n(&(canva[k]), i, j);
+    }
+  }
+}
+
+
+void view_cache_close(ViewCache * vc, CanvasOpts * canv, DParam * debug,
+		      int complete)
+{
+  ViewCacheHeader vh;
+  uint64 size = (uint64)vc->canvl * vc->nx * vc->ny;
+  char * temp;
+  FILE * out;
+  int ok = 0;
+
+  if (vc->path == NULL)
+    return;
+
+  DEBUG(debug, D1, "engine::view_cache: %lu of %lu pixels reused, not computed\n",
+	vc->reused, (uint64)vc->nx * vc->ny);
+
+  /* written beside the last one and renamed over it, so that a failed
+     write leaves that in place */
+  temp = (complete ? malloc(strlen(vc->path) + 5) : NULL);
+  if (temp) {
+    sprintf(temp, "%s.tmp", vc->path);
+    out = fopen(temp, "wb");
+    if (out) {
+      describe(&vh, vc, canv);
+      ok = ((fwrite(&vh, sizeof(ViewCacheHeader), 1, out) == 1)
+	    && (fwrite(vc->counts, sizeof(uint32), size, out) == size));
+      ok = ((fclose(out) == 0) && ok && (rename(temp, vc->path) == 0));
+      if (!ok)
+	remove(temp);
+    }
+    free(temp);
+    if (!ok)
+      DEBUG(debug, D0, "engine::view_cache: could not write %s\n", vc->path);
+  }
+
+  free(vc->path);
+  free(vc->counts);
+  free(vc->old);
+  vc->path = NULL;
+  vc->counts = NULL;
+  vc->old = NULL;
+}
@@ -0,0 +1,114 @@
+/****************************************************************************/
+/* viewcache.h: canvases kept between renders for FRASCR application        */
+/*   With canvas option "cache" naming a directory, the engine keeps there  */
+/*   the counts of the last render of each view key: the algorithm library, */
+/*   its secondary options, the escape limit, the periodicity and           */
+/*   subdivision options, the constant and the pixel spacing. A later       */
+/*   render with the same key whose grid is the old one shifted by whole    */
+/*   pixels (a pan, or a resize) takes the pixels the two share from the    */
+/*   file and computes only the strips that are new, through EXECUTE_TILE   */
+/*   as usual. The file is then replaced by the new render.                 */
+/*   A shared pixel keeps the count found at the old grid point, which can  */
+/*   be an ulp away from the new one; libraries that carry state of their   */
+/*   own across renders (e.g. "resume") do not see the pixels reused.       */
+/*   Last updated: 2024 June                                                */
+/****************************************************************************/
+/*  Author: Miguel Abele                                                    */
+/*  Copyrighted by Miguel Abele, 2024.                                      */
+/*                                                                          */
+/*  License information:                                                    */
+/*                                                                          */
+/*  This file is a part of the FRASCR application.                          */
+/*                                                                          */
+/*  FRASCR is free software; you can redistribute it and/or                 */
+/*  modify it under the terms of the GNU General Public License             */
+/*  as published by the Free Software Foundation; either version 3          */
+/*  of the License, or (at your option) any later version.                  */
+/*                                                                          */
+/*  FRASCR is distributed in the hope that it will be useful,               */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of          */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           */
+/*  GNU General Public License for more details.                            */
+/*                                                                          */
+/*  You should have received a copy of the GNU General Public License       */
+/*  along with this program; if not, write to the Free Software             */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor,                      */
+/*  Boston, MA  02110-1301, USA.                                            */
+/****************************************************************************/
+
+
+#ifndef VIEWCACHE_H
+#define VIEWCACHE_H
+
+
+#include "debug.h"
+#include "options.h"
+
+
+#define VC_MALLOC     -70
+
+#define VC_MAGIC      "FRC1"
+#define VC_BYTEORDER  0x01020304
+/* how far, in pixels, a shift may be from whole and the grids still match */
+#define VC_TOL        1.0e-6
+
+
+struct view_cache {
+  char * path;         /* the file for this key, or NULL if caching is off */
+  uint64 key;          /* hash of the view key, naming the file */
+  uint32 canvl;
+  uint32 nx, ny;
+  uint32 * counts;     /* the render in progress: canvas k, pixel (i,j) at
+			  (k*nx + i)*ny + j */
+  uint32 * old;        /* the last render, likewise, or NULL if none fits */
+  uint32 onx, ony;
+  int di, dj;          /* pixel (i,j) is the old render's (i+di, j+dj) */
+  uint32 ci0, ci1;     /* the pixels both share, [ci0,ci1) x [cj0,cj1) */
+  uint32 cj0, cj1;
+  uint64 reused;
+};
+typedef struct view_cache ViewCache;
+
+
+/* Find the file for the view of canv, as computed by core's library into
+   canvl canvases, and load it if its grid lines up. vc->path stays NULL if
+   canv asks for no cache. Returns 0 or VC_MALLOC. */
+int view_cache_open(ViewCache * vc, CoreOpts * core, CanvasOpts * canv,
+		    uint32 canvl, DParam * debug);
+
+/* Copy the shared pixels [x0,x0+w) x [y0,y0+h) of the view into the
+   canvases, whose first row is row y0 - jb of the view. Returns 1 if a
+   count saturated a CANVAS_N16 canvas. */
+int view_cache_copy(ViewCache * vc, Canvas * canva, uint32 jb,
+		    uint32 x0, uint32 y0, uint32 w, uint32 h);
+
+/* Keep the rows [jb, jb+rows) of the view from the finished canvases */
+void view_cache_take(ViewCache * vc, Canvas * canva, uint32 jb, uint32 rows);
+
+/* Replace the file with the render if complete is set, then free vc */
+void view_cache_close(ViewCache * vc, CanvasOpts * canv, DParam * debug,
+		      int complete);
+
+
+/* The part of [x0,x0+w) x [y0,y0+h) the last render shares, if any */
+static inline int view_cache_overlap(const ViewCache * vc,
+				     uint32 x0,
+				     uint32 y0,
+				     uint32 w,
+				     uint32 h,
+				     uint32 * cx0,
+				     uint32 * cy0,
+				     uint32 * cx1,
+				     uint32 * cy1)
+{
+  if (vc->old == NULL)
+    return 0;
+  *cx0 = (x0 > vc->ci0 ? x0 : vc->ci0);
+  *cx1 = (x0 + w < vc->ci1 ? x0 + w : vc->ci1);
+  *cy0 = (y0 > vc->cj0 ? y0 : vc->cj0);
+  *cy1 = (y0 + h < vc->cj1 ? y0 + h : vc->cj1);
+  return ((*cx0 < *cx1) && (*cy0 < *cy1));
+}
+
+
+#endif /* VIEWCACHE_H */